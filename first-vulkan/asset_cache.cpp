@@ -0,0 +1,529 @@
+#include "asset_cache.h"
+
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <glm/geometric.hpp>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(MeshCacheHeader) == 80, "mesh cache header layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheMesh) == 64 + 16 * MAX_MESH_LODS, "mesh cache mesh layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheMeshlet) == 64, "mesh cache meshlet layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(TextureCacheHeader) == 32, "texture cache header layout changed, bump TEXTURE_CACHE_VERSION");
+static_assert(sizeof(TextureCacheTexture) == 16 + 8 * MAX_TEXTURE_MIPS, "texture cache texture layout changed, bump TEXTURE_CACHE_VERSION");
+
+#ifdef _WIN32
+
+MappedFile mapFile(const std::string& path)
+{
+    MappedFile mapped;
+
+    // the cache is read front to back exactly once
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::runtime_error("failed to get the size of " + path + "!");
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        throw std::runtime_error("failed to map " + path + "!");
+    }
+
+    mapped.data = static_cast<const uint8_t*>(data);
+    mapped.size = static_cast<size_t>(size.QuadPart);
+    mapped.file = file;
+    mapped.mapping = mapping;
+    return mapped;
+}
+
+void unmapFile(MappedFile& file)
+{
+    if (file.data) {
+        UnmapViewOfFile(file.data);
+        CloseHandle(file.mapping);
+        CloseHandle(file.file);
+    }
+    file = {};
+}
+
+#else
+
+MappedFile mapFile(const std::string& path)
+{
+    MappedFile mapped;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("failed to get the size of " + path + "!");
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("failed to map " + path + "!");
+    }
+
+    // the cache is read front to back exactly once
+    madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    mapped.data = static_cast<const uint8_t*>(data);
+    mapped.size = static_cast<size_t>(info.st_size);
+    mapped.fd = fd;
+    return mapped;
+}
+
+void unmapFile(MappedFile& file)
+{
+    if (file.data) {
+        munmap(const_cast<uint8_t*>(file.data), file.size);
+        close(file.fd);
+    }
+    file = {};
+}
+
+#endif
+
+namespace {
+
+struct ObjCorner {
+    int position;
+    int uv;
+    int normal;
+
+    bool operator==(const ObjCorner& other) const { return position == other.position && uv == other.uv && normal == other.normal; }
+};
+
+struct ObjCornerHash {
+    size_t operator()(const ObjCorner& corner) const
+    {
+        return (static_cast<size_t>(corner.position) * 73856093u) ^ (static_cast<size_t>(corner.uv) * 19349663u) ^ (static_cast<size_t>(corner.normal) * 83492791u);
+    }
+};
+
+// obj indices are 1 based and negative ones count back from the end, 0 means
+// the attribute is missing. a negative index reaching past the start of the
+// list comes back as -1
+[[nodiscard]] int resolveObjIndex(long index, size_t count)
+{
+    if (index > 0) {
+        return static_cast<int>(index);
+    }
+    if (index < 0) {
+        if (-index > static_cast<long>(count)) {
+            return -1;
+        }
+        return static_cast<int>(count) + static_cast<int>(index) + 1;
+    }
+    return 0;
+}
+
+[[nodiscard]] uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+// pads the file with zeros up to offset, which is at most one alignment away
+void writeSection(std::ofstream& file, uint64_t offset, const void* data, size_t size)
+{
+    static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+    uint64_t position = static_cast<uint64_t>(file.tellp());
+    file.write(zeros, static_cast<std::streamsize>(offset - position));
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+}
+
+MeshData loadObjMesh(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> cornerMap;
+    std::vector<uint32_t> polygon;
+    bool hasNormals = true;
+
+    MeshData mesh;
+    std::string line;
+    while (std::getline(file, line)) {
+        const char* cursor = line.c_str();
+        char* end = nullptr;
+
+        if (line.rfind("v ", 0) == 0) {
+            glm::vec3 position;
+            position.x = std::strtof(cursor + 2, &end);
+            position.y = std::strtof(end, &end);
+            position.z = std::strtof(end, &end);
+            positions.push_back(position);
+        } else if (line.rfind("vt ", 0) == 0) {
+            glm::vec2 uv;
+            uv.x = std::strtof(cursor + 3, &end);
+            uv.y = std::strtof(end, &end);
+            // obj puts the uv origin in the bottom left corner
+            uvs.push_back(glm::vec2(uv.x, 1.0f - uv.y));
+        } else if (line.rfind("vn ", 0) == 0) {
+            glm::vec3 normal;
+            normal.x = std::strtof(cursor + 3, &end);
+            normal.y = std::strtof(end, &end);
+            normal.z = std::strtof(end, &end);
+            normals.push_back(normal);
+        } else if (line.rfind("f ", 0) == 0) {
+            polygon.clear();
+            cursor += 2;
+            while (true) {
+                long position = std::strtol(cursor, &end, 10);
+                if (end == cursor) {
+                    break;
+                }
+                cursor = end;
+
+                ObjCorner corner { resolveObjIndex(position, positions.size()), 0, 0 };
+                if (*cursor == '/') {
+                    cursor++;
+                    if (*cursor != '/') {
+                        corner.uv = resolveObjIndex(std::strtol(cursor, &end, 10), uvs.size());
+                        cursor = end;
+                    }
+                    if (*cursor == '/') {
+                        cursor++;
+                        corner.normal = resolveObjIndex(std::strtol(cursor, &end, 10), normals.size());
+                        cursor = end;
+                    }
+                }
+
+                if (corner.position <= 0 || corner.position > static_cast<int>(positions.size()) || corner.uv < 0
+                    || corner.uv > static_cast<int>(uvs.size()) || corner.normal < 0 || corner.normal > static_cast<int>(normals.size())) {
+                    throw std::runtime_error("invalid face index in " + path + "!");
+                }
+                hasNormals = hasNormals && corner.normal != 0;
+
+                auto [it, inserted] = cornerMap.emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+                if (inserted) {
+                    Vertex vertex {};
+                    vertex.position = positions[corner.position - 1];
+                    vertex.uv = corner.uv ? uvs[corner.uv - 1] : glm::vec2(0.0f);
+                    vertex.normal = corner.normal ? normals[corner.normal - 1] : glm::vec3(0.0f);
+                    mesh.vertices.push_back(vertex);
+                }
+                polygon.push_back(it->second);
+            }
+
+            for (size_t i = 2; i < polygon.size(); i++) {
+                mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+            }
+        }
+    }
+
+    if (mesh.indices.empty()) {
+        throw std::runtime_error("no faces in " + path + "!");
+    }
+
+    if (!hasNormals) {
+        for (auto& vertex : mesh.vertices) {
+            vertex.normal = glm::vec3(0.0f);
+        }
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            Vertex& a = mesh.vertices[mesh.indices[i + 0]];
+            Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+            Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+            glm::vec3 normal = glm::cross(b.position - a.position, c.position - a.position);
+            a.normal += normal;
+            b.normal += normal;
+            c.normal += normal;
+        }
+    }
+
+    for (auto& vertex : mesh.vertices) {
+        float length = glm::length(vertex.normal);
+        vertex.normal = length > 0.0f ? vertex.normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    return mesh;
+}
+
+SceneGeometry buildSceneGeometry(const std::vector<MeshData>& meshes, VertexFormat vertexFormat)
+{
+    SceneGeometry geometry;
+    geometry.vertexFormat = vertexFormat;
+
+    for (const auto& source : meshes) {
+        // exporters write triangles in whatever order they like
+        MeshData mesh = source;
+        optimizeMesh(mesh);
+
+        MeshCacheMesh cacheMesh {};
+        cacheMesh.boundingSphere = computeBoundingSphere(mesh);
+        cacheMesh.vertexOffset = static_cast<int32_t>(geometry.vertexCount);
+
+        VertexQuantization quantization = computeVertexQuantization(mesh.vertices);
+        cacheMesh.positionOffset = glm::vec4(quantization.positionOffset, 0.0f);
+        cacheMesh.positionScale = glm::vec4(quantization.positionScale, 1.0f);
+
+        std::vector<MeshLod> lods = generateLodChain(mesh, MAX_MESH_LODS);
+        cacheMesh.lodCount = static_cast<uint32_t>(lods.size());
+        for (size_t i = 0; i < lods.size(); i++) {
+            // simplification keeps the triangle order but leaves holes in it
+            if (i > 0) {
+                optimizeVertexCache(lods[i].indices, mesh.vertices.size());
+            }
+
+            cacheMesh.lods[i].firstIndex = static_cast<uint32_t>(geometry.indices.size());
+            cacheMesh.lods[i].indexCount = static_cast<uint32_t>(lods[i].indices.size());
+            cacheMesh.lods[i].error = cacheMesh.boundingSphere.w > 0.0f ? lods[i].error / cacheMesh.boundingSphere.w : 0.0f;
+            geometry.indices.insert(geometry.indices.end(), lods[i].indices.begin(), lods[i].indices.end());
+        }
+
+        MeshletData meshlets = buildMeshlets(mesh, mesh.indices);
+        cacheMesh.firstMeshlet = static_cast<uint32_t>(geometry.meshlets.size());
+        cacheMesh.meshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+        for (const auto& meshlet : meshlets.meshlets) {
+            MeshletBounds bounds = computeMeshletBounds(mesh, meshlets, meshlet);
+
+            MeshCacheMeshlet cacheMeshlet {};
+            cacheMeshlet.boundingSphere = bounds.sphere;
+            cacheMeshlet.coneApex = glm::vec4(bounds.coneApex, 1.0f);
+            cacheMeshlet.coneAxisCutoff = glm::vec4(bounds.coneAxis, bounds.coneCutoff);
+            cacheMeshlet.firstIndex = static_cast<uint32_t>(geometry.indices.size());
+            cacheMeshlet.indexCount = meshlet.triangleCount * 3;
+            geometry.meshlets.push_back(cacheMeshlet);
+
+            for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++) {
+                uint8_t local = meshlets.triangles[meshlet.triangleOffset * 3 + i];
+                geometry.indices.push_back(meshlets.vertices[meshlet.vertexOffset + local]);
+            }
+        }
+
+        geometry.meshes.push_back(cacheMesh);
+        convertVertices(mesh.vertices, vertexFormat, quantization, geometry.vertexData);
+        geometry.vertexCount += mesh.vertices.size();
+    }
+
+    return geometry;
+}
+
+void writeMeshCache(const std::string& path, const SceneGeometry& geometry)
+{
+    MeshCacheHeader header {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertexStride = getVertexStride(geometry.vertexFormat);
+    header.meshCount = static_cast<uint32_t>(geometry.meshes.size());
+    header.vertexFormat = geometry.vertexFormat;
+    header.meshletCount = geometry.meshlets.size();
+    header.vertexCount = geometry.vertexCount;
+    header.indexCount = geometry.indices.size();
+    header.meshesOffset = alignOffset(sizeof(MeshCacheHeader));
+    header.meshletsOffset = alignOffset(header.meshesOffset + geometry.meshes.size() * sizeof(MeshCacheMesh));
+    header.verticesOffset = alignOffset(header.meshletsOffset + geometry.meshlets.size() * sizeof(MeshCacheMeshlet));
+    header.indicesOffset = alignOffset(header.verticesOffset + geometry.vertexData.size());
+    uint64_t fileSize = header.indicesOffset + geometry.indices.size() * sizeof(uint32_t);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to create " + path + "!");
+    }
+
+    writeSection(file, 0, &header, sizeof(header));
+    writeSection(file, header.meshesOffset, geometry.meshes.data(), geometry.meshes.size() * sizeof(MeshCacheMesh));
+    writeSection(file, header.meshletsOffset, geometry.meshlets.data(), geometry.meshlets.size() * sizeof(MeshCacheMeshlet));
+    writeSection(file, header.verticesOffset, geometry.vertexData.data(), geometry.vertexData.size());
+    writeSection(file, header.indicesOffset, geometry.indices.data(), geometry.indices.size() * sizeof(uint32_t));
+
+    if (!file || static_cast<uint64_t>(file.tellp()) != fileSize) {
+        throw std::runtime_error("failed to write " + path + "!");
+    }
+}
+
+SceneGeometryView viewSceneGeometry(const SceneGeometry& geometry)
+{
+    SceneGeometryView view;
+    view.meshes = geometry.meshes.data();
+    view.meshCount = static_cast<uint32_t>(geometry.meshes.size());
+    view.meshlets = geometry.meshlets.data();
+    view.meshletCount = geometry.meshlets.size();
+    view.vertexFormat = geometry.vertexFormat;
+    view.vertexData = geometry.vertexData.data();
+    view.vertexCount = geometry.vertexCount;
+    view.indices = geometry.indices.data();
+    view.indexCount = geometry.indices.size();
+    return view;
+}
+
+SceneGeometryView viewMeshCache(const MappedFile& file)
+{
+    if (file.size < sizeof(MeshCacheHeader)) {
+        throw std::runtime_error("mesh cache is truncated!");
+    }
+
+    MeshCacheHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (header.magic != MESH_CACHE_MAGIC) {
+        throw std::runtime_error("not a mesh cache!");
+    }
+    bool knownFormat = header.vertexFormat == VertexFormat::Float32 || header.vertexFormat == VertexFormat::Packed;
+    if (header.version != MESH_CACHE_VERSION || !knownFormat || header.vertexStride != getVertexStride(header.vertexFormat)) {
+        throw std::runtime_error("mesh cache was written by another version, rebuild it!");
+    }
+
+    auto checkSection = [&](uint64_t offset, uint64_t count, uint64_t stride) {
+        if (offset % MESH_CACHE_ALIGNMENT != 0 || offset > file.size || count > (file.size - offset) / stride) {
+            throw std::runtime_error("mesh cache is truncated!");
+        }
+    };
+    checkSection(header.meshesOffset, header.meshCount, sizeof(MeshCacheMesh));
+    checkSection(header.meshletsOffset, header.meshletCount, sizeof(MeshCacheMeshlet));
+    checkSection(header.verticesOffset, header.vertexCount, header.vertexStride);
+    checkSection(header.indicesOffset, header.indexCount, sizeof(uint32_t));
+
+    SceneGeometryView view;
+    view.meshes = reinterpret_cast<const MeshCacheMesh*>(file.data + header.meshesOffset);
+    view.meshCount = header.meshCount;
+    view.meshlets = reinterpret_cast<const MeshCacheMeshlet*>(file.data + header.meshletsOffset);
+    view.meshletCount = header.meshletCount;
+    view.vertexFormat = header.vertexFormat;
+    view.vertexData = file.data + header.verticesOffset;
+    view.vertexCount = header.vertexCount;
+    view.indices = reinterpret_cast<const uint32_t*>(file.data + header.indicesOffset);
+    view.indexCount = header.indexCount;
+
+    // nothing the gpu reads may point outside the payloads: every range of
+    // the mesh and meshlet tables has to lie in the index buffer, and every
+    // index it covers has to land on a vertex of the mesh. a cache failing
+    // this is stale or damaged and gets rebuilt
+    auto checkIndices = [&](uint64_t firstIndex, uint64_t indexCount, uint64_t meshVertexCount, const char* table) {
+        if (firstIndex + indexCount > view.indexCount) {
+            throw std::runtime_error(std::string("mesh cache has an invalid ") + table + "!");
+        }
+        for (uint64_t i = firstIndex; i < firstIndex + indexCount; i++) {
+            if (view.indices[i] >= meshVertexCount) {
+                throw std::runtime_error(std::string("mesh cache has an invalid ") + table + "!");
+            }
+        }
+    };
+    for (uint32_t i = 0; i < view.meshCount; i++) {
+        const MeshCacheMesh& mesh = view.meshes[i];
+        if (mesh.lodCount == 0 || mesh.lodCount > MAX_MESH_LODS || mesh.vertexOffset < 0 || static_cast<uint64_t>(mesh.vertexOffset) >= view.vertexCount
+            || static_cast<uint64_t>(mesh.firstMeshlet) + mesh.meshletCount > view.meshletCount) {
+            throw std::runtime_error("mesh cache has an invalid mesh table!");
+        }
+
+        uint64_t meshVertexCount = view.vertexCount - static_cast<uint64_t>(mesh.vertexOffset);
+        for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+            checkIndices(mesh.lods[lod].firstIndex, mesh.lods[lod].indexCount, meshVertexCount, "mesh table");
+        }
+        for (uint32_t meshlet = mesh.firstMeshlet; meshlet < mesh.firstMeshlet + mesh.meshletCount; meshlet++) {
+            checkIndices(view.meshlets[meshlet].firstIndex, view.meshlets[meshlet].indexCount, meshVertexCount, "meshlet table");
+        }
+    }
+    for (uint64_t i = 0; i < view.meshletCount; i++) {
+        if (static_cast<uint64_t>(view.meshlets[i].firstIndex) + view.meshlets[i].indexCount > view.indexCount) {
+            throw std::runtime_error("mesh cache has an invalid meshlet table!");
+        }
+    }
+
+    return view;
+}
+
+void writeTextureCache(const std::string& path, const TextureCacheData& cache)
+{
+    TextureCacheHeader header {};
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = cache.format;
+    header.textureCount = static_cast<uint32_t>(cache.textures.size());
+    header.texturesOffset = alignOffset(sizeof(TextureCacheHeader));
+    header.dataOffset = alignOffset(header.texturesOffset + cache.textures.size() * sizeof(TextureCacheTexture));
+    uint64_t fileSize = header.dataOffset + cache.data.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to create " + path + "!");
+    }
+
+    writeSection(file, 0, &header, sizeof(header));
+    writeSection(file, header.texturesOffset, cache.textures.data(), cache.textures.size() * sizeof(TextureCacheTexture));
+    writeSection(file, header.dataOffset, cache.data.data(), cache.data.size());
+
+    if (!file || static_cast<uint64_t>(file.tellp()) != fileSize) {
+        throw std::runtime_error("failed to write " + path + "!");
+    }
+}
+
+TextureCacheView viewTextureCache(const MappedFile& file)
+{
+    if (file.size < sizeof(TextureCacheHeader)) {
+        throw std::runtime_error("texture cache is truncated!");
+    }
+
+    TextureCacheHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (header.magic != TEXTURE_CACHE_MAGIC) {
+        throw std::runtime_error("not a texture cache!");
+    }
+    if (header.version != TEXTURE_CACHE_VERSION || header.format > TextureFormat::Bc7) {
+        throw std::runtime_error("texture cache was written by another version, rebuild it!");
+    }
+    if (header.texturesOffset % MESH_CACHE_ALIGNMENT != 0 || header.dataOffset % MESH_CACHE_ALIGNMENT != 0 || header.dataOffset > file.size
+        || header.texturesOffset > header.dataOffset || header.textureCount > (header.dataOffset - header.texturesOffset) / sizeof(TextureCacheTexture)) {
+        throw std::runtime_error("texture cache is truncated!");
+    }
+
+    TextureCacheView view;
+    view.format = header.format;
+    view.textures = reinterpret_cast<const TextureCacheTexture*>(file.data + header.texturesOffset);
+    view.textureCount = header.textureCount;
+    view.data = file.data + header.dataOffset;
+
+    uint64_t dataSize = file.size - header.dataOffset;
+    for (uint32_t i = 0; i < view.textureCount; i++) {
+        const TextureCacheTexture& texture = view.textures[i];
+        if (texture.width == 0 || texture.height == 0 || texture.mipCount == 0 || texture.mipCount > MAX_TEXTURE_MIPS) {
+            throw std::runtime_error("texture cache has an invalid texture table!");
+        }
+        for (uint32_t mip = 0; mip < texture.mipCount; mip++) {
+            uint64_t mipBytes = getTextureMipBytes(view.format, std::max(1u, texture.width >> mip), std::max(1u, texture.height >> mip));
+            if (texture.mipOffsets[mip] > dataSize || mipBytes > dataSize - texture.mipOffsets[mip]) {
+                throw std::runtime_error("texture cache is truncated!");
+            }
+        }
+    }
+
+    return view;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "mesh.h"
+#include "meshlet.h"
+#include "vertex_format.h"
+#include "mesh_simplify.h"
+#include "texture_compress.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// binary mesh cache, little endian:
+//   MeshCacheHeader
+//   MeshCacheMesh[meshCount]  at meshesOffset
+//   MeshCacheMeshlet[meshletCount] at meshletsOffset
+//   vertices[vertexCount]     at verticesOffset, Vertex or PackedVertex
+//   uint32_t[indexCount]      at indicesOffset
+// every section starts on a MESH_CACHE_ALIGNMENT boundary, so a mapped file
+// can be read in place without any parsing
+
+const uint32_t MESH_CACHE_MAGIC = 0x434d5646; // "FVMC"
+const uint32_t MESH_CACHE_VERSION = 3;
+const uint64_t MESH_CACHE_ALIGNMENT = 4096;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    // catches files written with a different vertex layout
+    uint32_t vertexStride;
+    uint32_t meshCount;
+    VertexFormat vertexFormat;
+    uint32_t padding;
+    uint64_t meshletCount;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t meshesOffset;
+    uint64_t meshletsOffset;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+};
+
+// mirrors MeshLod in shaders/common.glsl
+struct MeshCacheLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // relative to the bounding sphere radius of the mesh
+    float error;
+    uint32_t padding;
+};
+
+// mirrors MeshInfo in shaders/common.glsl, so the mesh table can be uploaded
+// as is
+struct MeshCacheMesh {
+    glm::vec4 boundingSphere;
+    // maps packed positions back to mesh space, see VertexQuantization
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+    int32_t vertexOffset;
+    uint32_t lodCount;
+    // meshlets cover lod 0 only
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    MeshCacheLod lods[MAX_MESH_LODS];
+};
+
+// mirrors MeshletInfo in shaders/common.glsl. the triangles of a meshlet are
+// stored as a regular range of the shared index buffer, so clusters can be
+// drawn with plain indexed draws
+struct MeshCacheMeshlet {
+    glm::vec4 boundingSphere;
+    glm::vec4 coneApex;
+    // xyz is the axis, w the cutoff, see MeshletBounds
+    glm::vec4 coneAxisCutoff;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t padding[2];
+};
+
+// what the importer produces and writeMeshCache stores
+struct SceneGeometry {
+    std::vector<MeshCacheMesh> meshes;
+    std::vector<MeshCacheMeshlet> meshlets;
+    VertexFormat vertexFormat = VertexFormat::Float32;
+    std::vector<uint8_t> vertexData;
+    uint64_t vertexCount = 0;
+    std::vector<uint32_t> indices;
+};
+
+// read only view of scene geometry, either backed by a SceneGeometry or
+// pointing straight into a mapped cache file
+struct SceneGeometryView {
+    const MeshCacheMesh* meshes = nullptr;
+    uint32_t meshCount = 0;
+    const MeshCacheMeshlet* meshlets = nullptr;
+    uint64_t meshletCount = 0;
+    VertexFormat vertexFormat = VertexFormat::Float32;
+    const void* vertexData = nullptr;
+    uint64_t vertexCount = 0;
+    const uint32_t* indices = nullptr;
+    uint64_t indexCount = 0;
+};
+
+// binary texture cache, little endian:
+//   TextureCacheHeader
+//   TextureCacheTexture[textureCount] at texturesOffset
+//   mip data                         at dataOffset
+// every texture stores its full mip chain in one format, finest mip first,
+// ready to be copied into an image as is
+
+const uint32_t TEXTURE_CACHE_MAGIC = 0x43545646; // "FVTC"
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+const uint32_t MAX_TEXTURE_MIPS = 16;
+
+struct TextureCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    TextureFormat format;
+    uint32_t textureCount;
+    uint64_t texturesOffset;
+    uint64_t dataOffset;
+};
+
+struct TextureCacheTexture {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t padding;
+    // relative to dataOffset, each mip is getTextureMipBytes long
+    uint64_t mipOffsets[MAX_TEXTURE_MIPS];
+};
+
+// what the texture cooker produces and writeTextureCache stores
+struct TextureCacheData {
+    TextureFormat format = TextureFormat::Rgba8;
+    std::vector<TextureCacheTexture> textures;
+    std::vector<uint8_t> data;
+};
+
+struct TextureCacheView {
+    TextureFormat format = TextureFormat::Rgba8;
+    const TextureCacheTexture* textures = nullptr;
+    uint32_t textureCount = 0;
+    const uint8_t* data = nullptr;
+};
+
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+[[nodiscard]] MappedFile mapFile(const std::string& path);
+void unmapFile(MappedFile& file);
+
+// triangulated obj with positions and optional uvs and normals, normals are
+// generated when the file has none
+[[nodiscard]] MeshData loadObjMesh(const std::string& path);
+
+// optimizes every mesh for the vertex cache, overdraw and vertex fetch, then
+// packs them into shared vertex and index arrays along with their lod chains
+// and meshlets
+[[nodiscard]] SceneGeometry buildSceneGeometry(const std::vector<MeshData>& meshes, VertexFormat vertexFormat);
+
+void writeMeshCache(const std::string& path, const SceneGeometry& geometry);
+
+[[nodiscard]] SceneGeometryView viewSceneGeometry(const SceneGeometry& geometry);
+
+// validates the header and section bounds, the view stays valid as long as
+// the file is mapped
+[[nodiscard]] SceneGeometryView viewMeshCache(const MappedFile& file);
+
+void writeTextureCache(const std::string& path, const TextureCacheData& cache);
+
+// validates the header and that every mip lies inside the file
+[[nodiscard]] TextureCacheView viewTextureCache(const MappedFile& file);
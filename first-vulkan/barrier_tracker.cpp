@@ -0,0 +1,214 @@
+#include "barrier_tracker.h"
+
+#include <stdexcept>
+#include <utility>
+
+void trackImage(BarrierTracker& tracker, uint64_t image, uint32_t mipCount, uint32_t layout)
+{
+    TrackedMip mip {};
+    mip.layout = layout;
+    tracker.images[image].assign(mipCount, mip);
+}
+
+void forgetImage(BarrierTracker& tracker, uint64_t image)
+{
+    tracker.images.erase(image);
+}
+
+// the dependency the use needs on whatever came before it, same rules as
+// the frame graph. false if the mip is already in the right layout and
+// visible to it
+[[nodiscard]] static bool findDependency(const TrackedMip& mip, uint64_t stages, uint64_t access, uint32_t layout, bool write, TrackedImageBarrier& barrier)
+{
+    bool layoutChange = layout != mip.layout;
+
+    barrier.srcStages = 0;
+    barrier.srcAccess = 0;
+    barrier.oldLayout = mip.layout;
+    barrier.newLayout = layout;
+
+    if (write || layoutChange) {
+        barrier.srcStages = mip.writeStages | mip.readStages;
+        barrier.srcAccess = mip.writeAccess;
+    } else if (mip.writeStages != 0 && ((stages & ~mip.visibleStages) != 0 || (access & ~mip.visibleAccess) != 0)) {
+        barrier.srcStages = mip.writeStages;
+        barrier.srcAccess = mip.writeAccess;
+    }
+
+    if (barrier.srcStages == 0 && !layoutChange) {
+        return false;
+    }
+
+    barrier.dstStages = stages;
+    barrier.dstAccess = access;
+    return true;
+}
+
+static void applyUse(TrackedMip& mip, uint64_t stages, uint64_t access, uint32_t layout, bool write, bool barrierRecorded)
+{
+    if (write) {
+        mip.writeStages = stages;
+        mip.writeAccess = access;
+        mip.readStages = 0;
+        mip.visibleStages = 0;
+        mip.visibleAccess = 0;
+    } else if (layout != mip.layout) {
+        mip.writeStages = stages;
+        mip.writeAccess = 0;
+        mip.readStages = stages;
+        mip.visibleStages = stages;
+        mip.visibleAccess = access;
+    } else {
+        mip.readStages |= stages;
+        if (barrierRecorded) {
+            mip.visibleStages |= stages;
+            mip.visibleAccess |= access;
+        }
+    }
+    mip.layout = layout;
+}
+
+[[nodiscard]] static bool sameTransition(const TrackedImageBarrier& a, const TrackedImageBarrier& b)
+{
+    return a.image == b.image && a.srcStages == b.srcStages && a.srcAccess == b.srcAccess && a.dstStages == b.dstStages
+        && a.dstAccess == b.dstAccess && a.oldLayout == b.oldLayout && a.newLayout == b.newLayout;
+}
+
+static void addToBatch(const TrackedImageBarrier& barrier, TrackedBatch& batch)
+{
+    batch.srcStages |= barrier.srcStages;
+    batch.dstStages |= barrier.dstStages;
+
+    // uses are declared a range at a time, so only the last barrier can
+    // continue this one
+    if (!batch.imageBarriers.empty()) {
+        TrackedImageBarrier& last = batch.imageBarriers.back();
+        if (sameTransition(last, barrier) && last.baseMip + last.mipCount == barrier.baseMip) {
+            last.mipCount += barrier.mipCount;
+            return;
+        }
+    }
+    batch.imageBarriers.push_back(barrier);
+}
+
+static void addUse(BarrierTracker& tracker, TrackedBatch& batch, uint64_t image, uint32_t baseMip, uint32_t mipCount, uint64_t stages, uint64_t access, uint32_t layout, bool write)
+{
+    auto found = tracker.images.find(image);
+    if (found == tracker.images.end() || baseMip + mipCount > found->second.size()) {
+        throw std::runtime_error("barrier tracker used with an image it doesn't track!");
+    }
+
+    bool anyBarrier = false;
+    for (uint32_t i = baseMip; i < baseMip + mipCount; i++) {
+        TrackedMip& mip = found->second[i];
+
+        TrackedImageBarrier barrier {};
+        barrier.image = image;
+        barrier.baseMip = i;
+        barrier.mipCount = 1;
+        bool barrierRecorded = findDependency(mip, stages, access, layout, write, barrier);
+        if (barrierRecorded) {
+            // the queued barrier already stands between the previous use and
+            // this one, a second one can't go into the same batch
+            if (mip.pending) {
+                throw std::runtime_error("image used again before its barriers were recorded!");
+            }
+            mip.pending = true;
+            addToBatch(barrier, batch);
+            anyBarrier = true;
+        }
+        applyUse(mip, stages, access, layout, write, barrierRecorded);
+    }
+
+    if (!anyBarrier) {
+        tracker.frameCounts.elided++;
+    }
+}
+
+void useImage(BarrierTracker& tracker, uint64_t image, uint32_t baseMip, uint32_t mipCount, uint64_t stages, uint64_t access, uint32_t layout, bool write)
+{
+    addUse(tracker, tracker.pending, image, baseMip, mipCount, stages, access, layout, write);
+}
+
+void useMemory(BarrierTracker& tracker, uint64_t srcStages, uint64_t srcAccess, uint64_t dstStages, uint64_t dstAccess)
+{
+    TrackedBatch& batch = tracker.pending;
+    batch.srcStages |= srcStages;
+    batch.dstStages |= dstStages;
+    batch.memorySrcAccess |= srcAccess;
+    batch.memoryDstAccess |= dstAccess;
+    batch.memoryBarrier = true;
+}
+
+void releaseImage(BarrierTracker& tracker, uint64_t image, uint32_t baseMip, uint32_t mipCount, uint64_t stages, uint64_t access, uint32_t layout)
+{
+    addUse(tracker, tracker.released, image, baseMip, mipCount, stages, access, layout, false);
+}
+
+void acquireImage(BarrierTracker& tracker, uint64_t image, uint32_t baseMip, uint32_t mipCount, uint64_t stages, uint64_t access, uint32_t layout)
+{
+    auto found = tracker.images.find(image);
+    if (found == tracker.images.end() || baseMip + mipCount > found->second.size()) {
+        throw std::runtime_error("barrier tracker used with an image it doesn't track!");
+    }
+
+    for (uint32_t i = baseMip; i < baseMip + mipCount; i++) {
+        TrackedMip& mip = found->second[i];
+        mip.writeStages = stages;
+        mip.writeAccess = 0;
+        mip.readStages = 0;
+        mip.visibleStages = stages;
+        mip.visibleAccess = access;
+        mip.layout = layout;
+    }
+}
+
+static TrackedBatch takeBatch(BarrierTracker& tracker, TrackedBatch& batch)
+{
+    TrackedBatch taken = std::move(batch);
+    batch = {};
+
+    for (const auto& barrier : taken.imageBarriers) {
+        auto found = tracker.images.find(barrier.image);
+        if (found == tracker.images.end()) {
+            continue;
+        }
+        for (uint32_t i = barrier.baseMip; i < barrier.baseMip + barrier.mipCount; i++) {
+            found->second[i].pending = false;
+        }
+    }
+
+    if (taken.memoryBarrier || !taken.imageBarriers.empty()) {
+        tracker.frameCounts.issued += static_cast<uint32_t>(taken.imageBarriers.size()) + (taken.memoryBarrier ? 1 : 0);
+        tracker.frameCounts.batches++;
+    }
+    return taken;
+}
+
+TrackedBatch takePendingBarriers(BarrierTracker& tracker)
+{
+    return takeBatch(tracker, tracker.pending);
+}
+
+TrackedBatch takeReleasedBarriers(BarrierTracker& tracker)
+{
+    return takeBatch(tracker, tracker.released);
+}
+
+void endBarrierFrame(BarrierTracker& tracker)
+{
+    tracker.totalCounts.issued += tracker.frameCounts.issued;
+    tracker.totalCounts.elided += tracker.frameCounts.elided;
+    tracker.totalCounts.batches += tracker.frameCounts.batches;
+    tracker.lastFrameCounts = tracker.frameCounts;
+    tracker.frameCounts = {};
+    tracker.frameCount++;
+}
+
+void resetBarrierCounts(BarrierTracker& tracker)
+{
+    tracker.frameCounts = {};
+    tracker.lastFrameCounts = {};
+    tracker.totalCounts = {};
+    tracker.frameCount = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// remembers the layout and last access of every mip of the images recorded
+// outside the frame graph, so each use only asks for what it is about to do
+// and the barrier, if one is needed at all, follows from that. like the
+// frame graph it works on VkPipelineStageFlags and VkAccessFlags values and
+// VkImageLayout values, images are keyed by their handle
+struct TrackedMip {
+    // stages and access of the last write, or of the last layout transition
+    uint64_t writeStages = 0;
+    uint64_t writeAccess = 0;
+    // stages that read since then
+    uint64_t readStages = 0;
+    // the write has been made visible to these already
+    uint64_t visibleStages = 0;
+    uint64_t visibleAccess = 0;
+    uint32_t layout = 0;
+    // a barrier for the mip is waiting to be recorded
+    bool pending = false;
+};
+
+struct TrackedImageBarrier {
+    uint64_t image;
+    uint32_t baseMip;
+    uint32_t mipCount;
+    uint64_t srcStages;
+    uint64_t srcAccess;
+    uint64_t dstStages;
+    uint64_t dstAccess;
+    uint32_t oldLayout;
+    uint32_t newLayout;
+};
+
+// one vkCmdPipelineBarrier, or one event signal and wait. buffers aren't
+// tracked, their dependencies share one global memory barrier
+struct TrackedBatch {
+    uint64_t srcStages = 0;
+    uint64_t dstStages = 0;
+    uint64_t memorySrcAccess = 0;
+    uint64_t memoryDstAccess = 0;
+    bool memoryBarrier = false;
+    std::vector<TrackedImageBarrier> imageBarriers;
+};
+
+struct BarrierCounts {
+    uint32_t issued = 0;
+    // uses that found the mips in the right layout and already visible
+    uint32_t elided = 0;
+    uint32_t batches = 0;
+};
+
+struct BarrierTracker {
+    std::unordered_map<uint64_t, std::vector<TrackedMip>> images;
+    TrackedBatch pending;
+    // transitions whose destination is a long way off, recorded as a split
+    // barrier: the source half right after the work that released them, the
+    // destination half where they are first needed
+    TrackedBatch released;
+    BarrierCounts frameCounts;
+    BarrierCounts lastFrameCounts;
+    BarrierCounts totalCounts;
+    uint32_t frameCount = 0;
+};
+
+// starts tracking an image, with every mip in layout and nothing to wait for
+void trackImage(BarrierTracker& tracker, uint64_t image, uint32_t mipCount, uint32_t layout);
+void forgetImage(BarrierTracker& tracker, uint64_t image);
+
+// the next command uses mips baseMip to baseMip + mipCount - 1 like this.
+// queues the barrier that needs, if any, until takePendingBarriers
+void useImage(BarrierTracker& tracker, uint64_t image, uint32_t baseMip, uint32_t mipCount, uint64_t stages, uint64_t access, uint32_t layout, bool write);
+
+// a dependency on buffer memory, added to the pending batch as it is
+void useMemory(BarrierTracker& tracker, uint64_t srcStages, uint64_t srcAccess, uint64_t dstStages, uint64_t dstAccess);
+
+// like useImage, for a use that isn't recorded yet. the barrier goes into the
+// released batch
+void releaseImage(BarrierTracker& tracker, uint64_t image, uint32_t baseMip, uint32_t mipCount, uint64_t stages, uint64_t access, uint32_t layout);
+
+// the mips were handed over by a barrier recorded outside the tracker, a queue
+// family acquire, which left them in layout and visible to stages and access
+void acquireImage(BarrierTracker& tracker, uint64_t image, uint32_t baseMip, uint32_t mipCount, uint64_t stages, uint64_t access, uint32_t layout);
+
+// barriers on neighbouring mips that only differ in their range are merged
+[[nodiscard]] TrackedBatch takePendingBarriers(BarrierTracker& tracker);
+[[nodiscard]] TrackedBatch takeReleasedBarriers(BarrierTracker& tracker);
+
+// moves the counts of the frame into the totals
+void endBarrierFrame(BarrierTracker& tracker);
+// forgets the counts so far, so setup work isn't counted with the frames
+void resetBarrierCounts(BarrierTracker& tracker);
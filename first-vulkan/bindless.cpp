@@ -0,0 +1,51 @@
+#include "bindless.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+BindlessSlots makeBindlessSlots(uint32_t capacity)
+{
+    BindlessSlots slots;
+    slots.capacity = capacity;
+    return slots;
+}
+
+uint32_t allocateBindlessSlot(BindlessSlots& slots)
+{
+    if (!slots.freeSlots.empty()) {
+        uint32_t slot = slots.freeSlots.back();
+        slots.freeSlots.pop_back();
+        return slot;
+    }
+
+    if (slots.nextUnused == slots.capacity) {
+        throw std::runtime_error("bindless descriptor array is full!");
+    }
+
+    return slots.nextUnused++;
+}
+
+void releaseBindlessSlot(BindlessSlots& slots, uint32_t slot, uint64_t frameNumber)
+{
+    if (slot >= slots.nextUnused) {
+        throw std::runtime_error("released a bindless slot that was never allocated!");
+    }
+
+    slots.pendingSlots.emplace_back(slot, frameNumber);
+}
+
+void reclaimBindlessSlots(BindlessSlots& slots, uint64_t completedFrame)
+{
+    auto reusable = std::stable_partition(slots.pendingSlots.begin(), slots.pendingSlots.end(),
+        [completedFrame](const auto& pending) { return pending.second > completedFrame; });
+
+    for (auto it = reusable; it != slots.pendingSlots.end(); ++it) {
+        slots.freeSlots.push_back(it->first);
+    }
+    slots.pendingSlots.erase(reusable, slots.pendingSlots.end());
+}
+
+uint32_t getBindlessSlotsInUse(const BindlessSlots& slots)
+{
+    return slots.nextUnused - static_cast<uint32_t>(slots.freeSlots.size() + slots.pendingSlots.size());
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// hands out the slots of one array in the bindless descriptor set. a released
+// slot may still be referenced by frames in flight, so it only goes back on
+// the free list once the frame it was released in has finished
+struct BindlessSlots {
+    uint32_t capacity = 0;
+    // slots below this have been handed out at least once
+    uint32_t nextUnused = 0;
+    std::vector<uint32_t> freeSlots;
+    // slot and the number of the frame it was released in
+    std::vector<std::pair<uint32_t, uint64_t>> pendingSlots;
+};
+
+[[nodiscard]] BindlessSlots makeBindlessSlots(uint32_t capacity);
+
+// reuses freed slots first, so the array stays densely packed
+[[nodiscard]] uint32_t allocateBindlessSlot(BindlessSlots& slots);
+void releaseBindlessSlot(BindlessSlots& slots, uint32_t slot, uint64_t frameNumber);
+// frees every slot released in completedFrame or earlier
+void reclaimBindlessSlots(BindlessSlots& slots, uint64_t completedFrame);
+
+[[nodiscard]] uint32_t getBindlessSlotsInUse(const BindlessSlots& slots);
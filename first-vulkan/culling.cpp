@@ -0,0 +1,328 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <glm/geometric.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE2
+#endif
+
+void SphereBounds::add(const glm::vec4& sphere)
+{
+    centerX.push_back(sphere.x);
+    centerY.push_back(sphere.y);
+    centerZ.push_back(sphere.z);
+    radius.push_back(sphere.w);
+}
+
+void SphereBounds::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+}
+
+void AabbBounds::add(const glm::vec3& min, const glm::vec3& max)
+{
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+}
+
+void AabbBounds::clear()
+{
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+FrustumPlanes extractFrustumPlanes(const glm::mat4& viewProj)
+{
+    // glm is column major, so the rows have to be gathered by hand
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+
+    FrustumPlanes planes = {
+        rows[3] + rows[0],
+        rows[3] - rows[0],
+        rows[3] + rows[1],
+        rows[3] - rows[1],
+        rows[2],
+        rows[3] - rows[2],
+    };
+
+    for (auto& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return planes;
+}
+
+bool isSphereInFrustum(const FrustumPlanes& planes, const glm::vec4& sphere)
+{
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void cullSpheresScalar(const FrustumPlanes& planes, const std::vector<glm::vec4>& spheres, std::vector<uint32_t>& visible)
+{
+    for (uint32_t i = 0; i < spheres.size(); i++) {
+        if (isSphereInFrustum(planes, spheres[i])) {
+            visible.push_back(i);
+        }
+    }
+}
+
+[[nodiscard]] static bool isAabbInFrustum(const FrustumPlanes& planes, const glm::vec3& min, const glm::vec3& max)
+{
+    for (const auto& plane : planes) {
+        // only the corner furthest along the plane normal matters
+        glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// writes every candidate index and only advances the output when the lane was
+// visible, which keeps the compaction free of unpredictable branches
+static uint32_t appendVisibleLanes(uint32_t* output, uint32_t base, uint32_t laneCount, int mask)
+{
+    uint32_t count = 0;
+    for (uint32_t lane = 0; lane < laneCount; lane++) {
+        output[count] = base + lane;
+        count += (mask >> lane) & 1;
+    }
+    return count;
+}
+
+void cullSpheres(const FrustumPlanes& planes, const SphereBounds& bounds, uint32_t begin, uint32_t end, std::vector<uint32_t>& visible)
+{
+    size_t first = visible.size();
+    visible.resize(first + (end - begin));
+    uint32_t* output = visible.data() + first;
+    uint32_t count = 0;
+    uint32_t i = begin;
+
+#if defined(CULLING_AVX)
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&bounds.centerX[i]);
+        __m256 y = _mm256_loadu_ps(&bounds.centerY[i]);
+        __m256 z = _mm256_loadu_ps(&bounds.centerZ[i]);
+        __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[i]));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : planes) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+                _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+        }
+
+        count += appendVisibleLanes(output + count, i, 8, _mm256_movemask_ps(inside));
+    }
+#elif defined(CULLING_SSE2)
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 y = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 z = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : planes) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+        }
+
+        count += appendVisibleLanes(output + count, i, 4, _mm_movemask_ps(inside));
+    }
+#endif
+
+    for (; i < end; i++) {
+        glm::vec4 sphere(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.radius[i]);
+        output[count] = i;
+        count += isSphereInFrustum(planes, sphere) ? 1 : 0;
+    }
+
+    visible.resize(first + count);
+}
+
+void cullAabbs(const FrustumPlanes& planes, const AabbBounds& bounds, uint32_t begin, uint32_t end, std::vector<uint32_t>& visible)
+{
+    size_t first = visible.size();
+    visible.resize(first + (end - begin));
+    uint32_t* output = visible.data() + first;
+    uint32_t count = 0;
+    uint32_t i = begin;
+
+    // the corner to test only depends on the plane, so it is picked once per
+    // plane by choosing which of the min and max arrays to load from
+    struct PlaneCorner {
+        const float* x;
+        const float* y;
+        const float* z;
+    };
+    std::array<PlaneCorner, 6> corners;
+    for (size_t p = 0; p < planes.size(); p++) {
+        corners[p].x = planes[p].x >= 0.0f ? bounds.maxX.data() : bounds.minX.data();
+        corners[p].y = planes[p].y >= 0.0f ? bounds.maxY.data() : bounds.minY.data();
+        corners[p].z = planes[p].z >= 0.0f ? bounds.maxZ.data() : bounds.minZ.data();
+    }
+
+#if defined(CULLING_AVX)
+    for (; i + 8 <= end; i += 8) {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t p = 0; p < planes.size(); p++) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(corners[p].x + i), _mm256_set1_ps(planes[p].x)),
+                    _mm256_mul_ps(_mm256_loadu_ps(corners[p].y + i), _mm256_set1_ps(planes[p].y))),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(corners[p].z + i), _mm256_set1_ps(planes[p].z)), _mm256_set1_ps(planes[p].w)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        count += appendVisibleLanes(output + count, i, 8, _mm256_movemask_ps(inside));
+    }
+#elif defined(CULLING_SSE2)
+    for (; i + 4 <= end; i += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (size_t p = 0; p < planes.size(); p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(corners[p].x + i), _mm_set1_ps(planes[p].x)),
+                    _mm_mul_ps(_mm_loadu_ps(corners[p].y + i), _mm_set1_ps(planes[p].y))),
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(corners[p].z + i), _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+
+        count += appendVisibleLanes(output + count, i, 4, _mm_movemask_ps(inside));
+    }
+#endif
+
+    for (; i < end; i++) {
+        glm::vec3 min(bounds.minX[i], bounds.minY[i], bounds.minZ[i]);
+        glm::vec3 max(bounds.maxX[i], bounds.maxY[i], bounds.maxZ[i]);
+        output[count] = i;
+        count += isAabbInFrustum(planes, min, max) ? 1 : 0;
+    }
+
+    visible.resize(first + count);
+}
+
+// takes chunks until there are none left, called with the lock held
+static void cullChunks(CullingWorkers& workers, std::unique_lock<std::mutex>& lock)
+{
+    uint32_t chunkCount = static_cast<uint32_t>(workers.visibleChunks->size());
+    uint32_t total = workers.bounds->size();
+
+    while (workers.nextChunk < chunkCount) {
+        uint32_t chunk = workers.nextChunk++;
+        lock.unlock();
+
+        uint32_t begin = std::min(total, chunk * workers.chunkSize);
+        uint32_t end = std::min(total, begin + workers.chunkSize);
+        std::vector<uint32_t>& visible = (*workers.visibleChunks)[chunk];
+        visible.clear();
+        cullSpheres(*workers.planes, *workers.bounds, begin, end, visible);
+
+        lock.lock();
+    }
+}
+
+static void runCullingWorker(CullingWorkers& workers)
+{
+    // started before the first call, which is generation 1
+    std::unique_lock<std::mutex> lock(workers.mutex);
+    uint64_t generation = 0;
+
+    while (true) {
+        workers.wake.wait(lock, [&] { return workers.stopping || workers.generation != generation; });
+        if (workers.stopping) {
+            return;
+        }
+        generation = workers.generation;
+
+        cullChunks(workers, lock);
+        if (--workers.runningCount == 0) {
+            workers.finished.notify_one();
+        }
+    }
+}
+
+void startCullingWorkers(CullingWorkers& workers, uint32_t threadCount)
+{
+    workers.threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.threads.emplace_back(runCullingWorker, std::ref(workers));
+    }
+}
+
+void stopCullingWorkers(CullingWorkers& workers)
+{
+    {
+        std::lock_guard<std::mutex> lock(workers.mutex);
+        workers.stopping = true;
+    }
+    workers.wake.notify_all();
+
+    for (auto& thread : workers.threads) {
+        thread.join();
+    }
+    workers.threads.clear();
+}
+
+void cullSpheresParallel(CullingWorkers& workers, const FrustumPlanes& planes, const SphereBounds& bounds,
+    std::vector<std::vector<uint32_t>>& visibleChunks)
+{
+    uint32_t chunkCount = static_cast<uint32_t>(visibleChunks.size());
+    if (chunkCount == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(workers.mutex);
+    workers.planes = &planes;
+    workers.bounds = &bounds;
+    workers.visibleChunks = &visibleChunks;
+    // chunk boundaries are kept on multiples of 8 so only the last chunk
+    // ever runs the scalar tail
+    workers.chunkSize = ((bounds.size() + chunkCount - 1) / chunkCount + 7) & ~7u;
+    workers.nextChunk = 0;
+    workers.runningCount = static_cast<uint32_t>(workers.threads.size());
+    workers.generation++;
+    workers.wake.notify_all();
+
+    cullChunks(workers, lock);
+    // the chunks are all taken, but the last ones may still be running
+    workers.finished.wait(lock, [&] { return workers.runningCount == 0; });
+}
+
+const char* getCullingKernelName()
+{
+#if defined(CULLING_AVX)
+    return "avx";
+#elif defined(CULLING_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// left, right, bottom, top, near, far. xyz is the normalized inward facing
+// normal and w the distance, so dot(plane.xyz, p) + plane.w >= 0 is inside
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+// structure of arrays, so the kernels below can load 4 or 8 bounding volumes
+// into a register at once instead of shuffling vec4s around
+struct SphereBounds {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+
+    void add(const glm::vec4& sphere);
+    void clear();
+    [[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(radius.size()); }
+};
+
+struct AabbBounds {
+    std::vector<float> minX;
+    std::vector<float> minY;
+    std::vector<float> minZ;
+    std::vector<float> maxX;
+    std::vector<float> maxY;
+    std::vector<float> maxZ;
+
+    void add(const glm::vec3& min, const glm::vec3& max);
+    void clear();
+    [[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(minX.size()); }
+};
+
+// expects a projection with a [0, 1] depth range
+[[nodiscard]] FrustumPlanes extractFrustumPlanes(const glm::mat4& viewProj);
+
+[[nodiscard]] bool isSphereInFrustum(const FrustumPlanes& planes, const glm::vec4& sphere);
+
+// reference implementation, one glm::vec4 sphere at a time
+void cullSpheresScalar(const FrustumPlanes& planes, const std::vector<glm::vec4>& spheres, std::vector<uint32_t>& visible);
+
+// the kernels append the indices of the visible volumes in [begin, end) to
+// visible, in ascending order
+void cullSpheres(const FrustumPlanes& planes, const SphereBounds& bounds, uint32_t begin, uint32_t end, std::vector<uint32_t>& visible);
+void cullAabbs(const FrustumPlanes& planes, const AabbBounds& bounds, uint32_t begin, uint32_t end, std::vector<uint32_t>& visible);
+
+// threads that live across cullSpheresParallel calls, so a call only pays for
+// waking them. the calling thread culls alongside them
+struct CullingWorkers {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    // bumped for every call, the threads run each one once
+    uint64_t generation = 0;
+    uint32_t runningCount = 0;
+    bool stopping = false;
+    // the call being run, chunks are handed out in order
+    const FrustumPlanes* planes = nullptr;
+    const SphereBounds* bounds = nullptr;
+    std::vector<std::vector<uint32_t>>* visibleChunks = nullptr;
+    uint32_t chunkSize = 0;
+    uint32_t nextChunk = 0;
+};
+
+void startCullingWorkers(CullingWorkers& workers, uint32_t threadCount);
+void stopCullingWorkers(CullingWorkers& workers);
+
+// splits the bounds into visibleChunks.size() contiguous ranges and culls them
+// on the workers, chunk i ends up with the visible indices of range i
+void cullSpheresParallel(CullingWorkers& workers, const FrustumPlanes& planes, const SphereBounds& bounds,
+    std::vector<std::vector<uint32_t>>& visibleChunks);
+
+// name of the instruction set the kernels were compiled for
+[[nodiscard]] const char* getCullingKernelName();
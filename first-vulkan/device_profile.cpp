@@ -0,0 +1,127 @@
+#include "device_profile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iterator>
+
+// a discrete gpu wins over any integrated one whatever their memory, memory,
+// limits and features only rank devices of the same kind
+static const uint64_t KIND_SCORE_STEP = 1000000;
+static const uint64_t KIND_SCORES[] = {
+    1 * KIND_SCORE_STEP, // Other
+    3 * KIND_SCORE_STEP, // IntegratedGpu
+    4 * KIND_SCORE_STEP, // DiscreteGpu
+    2 * KIND_SCORE_STEP, // VirtualGpu
+    0, // Cpu
+};
+
+// one point per 16 MB, capped at 64 GB
+static const uint64_t MEMORY_SCORE_UNIT = 16ull * 1024 * 1024;
+static const uint64_t MAX_MEMORY_SCORE = 4096;
+
+// one point per 1024 texels of image size and per 128 workgroup invocations
+static const uint64_t MAX_LIMIT_SCORE = 256;
+
+static const uint64_t FEATURE_SCORE = 100;
+static const uint64_t MAX_FEATURE_COUNT = 16;
+
+static_assert(MAX_MEMORY_SCORE + 2 * MAX_LIMIT_SCORE + MAX_FEATURE_COUNT * FEATURE_SCORE < KIND_SCORE_STEP,
+    "memory, limits and features must never make up for a device kind");
+
+std::string readDeviceSelectionVariable()
+{
+#ifdef _WIN32
+    // getenv is deprecated with the sdl checks on
+    char* value = nullptr;
+    size_t length = 0;
+    if (_dupenv_s(&value, &length, DEVICE_SELECTION_VARIABLE) != 0 || value == nullptr) {
+        return "";
+    }
+    std::string selection = value;
+    free(value);
+    return selection;
+#else
+    const char* value = std::getenv(DEVICE_SELECTION_VARIABLE);
+    return value != nullptr ? value : "";
+#endif
+}
+
+const char* getDeviceKindName(DeviceKind kind)
+{
+    switch (kind) {
+    case DeviceKind::IntegratedGpu:
+        return "integrated gpu";
+    case DeviceKind::DiscreteGpu:
+        return "discrete gpu";
+    case DeviceKind::VirtualGpu:
+        return "virtual gpu";
+    case DeviceKind::Cpu:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+std::string formatDeviceUuid(const uint8_t* uuid)
+{
+    const char* digits = "0123456789abcdef";
+    std::string formatted;
+    for (int i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            formatted += '-';
+        }
+        formatted += digits[uuid[i] >> 4];
+        formatted += digits[uuid[i] & 15];
+    }
+    return formatted;
+}
+
+uint64_t scoreDeviceProfile(const DeviceProfile& profile)
+{
+    // the kind comes straight from the driver's device type, unknown ones
+    // score like Other
+    uint32_t kind = static_cast<uint32_t>(profile.kind);
+    uint64_t score = kind < std::size(KIND_SCORES) ? KIND_SCORES[kind] : KIND_SCORES[static_cast<uint32_t>(DeviceKind::Other)];
+    score += std::min(profile.deviceLocalBytes / MEMORY_SCORE_UNIT, MAX_MEMORY_SCORE);
+
+    score += std::min<uint64_t>(profile.maxImageDimension2D / 1024, MAX_LIMIT_SCORE);
+    score += std::min<uint64_t>(profile.maxComputeWorkGroupInvocations / 128, MAX_LIMIT_SCORE);
+    score += profile.maxDrawIndirectCount > 1 ? FEATURE_SCORE : 0;
+
+    bool features[] = { profile.gpuDriven, profile.synchronization2, profile.textureCompressionBC, profile.pipelineStatistics,
+        profile.computeMipGeneration, profile.blitMipGeneration, profile.timestampComputeAndGraphics, profile.computeQueue, profile.transferUploads,
+        (profile.sampleCounts & 8) != 0 };
+    static_assert(sizeof(features) / sizeof(features[0]) + 1 <= MAX_FEATURE_COUNT, "more features than the kind step leaves room for");
+    for (bool feature : features) {
+        score += feature ? FEATURE_SCORE : 0;
+    }
+    return score;
+}
+
+[[nodiscard]] static std::string normalizeSelection(const std::string& text)
+{
+    std::string normalized;
+    for (char c : text) {
+        normalized += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return normalized;
+}
+
+[[nodiscard]] static std::string removeDashes(std::string text)
+{
+    text.erase(std::remove(text.begin(), text.end(), '-'), text.end());
+    return text;
+}
+
+bool matchesDeviceSelection(const DeviceProfile& profile, const std::string& selection)
+{
+    std::string wanted = normalizeSelection(selection);
+    if (wanted.empty()) {
+        return true;
+    }
+    if (removeDashes(wanted) == removeDashes(profile.uuid)) {
+        return true;
+    }
+    return normalizeSelection(profile.name).find(wanted) != std::string::npos;
+}
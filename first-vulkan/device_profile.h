@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// in VkPhysicalDeviceType order
+enum class DeviceKind {
+    Other,
+    IntegratedGpu,
+    DiscreteGpu,
+    VirtualGpu,
+    Cpu,
+};
+
+// everything init wants to know about a physical device, queried once while
+// picking one and read from here afterwards. the caller fills it in from
+// vulkan, sample counts are VkSampleCountFlags
+struct DeviceProfile {
+    std::string name;
+    // deviceUUID as hex digits in 8-4-4-4-12 groups
+    std::string uuid;
+    DeviceKind kind = DeviceKind::Other;
+    uint32_t apiVersion = 0;
+    // summed over the device local heaps
+    uint64_t deviceLocalBytes = 0;
+    uint32_t maxImageDimension2D = 0;
+    uint32_t maxComputeWorkGroupInvocations = 0;
+    uint32_t maxDrawIndirectCount = 0;
+    // usable for both color and depth attachments
+    uint32_t sampleCounts = 1;
+    float timestampPeriod = 0.0f;
+    bool timestampComputeAndGraphics = false;
+    bool gpuDriven = false;
+    bool synchronization2 = false;
+    bool textureCompressionBC = false;
+    bool pipelineStatistics = false;
+    bool computeMipGeneration = false;
+    bool blitMipGeneration = false;
+    // queue families without graphics
+    bool computeQueue = false;
+    bool transferQueue = false;
+    // the transfer family can take the texture uploads
+    bool transferUploads = false;
+};
+
+// the device override, overridden in turn by --device
+const char* const DEVICE_SELECTION_VARIABLE = "FIRST_VULKAN_DEVICE";
+
+[[nodiscard]] std::string readDeviceSelectionVariable();
+
+[[nodiscard]] const char* getDeviceKindName(DeviceKind kind);
+[[nodiscard]] std::string formatDeviceUuid(const uint8_t* uuid);
+
+// higher is better. the kind of device decides first, then its memory, and
+// limits and optional features break the ties left
+[[nodiscard]] uint64_t scoreDeviceProfile(const DeviceProfile& profile);
+
+// selection is the device's uuid, with or without dashes, or any part of its
+// name, both case insensitive
+[[nodiscard]] bool matchesDeviceSelection(const DeviceProfile& profile, const std::string& selection);
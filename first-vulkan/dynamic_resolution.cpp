@@ -0,0 +1,76 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+// scales are kept on a grid, so tiny corrections don't change the render
+// target size every frame
+static const float SCALE_STEP = 1.0f / 64.0f;
+
+// changes aim for this fraction of the target, the middle of the band
+static const float TARGET_FRACTION = 0.9f;
+
+// the scale grows once the average stays under this fraction of the target
+// for HEADROOM_FRAMES frames, and by at most MAX_GROWTH at a time
+static const float HEADROOM_FRACTION = 0.8f;
+static const uint32_t HEADROOM_FRAMES = 30;
+static const float MAX_GROWTH = 1.1f;
+
+ResolutionController makeResolutionController(float targetMilliseconds, float minScale, float maxScale, uint32_t framesInFlight)
+{
+    ResolutionController controller;
+    controller.targetMilliseconds = targetMilliseconds;
+    controller.minScale = minScale;
+    controller.maxScale = maxScale;
+    controller.scale = maxScale;
+    controller.settleFrames = framesInFlight;
+    return controller;
+}
+
+static void setScale(ResolutionController& controller, float scale, uint32_t framesInFlight)
+{
+    scale = std::clamp(std::floor(scale / SCALE_STEP) * SCALE_STEP, controller.minScale, controller.maxScale);
+    if (scale == controller.scale) {
+        return;
+    }
+
+    controller.scale = scale;
+    controller.averageMilliseconds = 0.0f;
+    controller.settleFrames = framesInFlight;
+    controller.headroomFrames = 0;
+    controller.changeCount++;
+}
+
+float updateResolutionScale(ResolutionController& controller, float gpuMilliseconds, uint32_t framesInFlight)
+{
+    if (controller.settleFrames > 0) {
+        controller.settleFrames--;
+        return controller.scale;
+    }
+
+    float target = controller.targetMilliseconds;
+    float desiredMilliseconds = target * TARGET_FRACTION;
+
+    // a spike is acted on at once, a single frame over budget is already a
+    // missed frame
+    if (gpuMilliseconds > target) {
+        setScale(controller, controller.scale * std::sqrt(desiredMilliseconds / gpuMilliseconds), framesInFlight);
+        return controller.scale;
+    }
+
+    controller.averageMilliseconds = controller.averageMilliseconds == 0.0f ? gpuMilliseconds
+                                                                            : controller.averageMilliseconds * 0.9f + gpuMilliseconds * 0.1f;
+
+    if (controller.averageMilliseconds < target * HEADROOM_FRACTION) {
+        controller.headroomFrames++;
+    } else {
+        controller.headroomFrames = 0;
+    }
+
+    if (controller.headroomFrames >= HEADROOM_FRAMES && controller.scale < controller.maxScale) {
+        float growth = std::min(std::sqrt(desiredMilliseconds / controller.averageMilliseconds), MAX_GROWTH);
+        setScale(controller, controller.scale * growth, framesInFlight);
+    }
+
+    return controller.scale;
+}
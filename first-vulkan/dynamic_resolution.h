@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// picks the fraction of the swap chain resolution the scene renders at from
+// measured gpu frame times. the cost of a frame is taken to grow with its
+// pixel count, so a frame over budget shrinks the scale by the square root of
+// the overshoot right away, while growing back waits for a run of frames well
+// under budget. nothing changes in the band between the two, which keeps the
+// scale from oscillating around the target
+struct ResolutionController {
+    float targetMilliseconds = 0.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scale = 1.0f;
+    // of the frames since the last change, 0 before the first one
+    float averageMilliseconds = 0.0f;
+    // frames still in flight when the scale last changed, their times say
+    // nothing about the new scale
+    uint32_t settleFrames = 0;
+    // consecutive frames under the upscale threshold
+    uint32_t headroomFrames = 0;
+    uint32_t changeCount = 0;
+};
+
+[[nodiscard]] ResolutionController makeResolutionController(float targetMilliseconds, float minScale, float maxScale, uint32_t framesInFlight);
+
+// feeds the gpu time of a finished frame, returns the scale for the next one
+float updateResolutionScale(ResolutionController& controller, float gpuMilliseconds, uint32_t framesInFlight);
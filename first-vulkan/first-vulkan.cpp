@@ -5,23 +5,90 @@
 #include <GLFW/glfw3native.h>
 
 #define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZETO_TO_ONE
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <vulkan/vulkan.h>
 
+#include "asset_cache.h"
+#include "barrier_tracker.h"
+#include "bindless.h"
+#include "culling.h"
+#include "device_profile.h"
+#include "dynamic_resolution.h"
+#include "light_clusters.h"
+#include "mesh.h"
+#include "mesh_optimize.h"
+#include "render_graph.h"
+#include "shadow_cascades.h"
+#include "startup_profiler.h"
+#include "texture_compress.h"
+#include "texture_streaming.h"
+#include "vertex_format.h"
+
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <optional>
+#include <random>
 #include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 const uint32_t WINDOW_WIDTH = 800;
 const uint32_t WINDOW_HEIGHT = 800;
 
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+// upper bound on the draws the cluster culling pass may emit per frame, keeps
+// the draw command buffers at 80 MB
+const uint32_t MAX_CLUSTER_DRAWS = 4 * 1024 * 1024;
+
+// large uploads are streamed through two halves of this size, so scenes of any
+// size load with a fixed amount of host visible memory
+const VkDeviceSize STAGING_RING_HALF_SIZE = 32 * 1024 * 1024;
+
+// every frame in flight gets its own slice of the upload ring, so the cpu can
+// fill frame N+1 while the gpu is still reading frame N
+const VkDeviceSize UPLOAD_RING_FRAME_SIZE = 32 * 1024 * 1024;
+
+// vulkan has no empty buffers, but a scene section can be empty, e.g. the
+// meshlets on the instanced path. those still get a buffer of this size so
+// their descriptors stay valid
+const VkDeviceSize MIN_BUFFER_SIZE = 16;
+
+// sizes of the bindless arrays, lowered to the device limits if needed
+const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+const uint32_t MAX_BINDLESS_BUFFERS = 1024;
+
+// procedural textures the gpu driven scene picks from, 21 MB each with mips
+const uint32_t BUILTIN_TEXTURE_COUNT = 8;
+const uint32_t BUILTIN_TEXTURE_SIZE = 2048;
+
+// mips up to this size are loaded with the texture, the rest are streamed
+const uint32_t TEXTURE_TAIL_SIZE = 64;
+
+// the single pass downsampler covers 12 mips below level 0, as long as the
+// last workgroup can reduce all of mip 6 on its own
+const uint32_t MAX_DOWNSAMPLE_MIPS = 12;
+const uint32_t MAX_DOWNSAMPLE_SIZE = 4096;
+
+// compute mip generations a frame may record, each takes a descriptor set.
+// texture streaming defers the residency changes past it to later frames
+const uint32_t MAX_DOWNSAMPLES_PER_FRAME = 64;
+
 const std::array<const char*, 1> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
@@ -36,31 +103,729 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif;
 
+enum class RenderPath {
+    Instanced,
+    GpuDriven,
+};
+
+// where mips below the finest streamed one come from for uncompressed
+// textures. the gpu methods upload a single mip per texture and build the
+// rest from it
+enum class MipGeneration {
+    Cpu,
+    // a chain of linear filtered vkCmdBlitImage, one level at a time
+    Blit,
+    // shaders/downsample.comp, all levels in one dispatch
+    Compute,
+};
+
+struct AppConfig {
+    // picks the device by uuid or part of its name instead of by score, see
+    // matchesDeviceSelection
+    std::string deviceSelection;
+    // prints how long each step of init took
+    bool profileStartup = false;
+    RenderPath renderPath = RenderPath::Instanced;
+    uint32_t instanceCount = 1;
+    uint32_t objectCount = 10000;
+    // the gpu driven scene loads its meshes from here when set, instead of
+    // using the built in ones
+    std::string meshCachePath;
+    // when set, imports meshSources into a mesh cache at this path and exits
+    std::string buildMeshCachePath;
+    // obj files for --build-mesh-cache and --bench-mesh-opt, and the ones
+    // --mesh-cache rebuilds its cache from when it cannot be used
+    std::vector<std::string> meshSources;
+    // largest screen space error in pixels a lod may have before the culling
+    // pass picks a finer one, 0 always draws the full detail mesh
+    float lodThreshold = 1.0f;
+    // cull and draw individual meshlets of lod 0 instead of whole objects
+    bool clusterCulling = false;
+    // two phase occlusion culling against a depth pyramid, see CullPhase
+    bool occlusionCulling = false;
+    // culls on a compute only queue family when the device has one
+    bool asyncCompute = false;
+    // uploads streamed mips on a transfer only queue family when the device
+    // has one, off by --no-transfer-queue
+    bool transferQueue = true;
+    // format of the built in scene and of caches written by --build-mesh-cache,
+    // a loaded cache keeps whatever format it was written with
+    VertexFormat vertexFormat = VertexFormat::Float32;
+    // point and spot lights of the gpu driven scene, binned into clusters of
+    // the view frustum so each pixel only shades the lights near it
+    uint32_t lightCount = 16384;
+    // loops over every light for every pixel instead, to compare against
+    bool naiveLighting = false;
+    // writes albedo and normals to a g-buffer in one subpass and lights it in
+    // a second one that reads it back as input attachments, instead of
+    // lighting while drawing
+    bool deferredShading = false;
+    // directional shadows from a cascaded shadow map. the static casters of
+    // each cascade are cached and only drawn again once the camera or the
+    // sun has moved too far for it
+    bool shadows = false;
+    // the last this many objects count as moving, their shadows are drawn
+    // every frame on top of a copy of the cached static ones
+    uint32_t dynamicCasterCount = 0;
+    // radians per second the sun turns around the vertical axis
+    float sunSpeed = 0.0f;
+    // lays down depth with a position only pass first, so the shading pass
+    // runs each covered pixel once with an EQUAL depth test
+    bool depthPrePass = false;
+    // counts shader invocations with a pipeline statistics query and prints
+    // the per frame average on exit
+    bool pipelineStatistics = false;
+    // gpu memory the streamed textures may use, mip tails included
+    uint64_t textureBudget = 64ull * 1024 * 1024;
+    // the gpu driven scene streams its textures from here when set, instead
+    // of generating them
+    std::string textureCachePath;
+    // when set, encodes the built in textures into a texture cache at this
+    // path and exits
+    std::string buildTextureCachePath;
+    TextureFormat textureFormat = TextureFormat::Bc7;
+    CompressionQuality compressionQuality = CompressionQuality::Default;
+    MipGeneration mipGeneration = MipGeneration::Cpu;
+    // samples per pixel, lowered to what the device supports. m switches
+    // between the supported counts while running
+    uint32_t msaaSamples = 1;
+    // gpu time per frame the scene resolution is scaled to hold, 0 renders
+    // at the swap chain resolution
+    float targetFrameMilliseconds = 0.0f;
+    float minRenderScale = 0.5f;
+    bool benchmark = false;
+    bool benchmarkCulling = false;
+    bool benchmarkMeshOptimization = false;
+    bool benchmarkTextureCompression = false;
+    bool benchmarkMipGeneration = false;
+    uint32_t benchmarkFrames = 1000;
+};
+
+enum class DepthMode {
+    // depth test LESS and write, for drawing without a pre-pass
+    Write,
+    // depth only pre-pass, no color writes
+    PrePass,
+    // shading after a pre-pass, EQUAL test and no depth writes
+    Equal,
+};
+
+// g-buffer of the deferred path, the position is rebuilt from depth. both are
+// color attachment formats every device supports
+const VkFormat GBUFFER_ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+const VkFormat GBUFFER_NORMAL_FORMAT = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+
+// width and height of each cascade of the shadow map
+const uint32_t SHADOW_MAP_SIZE = 2048;
+
+// the pipeline statistics queried with --pipeline-stats, in result order
+const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+const uint32_t PIPELINE_STATISTIC_COUNT = 3;
+
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+// mirrors ObjectData in shaders/common.glsl
+struct ObjectData {
+    glm::mat4 model;
+    glm::vec4 boundingSphere;
+    glm::vec4 color;
+    uint32_t meshIndex;
+    // into HelloTriangleApp::textures, the vertex shaders look up its bindless
+    // slot in the texture table since streaming moves textures between slots
+    uint32_t textureIndex;
+    uint32_t padding[2];
+};
+
+// with occlusion culling every frame culls twice. the early phase draws what
+// was visible last frame, a depth pyramid is built from the result and the
+// late phase tests everything against it, draws what the early phase missed
+// and records what is visible for the next frame
+enum class CullPhase : uint32_t {
+    // frustum culling only
+    All = 0,
+    Early = 1,
+    Late = 2,
+};
+
+enum class ScenePass {
+    // the only pass of the frame
+    Single,
+    // keeps color and depth around for the late pass and the depth pyramid
+    Early,
+    // continues on top of the early pass
+    Late,
+};
+
+// what the frame graph records for each of its passes
+enum class FramePass : uint32_t {
+    TextureStreaming,
+    // copies the lights updateLights staged into the frame's light buffer
+    LightUpload,
+    // CullPhase::All, or CullPhase::Early with occlusion culling
+    Cull,
+    LightCulling,
+    // the cascades whose cached static casters went stale
+    StaticShadows,
+    // copies the static casters into the shadow map the scene samples
+    ShadowComposite,
+    DynamicShadows,
+    EarlyScene,
+    DepthPyramid,
+    LateCull,
+    LateScene,
+    Scene,
+    Upscale,
+};
+
+// what a frame graph resource is recorded as, buffers have no image
+struct FrameGraphImage {
+    VkImage image;
+    VkImageAspectFlags aspect;
+};
+
+struct CullPushConstants {
+    // the shaders extract the frustum planes themselves
+    glm::mat4 viewProj;
+    glm::vec4 cameraPosition;
+    // pixels per unit of error at distance 1
+    float lodScale;
+    float lodThreshold;
+    uint32_t objectCount;
+    // size of the draw command buffer, the cluster pass can produce more
+    // draws than there are objects
+    uint32_t drawCapacity;
+    // x and y scale of the projection before the y flip, for projecting
+    // bounds onto the depth pyramid
+    float projection00;
+    float projection11;
+    float nearPlane;
+    CullPhase phase;
+};
+
+// while the gpu copies out of one half the cpu fills the other, each half has
+// its own command buffer and fence
+struct StagingRing {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint8_t* mapped = nullptr;
+    std::array<VkCommandBuffer, 2> commandBuffers {};
+    std::array<VkFence, 2> fences {};
+    uint32_t current = 0;
+};
+
+struct DownsamplePushConstants {
+    uint32_t mipCount;
+    uint32_t workGroupCount;
+};
+
+// read by the vertex and the fragment stage, exactly the 128 bytes every
+// device supports
+struct MeshPushConstants {
+    glm::mat4 viewProj;
+    // w is the cluster slice scale
+    glm::vec4 cameraPosition;
+    // w is the cluster slice bias
+    glm::vec4 cameraForward;
+    // bindless slots of the scene buffers
+    uint32_t objectBuffer;
+    uint32_t meshBuffer;
+    uint32_t textureTable;
+    // bindless slots of the lights and of the clusters they are binned into,
+    // clusterBuffer is NO_CLUSTERS without the light culling pass
+    uint32_t lightBuffer;
+    uint32_t clusterBuffer;
+    uint32_t lightIndexBuffer;
+    // pixels per cluster tile
+    glm::vec2 tileSize;
+};
+
+// mirrors NO_CLUSTERS in shaders/common.glsl
+const uint32_t NO_CLUSTERS = 0xffffffff;
+
+struct DeferredLightingPushConstants {
+    glm::mat4 inverseViewProj;
+    // w is the cluster slice scale
+    glm::vec4 cameraPosition;
+    // w is the cluster slice bias
+    glm::vec4 cameraForward;
+    glm::vec2 tileSize;
+    // the rendered part of the framebuffer
+    glm::vec2 renderSize;
+    uint32_t lightBuffer;
+    uint32_t clusterBuffer;
+    uint32_t lightIndexBuffer;
+};
+
+struct LightCullPushConstants {
+    glm::mat4 view;
+    // x and y scale of the projection before the y flip
+    float projection00;
+    float projection11;
+    float sliceScale;
+    float sliceBias;
+    uint32_t lightBuffer;
+    uint32_t clusterBuffer;
+    uint32_t lightIndexBuffer;
+    uint32_t overflowBuffer;
+};
+
+// mirrors LightOverflow in shaders/light_cluster.comp
+struct LightOverflow {
+    // clusters that touched more than MAX_LIGHTS_PER_CLUSTER lights
+    uint32_t clusters;
+    // the lights past the limit, summed over those clusters
+    uint32_t droppedLights;
+};
+
+// mirrors NO_SHADOWS in shaders/common.glsl
+const uint32_t NO_SHADOWS = 0xffffffff;
+
+// mirrors LightBufferHeader in shaders/common.glsl, the lights follow it
+struct LightBufferHeader {
+    uint32_t lightCount;
+    // bindless texture slot of the shadow map, NO_SHADOWS without one
+    uint32_t shadowMap;
+    uint32_t padding[2];
+    // points toward the sun
+    glm::vec4 sunDirection;
+    // view depth each cascade ends at
+    glm::vec4 cascadeSplits;
+    glm::vec4 cascadeTexelSizes;
+    std::array<glm::mat4, SHADOW_CASCADE_COUNT> cascadeViewProj;
+};
+
+struct ShadowPushConstants {
+    glm::mat4 viewProj;
+    uint32_t objectBuffer;
+    uint32_t meshBuffer;
+};
+
+// indirect draws written into the upload ring for one cascade
+struct ShadowDrawRange {
+    VkDeviceSize offset;
+    uint32_t count;
+};
+
+// level 0 of the image is whatever mip of the source is resident
+struct Texture {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    uint32_t bindlessIndex = 0;
+    // what its mips take, in the units of the streaming budget
+    uint64_t bytes = 0;
+};
+
+// where the mips of a texture come from. either a texture cache, or a
+// checkerboard cheap enough to generate any mip of on demand
+struct TextureSource {
+    uint32_t width;
+    uint32_t height;
+    uint32_t light;
+    uint32_t dark;
+    uint32_t cellSize;
+    const TextureCacheTexture* cached = nullptr;
+};
+
+// mips [residentMip, uploadEnd) of a texture for the transfer worker to
+// upload. image has residentMip as level 0
+struct UploadJob {
+    uint64_t timelineValue;
+    uint32_t texture;
+    VkImage image;
+    uint32_t residentMip;
+    uint32_t uploadEnd;
+};
+
+// an upload the worker submitted, its staging buffer is freed once the
+// timeline reaches timelineValue
+struct SubmittedUpload {
+    uint64_t timelineValue;
+    VkCommandBuffer commandBuffer;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+};
+
+// records and submits uploads on the transfer queue from a thread of its own,
+// so large streams neither wait for nor hold up the frame
+struct TransferWorker {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<UploadJob> jobs;
+    bool stopping = false;
+    // only the worker touches these
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<SubmittedUpload> submitted;
+    // counts up to the value of the last finished upload
+    VkSemaphore timeline = VK_NULL_HANDLE;
+};
+
+// a residency change whose new mips are on their way on the transfer queue.
+// the texture is swapped in once the timeline reaches timelineValue
+struct TextureUpload {
+    StreamingChange change;
+    Texture texture;
+    uint64_t timelineValue;
+};
+
+struct Camera {
+    glm::mat4 viewProj;
+    glm::mat4 projection;
+    glm::vec3 position;
+    float verticalFov;
+    float nearPlane;
+    glm::mat4 view;
+    float farPlane;
+};
+
+struct UploadRing {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint8_t* mapped = nullptr;
+    VkDeviceSize frameSize = 0;
+    VkDeviceSize frameBegin = 0;
+    VkDeviceSize head = 0;
+};
+
+// what init asks the driver about a physical device, queried once per device.
+// the feature and property structs are filled with one chained call each,
+// their pNext is cleared afterwards. surface capabilities follow the window
+// and are always queried fresh
+struct DeviceCapabilities {
+    VkPhysicalDeviceProperties properties {};
+    VkPhysicalDeviceIDProperties idProperties {};
+    VkPhysicalDeviceVulkan12Properties properties12 {};
+    VkPhysicalDeviceFeatures features {};
+    VkPhysicalDeviceVulkan12Features features12 {};
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features {};
+    VkPhysicalDeviceMemoryProperties memoryProperties {};
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    // per queue family, for the window surface
+    std::vector<VkBool32> presentSupport;
+    std::set<std::string> extensions;
+    std::vector<VkSurfaceFormatKHR> surfaceFormats;
+    std::vector<VkPresentModeKHR> presentModes;
+    // filled in as formats are asked about
+    std::unordered_map<VkFormat, VkFormatProperties> formatProperties;
+};
+
 struct HelloTriangleApp {
+    AppConfig config;
     GLFWwindow* window = 0;
     VkInstance instance = {};
     VkDevice device = {};
     VkDebugUtilsMessengerEXT debugMessenger = {};
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    // queried when the device was picked, the rest of init reads it from here
+    DeviceProfile deviceProfile;
+    std::unordered_map<VkPhysicalDevice, DeviceCapabilities> deviceCapabilities;
+    // capability lookups that went to the driver, and those the cache answered
+    uint32_t capabilityQueries = 0;
+    uint32_t capabilityHits = 0;
+    StartupProfiler startupProfiler;
     VkQueue graphicsQueue;
     VkSurfaceKHR surface;
     VkQueue presentQueue;
+    uint32_t graphicsFamily = 0;
+    // queues of families without graphics, VK_NULL_HANDLE where the device
+    // has none. work on them runs next to the graphics queue instead of
+    // taking turns with it
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    uint32_t computeFamily = 0;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    uint32_t transferFamily = 0;
+    // culling runs on the compute queue, overlapping the previous frame's
+    // draws. static scene buffers both queues read are shared between them
+    bool asyncCompute = false;
+    std::vector<uint32_t> sharedQueueFamilies;
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> computeCommandBuffers;
+    // signaled by the frame's culling, waited for before its indirect draws
+    std::vector<VkSemaphore> cullFinishedSemaphores;
+    // streamed mips are uploaded on the transfer queue and handed to the
+    // graphics queue with an ownership transfer
+    bool transferUploads = false;
+    TransferWorker transferWorker;
+    uint64_t lastUploadValue = 0;
+    // in the order they were queued, which is the order they finish in
+    std::vector<TextureUpload> pendingUploads;
+    // changes to textures with an upload still pending, applied after it
+    std::vector<StreamingChange> deferredChanges;
+    // the timeline value the frame's acquires wait for, 0 if there are none
+    uint64_t uploadWaitValue = 0;
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
     std::vector<VkFramebuffer> swapChainFramebuffers;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
+    // the attachments below are transient. without lazily allocated memory
+    // they have no memory of their own, the frame graph hands it out
+    VkFormat depthFormat;
+    VkImage depthImage = VK_NULL_HANDLE;
+    VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+    VkMemoryRequirements depthRequirements {};
+    VkImageView depthImageView = VK_NULL_HANDLE;
+    // only exists with msaa, the swap chain image is the resolve target then
+    VkImage colorImage = VK_NULL_HANDLE;
+    VkDeviceMemory colorImageMemory = VK_NULL_HANDLE;
+    VkMemoryRequirements colorRequirements {};
+    VkImageView colorImageView = VK_NULL_HANDLE;
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    // the config's choice, unless something it doesn't work with is on. the
+    // render pass then has a geometry and a lighting subpass
+    bool deferredShading = false;
+    // only live within the render pass, tilers never write them to memory
+    VkImage gbufferAlbedoImage = VK_NULL_HANDLE;
+    VkDeviceMemory gbufferAlbedoImageMemory = VK_NULL_HANDLE;
+    VkMemoryRequirements gbufferAlbedoRequirements {};
+    VkImageView gbufferAlbedoImageView = VK_NULL_HANDLE;
+    VkImage gbufferNormalImage = VK_NULL_HANDLE;
+    VkDeviceMemory gbufferNormalImageMemory = VK_NULL_HANDLE;
+    VkMemoryRequirements gbufferNormalRequirements {};
+    VkImageView gbufferNormalImageView = VK_NULL_HANDLE;
+    // the g-buffer and depth as input attachments of the lighting subpass
+    VkDescriptorSetLayout gbufferSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool gbufferDescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet gbufferDescriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout deferredLightingPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline deferredLightingPipeline = VK_NULL_HANDLE;
+    // set by the key callback, applied between frames
+    bool msaaSwitchRequested = false;
+    // with dynamic resolution the scene renders into the top left renderExtent
+    // of a swap chain sized offscreen target, which is then blit to the swap
+    // chain image. without it renderExtent is the swap chain extent
+    bool dynamicResolution = false;
+    VkExtent2D renderExtent {};
+    VkImage offscreenImage = VK_NULL_HANDLE;
+    VkMemoryRequirements offscreenRequirements {};
+    VkImageView offscreenImageView = VK_NULL_HANDLE;
+    ResolutionController resolutionController;
+    // declared again every frame, recompiled only when the declarations change
+    RenderGraph frameGraph;
+    // parallel to the resources of the frame graph
+    std::vector<FrameGraphImage> frameGraphImages;
+    // shared by the transient images of the frame graph, and where each was
+    // bound when the block was allocated
+    VkDeviceMemory transientMemory = VK_NULL_HANDLE;
+    std::vector<std::pair<VkImage, VkDeviceSize>> transientBindings;
+    uint32_t checkedCompileCount = 0;
+    bool synchronization2 = false;
+    PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2 = nullptr;
+    // two per frame in flight, around everything the frame's command buffer
+    // does
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    std::vector<bool> timestampsWritten;
+    uint64_t timestampMask = 0;
+    float timestampPeriod = 0.0f;
+    double scaleTotal = 0.0;
+    double gpuMillisecondsTotal = 0.0;
+    uint32_t timedFrames = 0;
     VkPipelineLayout pipelineLayout;
     VkRenderPass renderPass;
+    VkRenderPass earlyRenderPass = VK_NULL_HANDLE;
+    VkRenderPass lateRenderPass = VK_NULL_HANDLE;
     VkPipeline graphicsPipeline;
+    VkPipeline graphicsDepthPipeline = VK_NULL_HANDLE;
     VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore imageFinishedSemaphore;
-    VkFence inFlightFence;
+    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    std::vector<VkSemaphore> imageFinishedSemaphores;
+    std::vector<VkFence> inFlightFences;
+    uint32_t currentFrame = 0;
+    // counts every frame ever started, unlike currentFrame
+    uint64_t frameNumber = 0;
+    UploadRing uploadRing;
+    StagingRing stagingRing;
+    VkDeviceSize instanceOffset = 0;
+    SphereBounds instanceBounds;
+    std::vector<uint32_t> visibleInstances;
+    std::vector<ObjectData> objects;
+    // the bounding spheres of objects for the cpu side culling kernels, the
+    // shadow casters and the objects that request texture mips
+    SphereBounds objectBounds;
+    std::vector<uint32_t> visibleObjects;
+    VertexFormat vertexFormat = VertexFormat::Float32;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer objectBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory objectBufferMemory = VK_NULL_HANDLE;
+    VkBuffer meshInfoBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory meshInfoBufferMemory = VK_NULL_HANDLE;
+    VkBuffer meshletBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory meshletBufferMemory = VK_NULL_HANDLE;
+    std::vector<VkBuffer> drawCommandBuffers;
+    std::vector<VkDeviceMemory> drawCommandBuffersMemory;
+    std::vector<VkBuffer> drawCountBuffers;
+    std::vector<VkDeviceMemory> drawCountBuffersMemory;
+    uint32_t drawCapacity = 0;
+    uint32_t maxDrawCount = 0;
+    // one per frame in flight, the late phase writes its own and the early
+    // phase reads the one of the frame before
+    std::vector<VkBuffer> visibilityBuffers;
+    std::vector<VkDeviceMemory> visibilityBuffersMemory;
+    // farthest depth per texel, level 0 is the largest power of two that fits
+    // in the swap chain
+    VkImage depthPyramid = VK_NULL_HANDLE;
+    VkDeviceMemory depthPyramidMemory = VK_NULL_HANDLE;
+    VkImageView depthPyramidView = VK_NULL_HANDLE;
+    std::vector<VkImageView> depthPyramidLevelViews;
+    uint32_t depthPyramidWidth = 0;
+    uint32_t depthPyramidHeight = 0;
+    uint32_t depthPyramidLevels = 0;
+    VkSampler depthPyramidSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout depthReduceSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool depthReduceDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> depthReduceDescriptorSets;
+    VkPipelineLayout depthReducePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline depthReducePipeline = VK_NULL_HANDLE;
+    // every texture and the scene buffers the shading pass needs live in one
+    // descriptor set, bound once per pass whatever is drawn
+    VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool bindlessDescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet bindlessDescriptorSet = VK_NULL_HANDLE;
+    VkSampler bindlessSampler = VK_NULL_HANDLE;
+    BindlessSlots bindlessTextureSlots;
+    BindlessSlots bindlessBufferSlots;
+    std::vector<Texture> textures;
+    std::vector<TextureSource> textureSources;
+    // format of every texture, block compressed when loaded from a cache
+    TextureFormat textureFormat = TextureFormat::Rgba8;
+    MappedFile textureCacheFile;
+    TextureCacheView textureCache;
+    TextureStreamer textureStreamer;
+    // replaced textures and the frame number they were last used in
+    std::vector<std::pair<Texture, uint64_t>> retiredTextures;
+    // layouts of the textures and of anything else recorded outside the
+    // frame graph
+    BarrierTracker barrierTracker;
+    // signaled once the frame's texture uploads are done, the scene waits on
+    // it with the barriers that hand the textures to the fragment shader.
+    // reset from the host once the frame's fence has signaled
+    std::vector<VkEvent> textureEvents;
+    TrackedBatch signaledTextureBarriers;
+    // texture index to bindless slot, rewritten every frame so each frame in
+    // flight has its own
+    std::vector<VkBuffer> textureTableBuffers;
+    std::vector<VkDeviceMemory> textureTableBuffersMemory;
+    std::vector<uint32_t*> textureTables;
+    std::vector<uint32_t> textureTableIndices;
+    // the config's choice, unless the device can't do it
+    MipGeneration mipGeneration = MipGeneration::Cpu;
+    VkDescriptorSetLayout downsampleSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout downsamplePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline downsamplePipeline = VK_NULL_HANDLE;
+    VkSampler downsampleSampler = VK_NULL_HANDLE;
+    VkBuffer downsampleCounterBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory downsampleCounterBufferMemory = VK_NULL_HANDLE;
+    // reset once the frame's fence has signaled, along with the level views
+    // its downsamples wrote through
+    std::vector<VkDescriptorPool> downsampleDescriptorPools;
+    std::vector<std::vector<VkImageView>> downsampleViews;
+    uint32_t objectBufferIndex = 0;
+    uint32_t meshInfoBufferIndex = 0;
+    VkDescriptorSetLayout sceneSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> sceneDescriptorSets;
+    VkPipelineLayout meshPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline meshPipeline = VK_NULL_HANDLE;
+    VkPipeline meshDepthPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    std::vector<SceneLight> sceneLights;
+    // rewritten every frame as the lights move, a count followed by the
+    // LightData of every light. device local, updateLights stages them in
+    // the upload ring and the light upload pass copies them over
+    std::vector<VkBuffer> lightBuffers;
+    std::vector<VkDeviceMemory> lightBuffersMemory;
+    std::vector<uint32_t> lightBufferIndices;
+    VkDeviceSize lightBufferSize = 0;
+    VkDeviceSize lightUploadOffset = 0;
+    // light count per cluster and MAX_LIGHTS_PER_CLUSTER light indices per
+    // cluster, refilled by the light culling pass every frame. only exist
+    // when usesLightClusters
+    std::vector<VkBuffer> clusterBuffers;
+    std::vector<VkDeviceMemory> clusterBuffersMemory;
+    std::vector<uint32_t> clusterBufferIndices;
+    std::vector<VkBuffer> lightIndexBuffers;
+    std::vector<VkDeviceMemory> lightIndexBuffersMemory;
+    std::vector<uint32_t> lightIndexBufferIndices;
+    // what the light culling pass had to drop, read back and cleared once
+    // the frame's fence has signaled
+    std::vector<VkBuffer> lightOverflowBuffers;
+    std::vector<VkDeviceMemory> lightOverflowBuffersMemory;
+    std::vector<LightOverflow*> mappedLightOverflows;
+    std::vector<uint32_t> lightOverflowBufferIndices;
+    uint32_t lightCullFrames = 0;
+    uint32_t lightOverflowFrames = 0;
+    uint64_t overflowClusterTotal = 0;
+    uint64_t droppedLightTotal = 0;
+    VkPipelineLayout lightCullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline lightCullPipeline = VK_NULL_HANDLE;
+    // the config's choice, unless the device has no depth format shadows can
+    // be filtered from
+    bool shadows = false;
+    VkFormat shadowFormat = VK_FORMAT_UNDEFINED;
+    VkSampler shadowSampler = VK_NULL_HANDLE;
+    // one layer per cascade. the cache holds the static casters and is only
+    // drawn into when a cascade goes stale. with dynamic casters the scene
+    // samples the shadow map instead, a copy of the cache with them on top
+    VkImage shadowCacheImage = VK_NULL_HANDLE;
+    VkDeviceMemory shadowCacheImageMemory = VK_NULL_HANDLE;
+    std::vector<VkImageView> shadowCacheLayerViews;
+    std::vector<VkFramebuffer> shadowCacheFramebuffers;
+    VkImage shadowMapImage = VK_NULL_HANDLE;
+    VkDeviceMemory shadowMapImageMemory = VK_NULL_HANDLE;
+    std::vector<VkImageView> shadowMapLayerViews;
+    std::vector<VkFramebuffer> shadowMapFramebuffers;
+    // every layer of whichever of the two the scene samples
+    VkImageView shadowSampledView = VK_NULL_HANDLE;
+    uint32_t shadowSampledIndex = 0;
+    VkRenderPass shadowClearRenderPass = VK_NULL_HANDLE;
+    VkRenderPass shadowLoadRenderPass = VK_NULL_HANDLE;
+    VkPipelineLayout shadowPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline shadowPipeline = VK_NULL_HANDLE;
+    // objects before it never move, the rest are dynamic casters
+    uint32_t staticCasterCount = 0;
+    // around every object, the cascades reach back to all of it
+    glm::vec4 sceneSphere {};
+    // lod 0 of every mesh, the shadow draws don't go through the culling
+    // shader
+    std::vector<VkDrawIndexedIndirectCommand> shadowMeshDraws;
+    std::array<ShadowCascade, SHADOW_CASCADE_COUNT> shadowCascades;
+    std::array<float, SHADOW_CASCADE_COUNT> cascadeSplits {};
+    // what the frame being recorded draws, set by updateShadowCascades
+    uint32_t staleCascadeMask = 0;
+    std::array<ShadowDrawRange, SHADOW_CASCADE_COUNT> staticShadowDraws {};
+    std::array<ShadowDrawRange, SHADOW_CASCADE_COUNT> dynamicShadowDraws {};
+    std::vector<uint32_t> shadowCasters;
+    uint32_t cascadeRedrawCount = 0;
+    uint32_t shadowFrames = 0;
+    // one query per frame in flight, read back once its fence has signaled
+    VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+    std::vector<bool> statisticsQueryWritten;
+    std::array<uint64_t, PIPELINE_STATISTIC_COUNT> statisticsTotals {};
+    uint32_t statisticsFrames = 0;
+    std::chrono::steady_clock::time_point startTime;
 };
 
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    auto& app = *static_cast<HelloTriangleApp*>(glfwGetWindowUserPointer(window));
+
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        app.msaaSwitchRequested = true;
+    }
+}
+
 void initWindow(HelloTriangleApp& app)
 {
     glfwInit();
@@ -69,6 +834,9 @@ void initWindow(HelloTriangleApp& app)
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     app.window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan window",
         nullptr, nullptr);
+
+    glfwSetWindowUserPointer(app.window, &app);
+    glfwSetKeyCallback(app.window, keyCallback);
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageSeverityFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
@@ -170,7 +938,7 @@ void createInstance(HelloTriangleApp& app)
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -221,9 +989,113 @@ void createInstance(HelloTriangleApp& app)
     }
 }
 
+[[nodiscard]] DeviceCapabilities& getDeviceCapabilities(HelloTriangleApp& app, VkPhysicalDevice device)
+{
+    auto found = app.deviceCapabilities.find(device);
+    if (found != app.deviceCapabilities.end()) {
+        app.capabilityHits++;
+        return found->second;
+    }
+    app.capabilityQueries++;
+
+    DeviceCapabilities& capabilities = app.deviceCapabilities[device];
+    vkGetPhysicalDeviceProperties(device, &capabilities.properties);
+    vkGetPhysicalDeviceMemoryProperties(device, &capabilities.memoryProperties);
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+    for (const auto& extension : availableExtensions) {
+        capabilities.extensions.insert(extension.extensionName);
+    }
+
+    // only what the device version and extensions allow goes into the chains
+    bool vulkan11 = capabilities.properties.apiVersion >= VK_API_VERSION_1_1;
+    bool vulkan12 = capabilities.properties.apiVersion >= VK_API_VERSION_1_2;
+    bool synchronization2 = capabilities.extensions.count(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) != 0;
+
+    capabilities.idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    capabilities.properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    if (vulkan11) {
+        VkPhysicalDeviceProperties2 properties {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &capabilities.idProperties;
+        if (vulkan12) {
+            capabilities.idProperties.pNext = &capabilities.properties12;
+        }
+        vkGetPhysicalDeviceProperties2(device, &properties);
+        capabilities.idProperties.pNext = nullptr;
+    }
+
+    capabilities.features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    capabilities.synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 features {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    void** chainEnd = &features.pNext;
+    if (vulkan12) {
+        *chainEnd = &capabilities.features12;
+        chainEnd = &capabilities.features12.pNext;
+    }
+    if (synchronization2) {
+        *chainEnd = &capabilities.synchronization2Features;
+    }
+    if (vulkan11) {
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        capabilities.features = features.features;
+    } else {
+        vkGetPhysicalDeviceFeatures(device, &capabilities.features);
+    }
+    capabilities.features12.pNext = nullptr;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    capabilities.queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, capabilities.queueFamilies.data());
+    capabilities.presentSupport.resize(queueFamilyCount);
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, app.surface, &capabilities.presentSupport[i]);
+    }
+
+    uint32_t formatCount;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, app.surface, &formatCount, nullptr);
+    capabilities.surfaceFormats.resize(formatCount);
+    if (formatCount != 0) {
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, app.surface, &formatCount, capabilities.surfaceFormats.data());
+    }
+
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, app.surface, &presentModeCount, nullptr);
+    capabilities.presentModes.resize(presentModeCount);
+    if (presentModeCount != 0) {
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, app.surface, &presentModeCount, capabilities.presentModes.data());
+    }
+
+    return capabilities;
+}
+
+[[nodiscard]] VkFormatProperties getFormatProperties(HelloTriangleApp& app, VkPhysicalDevice device, VkFormat format)
+{
+    DeviceCapabilities& capabilities = getDeviceCapabilities(app, device);
+    auto found = capabilities.formatProperties.find(format);
+    if (found != capabilities.formatProperties.end()) {
+        app.capabilityHits++;
+        return found->second;
+    }
+    app.capabilityQueries++;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(device, format, &properties);
+    capabilities.formatProperties[format] = properties;
+    return properties;
+}
+
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // families that can't do graphics, the transfer one can't compute either
+    std::optional<uint32_t> computeFamily;
+    std::optional<uint32_t> transferFamily;
 };
 
 [[nodiscard]] bool areQueueFamilyIndicesComplete(const QueueFamilyIndices& indices)
@@ -234,52 +1106,38 @@ struct QueueFamilyIndices {
 [[nodiscard]] QueueFamilyIndices findQueueFamilies(HelloTriangleApp& app, VkPhysicalDevice device)
 {
     QueueFamilyIndices indices;
+    const DeviceCapabilities& capabilities = getDeviceCapabilities(app, device);
 
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+    for (uint32_t i = 0; i < capabilities.queueFamilies.size(); i++) {
+        VkQueueFlags flags = capabilities.queueFamilies[i].queueFlags;
+        bool graphics = (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        bool compute = (flags & VK_QUEUE_COMPUTE_BIT) != 0;
 
-    int i = 0;
-    for (const auto& queueFamily : queueFamilies) {
-
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, app.surface, &presentSupport);
+        if (!areQueueFamilyIndicesComplete(indices)) {
+            if (graphics) {
+                indices.graphicsFamily = i;
+            }
 
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            indices.graphicsFamily = i;
+            if (capabilities.presentSupport[i]) {
+                indices.presentFamily = i;
+            }
         }
 
-        if (presentSupport) {
-            indices.presentFamily = i;
+        if (compute && !graphics && !indices.computeFamily.has_value()) {
+            indices.computeFamily = i;
         }
-
-        if (areQueueFamilyIndicesComplete(indices)) {
-            break;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) != 0 && !graphics && !compute && !indices.transferFamily.has_value()) {
+            indices.transferFamily = i;
         }
-
-        i++;
     }
 
     return indices;
 }
 
-[[nodiscard]] bool checkDeviceExtensionSupport(VkPhysicalDevice device)
+[[nodiscard]] bool checkDeviceExtensionSupport(const DeviceCapabilities& capabilities)
 {
-    uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-    for (const auto& extension : availableExtensions) {
-        requiredExtensions.erase(extension.extensionName);
-    }
-
-    return requiredExtensions.empty();
+    return std::all_of(deviceExtensions.begin(), deviceExtensions.end(),
+        [&capabilities](const char* extension) { return capabilities.extensions.count(extension) != 0; });
 }
 
 struct SwapChainSupportDetails {
@@ -291,22 +1149,12 @@ struct SwapChainSupportDetails {
 [[nodiscard]] SwapChainSupportDetails querySwapChainSupport(HelloTriangleApp& app, VkPhysicalDevice device)
 {
     SwapChainSupportDetails details;
+    const DeviceCapabilities& capabilities = getDeviceCapabilities(app, device);
 
+    // the extent changes with the window, formats and present modes don't
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, app.surface, &details.capabilites);
-    uint32_t formatCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, app.surface, &formatCount, nullptr);
-    if (formatCount != 0) {
-        details.formats.resize(formatCount);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, app.surface, &formatCount, details.formats.data());
-    }
-
-    uint32_t presentModeCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, app.surface, &presentModeCount, nullptr);
-
-    if (presentModeCount != 0) {
-        details.presentModes.resize(presentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, app.surface, &presentModeCount, details.presentModes.data());
-    }
+    details.formats = capabilities.surfaceFormats;
+    details.presentModes = capabilities.presentModes;
 
     return details;
 }
@@ -322,8 +1170,17 @@ struct SwapChainSupportDetails {
     return availableFormats[0];
 }
 
-[[nodiscard]] VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+[[nodiscard]] VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, bool uncapped)
 {
+    // benchmarks want the gpu throughput, not the refresh rate
+    if (uncapped) {
+        for (const auto& availablePresentMode : availablePresentModes) {
+            if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+                return availablePresentMode;
+            }
+        }
+    }
+
     for (const auto& availablePresentMode : availablePresentModes) {
         if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
             return availablePresentMode;
@@ -358,7 +1215,7 @@ void createSwapChain(HelloTriangleApp& app)
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(app, app.physicalDevice);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, app.config.benchmark);
     VkExtent2D extent = chooseSwapExtent(app, swapChainSupport.capabilites);
 
     uint32_t imageCount = swapChainSupport.capabilites.minImageCount + 1;
@@ -376,6 +1233,10 @@ void createSwapChain(HelloTriangleApp& app)
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // the upscale is a blit into the swap chain image
+    if (app.config.targetFrameMilliseconds > 0.0f && (swapChainSupport.capabilites.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
 
     QueueFamilyIndices indices = findQueueFamilies(app, app.physicalDevice);
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -409,19 +1270,55 @@ void createSwapChain(HelloTriangleApp& app)
 
     app.swapChainImageFormat = surfaceFormat.format;
     app.swapChainExtent = extent;
+    app.renderExtent = extent;
+}
+
+[[nodiscard]] bool supportsGpuDrivenRendering(const DeviceCapabilities& capabilities)
+{
+    if (capabilities.properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    const VkPhysicalDeviceVulkan12Features& features12 = capabilities.features12;
+    bool bindless = features12.runtimeDescriptorArray && features12.descriptorBindingPartiallyBound
+        && features12.descriptorBindingSampledImageUpdateAfterBind && features12.descriptorBindingStorageBufferUpdateAfterBind
+        && features12.shaderSampledImageArrayNonUniformIndexing;
+
+    return capabilities.features.multiDrawIndirect && capabilities.features.drawIndirectFirstInstance && features12.drawIndirectCount && bindless;
+}
+
+// the frame graph records its barriers with vkCmdPipelineBarrier2 where the
+// extension is there, with plain pipeline barriers otherwise
+[[nodiscard]] bool supportsSynchronization2(const DeviceCapabilities& capabilities)
+{
+    return capabilities.synchronization2Features.synchronization2;
+}
+
+// uploads on the transfer queue are handed over with a timeline semaphore,
+// and go down to 1x1 mips, which the family has to be able to copy
+[[nodiscard]] bool supportsTransferUploads(const DeviceCapabilities& capabilities, uint32_t transferFamily)
+{
+    if (!capabilities.features12.timelineSemaphore) {
+        return false;
+    }
+
+    VkExtent3D granularity = capabilities.queueFamilies[transferFamily].minImageTransferGranularity;
+    return granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
 }
 
-[[nodiscard]] bool isDeviceSuitable(HelloTriangleApp& app, VkPhysicalDevice device)
+[[nodiscard]] bool isDeviceSuitable(HelloTriangleApp& app, VkPhysicalDevice device, const DeviceProfile& profile)
 {
-    // VkPhysicalDeviceProperties deviceProperties;
-    // vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (app.config.renderPath == RenderPath::GpuDriven && !profile.gpuDriven) {
+        return false;
+    }
 
-    // VkPhysicalDeviceFeatures deviceFeatures;
-    // vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    if (app.config.pipelineStatistics && !profile.pipelineStatistics) {
+        return false;
+    }
 
     QueueFamilyIndices indices = findQueueFamilies(app, device);
 
-    bool extensionsSupported = checkDeviceExtensionSupport(device);
+    bool extensionsSupported = checkDeviceExtensionSupport(getDeviceCapabilities(app, device));
 
     bool swapChainAdequate = false;
     if (extensionsSupported) {
@@ -432,6 +1329,93 @@ void createSwapChain(HelloTriangleApp& app)
     return areQueueFamilyIndicesComplete(indices) && extensionsSupported && swapChainAdequate;
 }
 
+[[nodiscard]] bool supportsComputeMipGeneration(HelloTriangleApp& app, VkPhysicalDevice device)
+{
+    const DeviceCapabilities& capabilities = getDeviceCapabilities(app, device);
+    VkFormatProperties properties = getFormatProperties(app, device, VK_FORMAT_R8G8B8A8_UNORM);
+
+    return capabilities.features.shaderStorageImageArrayDynamicIndexing && (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
+[[nodiscard]] bool supportsBlitMipGeneration(HelloTriangleApp& app, VkPhysicalDevice device)
+{
+    VkFormatProperties properties = getFormatProperties(app, device, VK_FORMAT_R8G8B8A8_SRGB);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+[[nodiscard]] DeviceProfile queryDeviceProfile(HelloTriangleApp& app, VkPhysicalDevice device)
+{
+    const DeviceCapabilities& capabilities = getDeviceCapabilities(app, device);
+    const VkPhysicalDeviceLimits& limits = capabilities.properties.limits;
+
+    DeviceProfile profile;
+    profile.name = capabilities.properties.deviceName;
+    profile.kind = static_cast<DeviceKind>(capabilities.properties.deviceType);
+    profile.apiVersion = capabilities.properties.apiVersion;
+    // all zeros on devices older than 1.1
+    profile.uuid = formatDeviceUuid(capabilities.idProperties.deviceUUID);
+
+    const VkPhysicalDeviceMemoryProperties& memProperties = capabilities.memoryProperties;
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            profile.deviceLocalBytes += memProperties.memoryHeaps[i].size;
+        }
+    }
+
+    profile.maxImageDimension2D = limits.maxImageDimension2D;
+    profile.maxComputeWorkGroupInvocations = limits.maxComputeWorkGroupInvocations;
+    profile.maxDrawIndirectCount = limits.maxDrawIndirectCount;
+    profile.sampleCounts = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+    profile.timestampPeriod = limits.timestampPeriod;
+    profile.timestampComputeAndGraphics = limits.timestampComputeAndGraphics;
+
+    profile.textureCompressionBC = capabilities.features.textureCompressionBC;
+    profile.pipelineStatistics = capabilities.features.pipelineStatisticsQuery;
+
+    profile.gpuDriven = supportsGpuDrivenRendering(capabilities);
+    profile.synchronization2 = supportsSynchronization2(capabilities);
+    profile.computeMipGeneration = supportsComputeMipGeneration(app, device);
+    profile.blitMipGeneration = supportsBlitMipGeneration(app, device);
+
+    QueueFamilyIndices indices = findQueueFamilies(app, device);
+    profile.computeQueue = indices.computeFamily.has_value();
+    profile.transferQueue = indices.transferFamily.has_value();
+    profile.transferUploads = profile.transferQueue && supportsTransferUploads(capabilities, indices.transferFamily.value());
+
+    return profile;
+}
+
+void printDeviceProfile(const DeviceProfile& profile)
+{
+    std::pair<bool, const char*> features[] = {
+        { profile.gpuDriven, "gpu-driven" },
+        { profile.synchronization2, "synchronization2" },
+        { profile.textureCompressionBC, "bc" },
+        { profile.pipelineStatistics, "pipeline-stats" },
+        { profile.computeMipGeneration, "compute-mips" },
+        { profile.blitMipGeneration, "blit-mips" },
+        { profile.computeQueue, "compute-queue" },
+        { profile.transferQueue, "transfer-queue" },
+        { profile.transferUploads, "transfer-uploads" },
+    };
+
+    std::cout << "using " << profile.name << ", " << getDeviceKindName(profile.kind) << ", uuid " << profile.uuid << "\n";
+    std::cout << "\tvulkan " << VK_API_VERSION_MAJOR(profile.apiVersion) << "." << VK_API_VERSION_MINOR(profile.apiVersion) << ", "
+              << profile.deviceLocalBytes / (1024 * 1024) << " MB device local, 2d images up to " << profile.maxImageDimension2D
+              << ", sample counts 0x" << std::hex << profile.sampleCounts << std::dec << "\n";
+    std::cout << "\tfeatures:";
+    for (const auto& feature : features) {
+        if (feature.first) {
+            std::cout << " " << feature.second;
+        }
+    }
+    std::cout << std::endl;
+}
+
+// scores every suitable device and takes the best one, of those matching the
+// selection when there is one
 void pickPhysicalDevice(HelloTriangleApp& app)
 {
     uint32_t deviceCount = 0;
@@ -444,16 +1428,137 @@ void pickPhysicalDevice(HelloTriangleApp& app)
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(app.instance, &deviceCount, devices.data());
 
+    const std::string& selection = app.config.deviceSelection;
+    uint64_t bestScore = 0;
     for (const auto& device : devices) {
-        if (isDeviceSuitable(app, device)) {
+        DeviceProfile profile = queryDeviceProfile(app, device);
+        bool suitable = isDeviceSuitable(app, device, profile);
+        uint64_t score = scoreDeviceProfile(profile);
+
+        std::cout << "device " << profile.name << ": ";
+        if (suitable) {
+            std::cout << "score " << score << std::endl;
+        } else {
+            std::cout << "unsuitable" << std::endl;
+        }
+
+        if (suitable && matchesDeviceSelection(profile, selection) && (app.physicalDevice == VK_NULL_HANDLE || score > bestScore)) {
             app.physicalDevice = device;
-            break;
+            app.deviceProfile = profile;
+            bestScore = score;
         }
     }
 
     if (app.physicalDevice == VK_NULL_HANDLE) {
+        if (!selection.empty()) {
+            throw std::runtime_error("failed to find a suitable GPU matching " + selection + "!");
+        }
         throw std::runtime_error("failed to find a suitable GPU!");
     }
+    printDeviceProfile(app.deviceProfile);
+}
+
+// falls back from compute to blits to the cpu, as far as the device needs
+void chooseMipGeneration(HelloTriangleApp& app)
+{
+    app.mipGeneration = app.config.mipGeneration;
+
+    if (app.mipGeneration == MipGeneration::Compute && !app.deviceProfile.computeMipGeneration) {
+        std::cout << "device can't run the downsampler, generating mips with blits" << std::endl;
+        app.mipGeneration = MipGeneration::Blit;
+    }
+
+    if (app.mipGeneration == MipGeneration::Blit && !app.deviceProfile.blitMipGeneration) {
+        std::cout << "device can't blit with linear filtering, generating mips on the cpu" << std::endl;
+        app.mipGeneration = MipGeneration::Cpu;
+    }
+}
+
+// the highest supported count up to the requested one. the depth pyramid is
+// built from single sampled depth, so occlusion culling keeps one sample
+// the g-buffer would have to survive from the early to the late pass with
+// occlusion culling, which is what the subpasses are there to avoid
+void chooseShadingPath(HelloTriangleApp& app)
+{
+    app.deferredShading = false;
+    if (!app.config.deferredShading) {
+        return;
+    }
+
+    if (app.config.occlusionCulling) {
+        std::cout << "deferred shading is not available with occlusion culling" << std::endl;
+        return;
+    }
+    app.deferredShading = true;
+}
+
+// the shadow sampler filters the results of its depth comparisons, which
+// needs a depth format that can be linearly filtered
+void chooseShadows(HelloTriangleApp& app)
+{
+    app.shadows = false;
+    if (!app.config.shadows || app.config.renderPath != RenderPath::GpuDriven) {
+        return;
+    }
+
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+        | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }) {
+        if ((getFormatProperties(app, app.physicalDevice, format).optimalTilingFeatures & features) == features) {
+            app.shadowFormat = format;
+            app.shadows = true;
+            return;
+        }
+    }
+
+    std::cout << "device can't filter a depth format, rendering without shadows" << std::endl;
+}
+
+void chooseMsaaSamples(HelloTriangleApp& app)
+{
+    app.msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    if (app.config.msaaSamples > 1 && app.config.occlusionCulling) {
+        std::cout << "msaa is not available with occlusion culling" << std::endl;
+        return;
+    }
+    // the lighting subpass would have to run per sample
+    if (app.config.msaaSamples > 1 && app.deferredShading) {
+        std::cout << "msaa is not available with deferred shading" << std::endl;
+        return;
+    }
+
+    VkSampleCountFlags supported = app.deviceProfile.sampleCounts;
+    for (uint32_t samples = app.config.msaaSamples; samples > 1; samples /= 2) {
+        if (supported & samples) {
+            app.msaaSamples = static_cast<VkSampleCountFlagBits>(samples);
+            break;
+        }
+    }
+
+    if (app.msaaSamples != app.config.msaaSamples) {
+        std::cout << "device supports up to " << app.msaaSamples << "x msaa, not " << app.config.msaaSamples << "x" << std::endl;
+    }
+}
+
+// the late culling phase reads a depth pyramid the graphics queue builds in
+// the same frame, so only single phase culling moves to the compute queue
+void chooseAsyncCompute(HelloTriangleApp& app)
+{
+    if (!app.config.asyncCompute) {
+        return;
+    }
+    if (app.computeQueue == VK_NULL_HANDLE) {
+        std::cout << "no compute only queue family, culling stays on the graphics queue" << std::endl;
+        return;
+    }
+    if (app.config.occlusionCulling) {
+        std::cout << "async compute is not available with occlusion culling" << std::endl;
+        return;
+    }
+
+    app.asyncCompute = true;
+    app.sharedQueueFamilies = { app.graphicsFamily, app.computeFamily };
+    std::cout << "culling on compute queue family " << app.computeFamily << ", drawing on " << app.graphicsFamily << std::endl;
 }
 
 void createLogicalDevice(HelloTriangleApp& app)
@@ -462,6 +1567,12 @@ void createLogicalDevice(HelloTriangleApp& app)
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    if (indices.computeFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.computeFamily.value());
+    }
+    if (indices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
 
     float queuePriority = 1.0f;
 
@@ -469,25 +1580,69 @@ void createLogicalDevice(HelloTriangleApp& app)
 
         VkDeviceQueueCreateInfo queueCreateInfo {};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+        queueCreateInfo.queueFamilyIndex = queueFamily;
         queueCreateInfo.queueCount = 1;
-        float queuePriority = 1.0f;
         queueCreateInfo.pQueuePriorities = &queuePriority;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures {};
+    bool gpuDriven = app.config.renderPath == RenderPath::GpuDriven;
+
+    VkPhysicalDeviceVulkan12Features features12 {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.drawIndirectCount = gpuDriven;
+    // descriptor indexing is core in 1.2, these cover the bindless table
+    features12.runtimeDescriptorArray = gpuDriven;
+    features12.descriptorBindingPartiallyBound = gpuDriven;
+    features12.descriptorBindingSampledImageUpdateAfterBind = gpuDriven;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = gpuDriven;
+    features12.shaderSampledImageArrayNonUniformIndexing = gpuDriven;
+
+    app.transferUploads = gpuDriven && app.config.transferQueue && app.deviceProfile.transferUploads;
+    features12.timelineSemaphore = app.transferUploads;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures {};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.features.multiDrawIndirect = gpuDriven;
+    deviceFeatures.features.drawIndirectFirstInstance = gpuDriven;
+    deviceFeatures.features.pipelineStatisticsQuery = app.config.pipelineStatistics;
+
+    // block compressed textures can only be sampled with this on
+    deviceFeatures.features.textureCompressionBC = app.deviceProfile.textureCompressionBC;
+    // the downsampler picks the level to write by index
+    deviceFeatures.features.shaderStorageImageArrayDynamicIndexing = app.mipGeneration == MipGeneration::Compute;
+
+    std::vector<const char*> extensions(deviceExtensions.begin(), deviceExtensions.end());
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features {};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    synchronization2Features.synchronization2 = VK_TRUE;
+
+    app.synchronization2 = app.deviceProfile.synchronization2;
+    if (app.synchronization2) {
+        extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        synchronization2Features.pNext = deviceFeatures.pNext;
+        deviceFeatures.pNext = &synchronization2Features;
+    }
+
+    // only chained when something in it is on, so the instanced path runs on
+    // devices without vulkan 1.2
+    if (gpuDriven || app.transferUploads) {
+        features12.pNext = deviceFeatures.pNext;
+        deviceFeatures.pNext = &features12;
+    }
 
     VkDeviceCreateInfo createInfo {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &deviceFeatures;
 
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
-    createInfo.pEnabledFeatures = &deviceFeatures;
+    createInfo.pEnabledFeatures = nullptr;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -502,8 +1657,27 @@ void createLogicalDevice(HelloTriangleApp& app)
         throw std::runtime_error("failed to create logical device!");
     }
 
-    vkGetDeviceQueue(app.device, indices.presentFamily.value(), 0, &app.presentQueue);
+    if (app.synchronization2) {
+        app.cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(app.device, "vkCmdPipelineBarrier2KHR"));
+    }
+
+    vkGetDeviceQueue(app.device, indices.presentFamily.value(), 0, &app.presentQueue);
     vkGetDeviceQueue(app.device, indices.graphicsFamily.value(), 0, &app.graphicsQueue);
+    app.graphicsFamily = indices.graphicsFamily.value();
+
+    if (indices.computeFamily.has_value()) {
+        app.computeFamily = indices.computeFamily.value();
+        vkGetDeviceQueue(app.device, app.computeFamily, 0, &app.computeQueue);
+    }
+    if (indices.transferFamily.has_value()) {
+        app.transferFamily = indices.transferFamily.value();
+        vkGetDeviceQueue(app.device, app.transferFamily, 0, &app.transferQueue);
+    }
+    if (app.transferUploads) {
+        std::cout << "streaming textures through transfer queue family " << app.transferFamily << std::endl;
+    }
+
+    chooseAsyncCompute(app);
 }
 
 void createSurface(HelloTriangleApp& app)
@@ -524,30 +1698,38 @@ void createSurface(HelloTriangleApp& app)
     // }
 }
 
+[[nodiscard]] VkImageView createImageView(HelloTriangleApp& app, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel, uint32_t levelCount)
+{
+    VkImageViewCreateInfo createInfo {};
+    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    createInfo.image = image;
+    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.format = format;
+    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+    createInfo.subresourceRange.aspectMask = aspectFlags;
+    createInfo.subresourceRange.baseMipLevel = baseMipLevel;
+    createInfo.subresourceRange.levelCount = levelCount;
+    createInfo.subresourceRange.baseArrayLayer = 0;
+    createInfo.subresourceRange.layerCount = 1;
+
+    VkImageView imageView;
+    auto result = vkCreateImageView(app.device, &createInfo, nullptr, &imageView);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image views!");
+    }
+
+    return imageView;
+}
+
 void createImageViews(HelloTriangleApp& app)
 {
     app.swapChainImageViews.resize(app.swapChainImages.size());
     for (size_t i = 0; i < app.swapChainImages.size(); i++) {
-        VkImageViewCreateInfo createInfo {};
-        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        createInfo.image = app.swapChainImages[i];
-        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        createInfo.format = app.swapChainImageFormat;
-        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-
-        createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        createInfo.subresourceRange.baseMipLevel = 0;
-        createInfo.subresourceRange.levelCount = 1;
-        createInfo.subresourceRange.baseArrayLayer = 0;
-        createInfo.subresourceRange.layerCount = 1;
-
-        auto result = vkCreateImageView(app.device, &createInfo, nullptr, &app.swapChainImageViews[i]);
-        if (result != VK_SUCCESS) {
-            throw std::runtime_error("failed to create image views!");
-        }
+        app.swapChainImageViews[i] = createImageView(app, app.swapChainImages[i], app.swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
     }
 }
 
@@ -585,13 +1767,66 @@ void createImageViews(HelloTriangleApp& app)
     return buffer;
 }
 
-void createGraphicsPipeline(HelloTriangleApp& app)
+[[nodiscard]] VkVertexInputBindingDescription getInstanceBindingDescription()
+{
+    VkVertexInputBindingDescription bindingDescription {};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(InstanceData);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescription;
+}
+
+[[nodiscard]] std::array<VkVertexInputAttributeDescription, 5> getInstanceAttributeDescriptions()
+{
+    std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions {};
+
+    // a mat4 attribute takes up four consecutive locations, one per column
+    for (uint32_t i = 0; i < 4; i++) {
+        attributeDescriptions[i].binding = 0;
+        attributeDescriptions[i].location = i;
+        attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[i].offset = static_cast<uint32_t>(offsetof(InstanceData, model) + i * sizeof(glm::vec4));
+    }
+
+    attributeDescriptions[4].binding = 0;
+    attributeDescriptions[4].location = 4;
+    attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[4].offset = offsetof(InstanceData, color);
+
+    return attributeDescriptions;
+}
+
+[[nodiscard]] VkPipelineLayout createPipelineLayout(HelloTriangleApp& app, const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges)
+{
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+    VkPipelineLayout pipelineLayout;
+    auto result = vkCreatePipelineLayout(app.device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    return pipelineLayout;
+}
+
+[[nodiscard]] VkPipeline createPipeline(HelloTriangleApp& app, const std::string& vertShaderPath, const std::string& fragShaderPath, const VkPipelineVertexInputStateCreateInfo& vertexInputInfo, VkPipelineLayout pipelineLayout, DepthMode depthMode)
 {
-    auto vertShaderCode = readFile("shaders/vert.spv");
-    auto fragShaderCode = readFile("shaders/frag.spv");
+    // the depth pre-pass has no fragment shader, fixed function depth writes
+    // are all it needs
+    bool depthOnly = depthMode == DepthMode::PrePass;
 
+    auto vertShaderCode = readFile(vertShaderPath);
     VkShaderModule vertShaderModule = createShaderModule(app, vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(app, fragShaderCode);
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    if (!depthOnly) {
+        fragShaderModule = createShaderModule(app, readFile(fragShaderPath));
+    }
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo {};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -606,6 +1841,17 @@ void createGraphicsPipeline(HelloTriangleApp& app)
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
 
+    // constant 0 of bindless.glsl, bc5 only stores x and y so sampleTexture
+    // has to rebuild z. shaders that don't declare it ignore it
+    VkBool32 twoChannelTextures = app.textureFormat == TextureFormat::Bc5;
+    VkSpecializationMapEntry specializationEntry { 0, 0, sizeof(VkBool32) };
+    VkSpecializationInfo specializationInfo {};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &specializationEntry;
+    specializationInfo.dataSize = sizeof(VkBool32);
+    specializationInfo.pData = &twoChannelTextures;
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
     std::vector<VkDynamicState> dynamicStates = {
@@ -618,13 +1864,6 @@ void createGraphicsPipeline(HelloTriangleApp& app)
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.pVertexBindingDescriptions = nullptr;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-
     VkPipelineInputAssemblyStateCreateInfo inputAssembly {};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -654,7 +1893,7 @@ void createGraphicsPipeline(HelloTriangleApp& app)
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
     rasterizer.lineWidth = 1.0f;
     rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE;
     rasterizer.depthBiasConstantFactor = 0.0f;
     rasterizer.depthBiasClamp = 0.0f;
@@ -663,14 +1902,14 @@ void createGraphicsPipeline(HelloTriangleApp& app)
     VkPipelineMultisampleStateCreateInfo multisampling {};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.rasterizationSamples = app.msaaSamples;
     multisampling.minSampleShading = 1.0f;
     multisampling.pSampleMask = nullptr;
     multisampling.alphaToCoverageEnable = VK_FALSE;
     multisampling.alphaToOneEnable = VK_FALSE;
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment {};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.colorWriteMask = depthOnly ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
     colorBlendAttachment.blendEnable = VK_FALSE;
     colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
     colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -679,32 +1918,32 @@ void createGraphicsPipeline(HelloTriangleApp& app)
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
     colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
+    // with deferred shading the pipelines draw into the geometry subpass and
+    // its two g-buffer attachments
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments = { colorBlendAttachment, colorBlendAttachment };
+
     VkPipelineColorBlendStateCreateInfo colorBlending {};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.attachmentCount = app.deferredShading ? 2 : 1;
+    colorBlending.pAttachments = colorBlendAttachments.data();
     colorBlending.blendConstants[0] = 0.0f;
     colorBlending.blendConstants[1] = 0.0f;
     colorBlending.blendConstants[2] = 0.0f;
     colorBlending.blendConstants[3] = 0.0f;
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pSetLayouts = nullptr;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-    auto pipelineLayoutCreationresult = vkCreatePipelineLayout(app.device, &pipelineLayoutInfo, nullptr, &app.pipelineLayout);
-    if (pipelineLayoutCreationresult != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
-    }
+    VkPipelineDepthStencilStateCreateInfo depthStencil {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = depthMode == DepthMode::Equal ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = depthMode == DepthMode::Equal ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
 
     VkGraphicsPipelineCreateInfo pipelineInfo {};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
+    pipelineInfo.stageCount = depthOnly ? 1 : 2;
     pipelineInfo.pStages = shaderStages;
 
     pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -712,11 +1951,11 @@ void createGraphicsPipeline(HelloTriangleApp& app)
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr;
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
 
-    pipelineInfo.layout = app.pipelineLayout;
+    pipelineInfo.layout = pipelineLayout;
 
     pipelineInfo.renderPass = app.renderPass;
     pipelineInfo.subpass = 0;
@@ -724,62 +1963,575 @@ void createGraphicsPipeline(HelloTriangleApp& app)
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex = -1;
 
-    auto graphicsPipelineCreationresult = vkCreateGraphicsPipelines(app.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &app.graphicsPipeline);
+    VkPipeline pipeline;
+    auto graphicsPipelineCreationresult = vkCreateGraphicsPipelines(app.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
     if (graphicsPipelineCreationresult != VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
 
+    vkDestroyShaderModule(app.device, vertShaderModule, nullptr);
+    if (fragShaderModule != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(app.device, fragShaderModule, nullptr);
+    }
+
+    return pipeline;
+}
+
+void createGraphicsPipeline(HelloTriangleApp& app)
+{
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(glm::mat4);
+
+    app.pipelineLayout = createPipelineLayout(app, {}, { pushConstantRange });
+
+    auto bindingDescription = getInstanceBindingDescription();
+    auto attributeDescriptions = getInstanceAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    if (app.config.depthPrePass) {
+        app.graphicsDepthPipeline = createPipeline(app, "shaders/vert.spv", "", vertexInputInfo, app.pipelineLayout, DepthMode::PrePass);
+    }
+    DepthMode depthMode = app.config.depthPrePass ? DepthMode::Equal : DepthMode::Write;
+    app.graphicsPipeline = createPipeline(app, "shaders/vert.spv", "shaders/frag.spv", vertexInputInfo, app.pipelineLayout, depthMode);
+}
+
+[[nodiscard]] VkVertexInputBindingDescription getVertexBindingDescription(VertexFormat format)
+{
+    VkVertexInputBindingDescription bindingDescription {};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = getVertexStride(format);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+[[nodiscard]] std::array<VkVertexInputAttributeDescription, 3> getVertexAttributeDescriptions()
+{
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions {};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(Vertex, position);
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(Vertex, normal);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(Vertex, uv);
+
+    return attributeDescriptions;
+}
+
+[[nodiscard]] std::array<VkVertexInputAttributeDescription, 3> getPackedVertexAttributeDescriptions()
+{
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions {};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(PackedVertex, position);
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[1].offset = offsetof(PackedVertex, normal);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(PackedVertex, uv);
+
+    return attributeDescriptions;
+}
+
+void createSceneDescriptorSetLayout(HelloTriangleApp& app)
+{
+    std::array<VkDescriptorSetLayoutBinding, 8> bindings {};
+
+    // objects, meshes, draw commands, draw count, meshlets, previous
+    // visibility, visibility and the depth pyramid
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    auto result = vkCreateDescriptorSetLayout(app.device, &layoutInfo, nullptr, &app.sceneSetLayout);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+}
+
+void createMeshPipeline(HelloTriangleApp& app)
+{
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MeshPushConstants);
+
+    app.meshPipelineLayout = createPipelineLayout(app, { app.bindlessSetLayout }, { pushConstantRange });
+
+    bool packed = app.vertexFormat == VertexFormat::Packed;
+    auto bindingDescription = getVertexBindingDescription(app.vertexFormat);
+    auto attributeDescriptions = packed ? getPackedVertexAttributeDescriptions() : getVertexAttributeDescriptions();
+
+    for (const auto& attribute : attributeDescriptions) {
+        VkFormatProperties properties = getFormatProperties(app, app.physicalDevice, attribute.format);
+        if (!(properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)) {
+            throw std::runtime_error(std::string("vertex format ") + getVertexFormatName(app.vertexFormat) + " is not supported by the device!");
+        }
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    const char* vertShaderPath = packed ? "shaders/mesh_packed_vert.spv" : "shaders/mesh_vert.spv";
+    if (app.config.depthPrePass) {
+        app.meshDepthPipeline = createPipeline(app, vertShaderPath, "", vertexInputInfo, app.meshPipelineLayout, DepthMode::PrePass);
+    }
+    DepthMode depthMode = app.config.depthPrePass ? DepthMode::Equal : DepthMode::Write;
+    const char* fragShaderPath = app.deferredShading ? "shaders/mesh_gbuffer_frag.spv" : "shaders/mesh_frag.spv";
+    app.meshPipeline = createPipeline(app, vertShaderPath, fragShaderPath, vertexInputInfo, app.meshPipelineLayout, depthMode);
+}
+
+// the g-buffer, and depth to rebuild positions from, as input attachments of
+// the lighting subpass
+void createGBufferDescriptorSet(HelloTriangleApp& app)
+{
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings {};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    auto result = vkCreateDescriptorSetLayout(app.device, &layoutInfo, nullptr, &app.gbufferSetLayout);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size());
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    result = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &app.gbufferDescriptorPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = app.gbufferDescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &app.gbufferSetLayout;
+
+    result = vkAllocateDescriptorSets(app.device, &allocInfo, &app.gbufferDescriptorSet);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    std::array<VkDescriptorImageInfo, 3> imageInfos = { {
+        { VK_NULL_HANDLE, app.gbufferAlbedoImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { VK_NULL_HANDLE, app.gbufferNormalImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { VK_NULL_HANDLE, app.depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL },
+    } };
+
+    std::array<VkWriteDescriptorSet, 3> descriptorWrites {};
+    for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+        descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[binding].dstSet = app.gbufferDescriptorSet;
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].dstArrayElement = 0;
+        descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        descriptorWrites[binding].descriptorCount = 1;
+        descriptorWrites[binding].pImageInfo = &imageInfos[binding];
+    }
+
+    vkUpdateDescriptorSets(app.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+// a full screen triangle in the lighting subpass, no vertex input and no
+// depth test, every covered pixel is lit exactly once
+void createDeferredLightingPipeline(HelloTriangleApp& app)
+{
+    createGBufferDescriptorSet(app);
+
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DeferredLightingPushConstants);
+
+    app.deferredLightingPipelineLayout = createPipelineLayout(app, { app.bindlessSetLayout, app.gbufferSetLayout }, { pushConstantRange });
+
+    VkShaderModule vertShaderModule = createShaderModule(app, readFile("shaders/fullscreen_vert.spv"));
+    VkShaderModule fragShaderModule = createShaderModule(app, readFile("shaders/deferred_lighting_frag.spv"));
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamicState {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading = 1.0f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = app.deferredLightingPipelineLayout;
+    pipelineInfo.renderPass = app.renderPass;
+    pipelineInfo.subpass = 1;
+    pipelineInfo.basePipelineIndex = -1;
+
+    auto result = vkCreateGraphicsPipelines(app.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &app.deferredLightingPipeline);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
     vkDestroyShaderModule(app.device, vertShaderModule, nullptr);
     vkDestroyShaderModule(app.device, fragShaderModule, nullptr);
 }
 
-void createRenderPass(HelloTriangleApp& app)
+[[nodiscard]] VkPipeline createComputePipeline(HelloTriangleApp& app, const std::string& shaderPath, VkPipelineLayout pipelineLayout)
+{
+    auto shaderCode = readFile(shaderPath);
+    VkShaderModule shaderModule = createShaderModule(app, shaderCode);
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo {};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.module = shaderModule;
+    shaderStageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = shaderStageInfo;
+    pipelineInfo.layout = pipelineLayout;
+
+    VkPipeline pipeline;
+    auto result = vkCreateComputePipelines(app.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+
+    vkDestroyShaderModule(app.device, shaderModule, nullptr);
+
+    return pipeline;
+}
+
+void createCullPipeline(HelloTriangleApp& app)
+{
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+
+    app.cullPipelineLayout = createPipelineLayout(app, { app.sceneSetLayout }, { pushConstantRange });
+    const char* shaderPath = app.config.clusterCulling ? "shaders/cluster_cull_comp.spv" : "shaders/cull_comp.spv";
+    app.cullPipeline = createComputePipeline(app, shaderPath, app.cullPipelineLayout);
+}
+
+void createLightCullPipeline(HelloTriangleApp& app)
+{
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(LightCullPushConstants);
+
+    app.lightCullPipelineLayout = createPipelineLayout(app, { app.bindlessSetLayout }, { pushConstantRange });
+    app.lightCullPipeline = createComputePipeline(app, "shaders/light_cluster_comp.spv", app.lightCullPipelineLayout);
+}
+
+[[nodiscard]] VkRenderPass createSceneRenderPass(HelloTriangleApp& app, ScenePass pass)
 {
+    bool early = pass == ScenePass::Early;
+    bool late = pass == ScenePass::Late;
+    // only the single pass is ever multisampled, see chooseMsaaSamples
+    bool multisampled = app.msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+    // attachments start and end in the layout the subpass uses them in. the
+    // frame graph moves them in and out of it and synchronizes them with the
+    // passes around, so the render pass has no external dependencies
+
     VkAttachmentDescription colorAttachment {};
     colorAttachment.format = app.swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.samples = app.msaaSamples;
 
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // the samples are averaged into the swap chain image as the subpass
+    // ends, so they never reach memory
+    VkAttachmentDescription resolveAttachment {};
+    resolveAttachment.format = app.swapChainImageFormat;
+    resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    resolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // depth is only needed while the pass runs, unless the depth pyramid is
+    // built from it between the early and the late pass
+    VkAttachmentDescription depthAttachment {};
+    depthAttachment.format = app.depthFormat;
+    depthAttachment.samples = app.msaaSamples;
+
+    depthAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = early ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef {};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef {};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference resolveAttachmentRef {};
+    resolveAttachmentRef.attachment = 2;
+    resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass {};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+    subpass.pResolveAttachments = multisampled ? &resolveAttachmentRef : nullptr;
 
-    VkSubpassDependency dependency {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    std::array<VkAttachmentDescription, 3> attachments = { colorAttachment, depthAttachment, resolveAttachment };
 
     VkRenderPassCreateInfo renderPassInfo {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = multisampled ? 3 : 2;
+    renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
 
+    renderPassInfo.dependencyCount = 0;
+    renderPassInfo.pDependencies = nullptr;
+
+    VkRenderPass renderPass;
+    auto result = vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &renderPass);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+
+    return renderPass;
+}
+
+// the geometry subpass fills the g-buffer, the lighting subpass reads it
+// back at the same pixel and writes the output. neither the g-buffer nor
+// depth is stored, so on a tiler they never leave the chip
+[[nodiscard]] VkRenderPass createDeferredRenderPass(HelloTriangleApp& app)
+{
+    // every pixel of the render area is written by the lighting subpass
+    VkAttachmentDescription outputAttachment {};
+    outputAttachment.format = app.swapChainImageFormat;
+    outputAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    outputAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    outputAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    outputAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    outputAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    outputAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    outputAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription depthAttachment {};
+    depthAttachment.format = app.depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // pixels nothing is drawn to are skipped by the lighting, so the g-buffer
+    // needn't be cleared. the frame graph transitions it like the others
+    VkAttachmentDescription albedoAttachment {};
+    albedoAttachment.format = GBUFFER_ALBEDO_FORMAT;
+    albedoAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    albedoAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    albedoAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    albedoAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    albedoAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    albedoAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    albedoAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription normalAttachment = albedoAttachment;
+    normalAttachment.format = GBUFFER_NORMAL_FORMAT;
+
+    std::array<VkAttachmentReference, 2> gbufferRefs = { {
+        { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+        { 3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+    } };
+    VkAttachmentReference depthRef { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+    // in input_attachment_index order, see deferred_lighting.frag
+    std::array<VkAttachmentReference, 3> inputRefs = { {
+        { 2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { 3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL },
+    } };
+    VkAttachmentReference outputRef { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    std::array<VkSubpassDescription, 2> subpasses {};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gbufferRefs.size());
+    subpasses[0].pColorAttachments = gbufferRefs.data();
+    subpasses[0].pDepthStencilAttachment = &depthRef;
+    subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[1].inputAttachmentCount = static_cast<uint32_t>(inputRefs.size());
+    subpasses[1].pInputAttachments = inputRefs.data();
+    subpasses[1].colorAttachmentCount = 1;
+    subpasses[1].pColorAttachments = &outputRef;
+
+    // the frame graph orders the render pass against the previous frame, only
+    // the subpasses need ordering here. by region, since each pixel only
+    // reads its own g-buffer texels
+    VkSubpassDependency dependency {};
+    dependency.srcSubpass = 0;
+    dependency.dstSubpass = 1;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    std::array<VkAttachmentDescription, 4> attachments = { outputAttachment, depthAttachment, albedoAttachment, normalAttachment };
+
+    VkRenderPassCreateInfo renderPassInfo {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &dependency;
 
-    auto result = vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &app.renderPass);
+    VkRenderPass renderPass;
+    auto result = vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &renderPass);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+
+    return renderPass;
+}
+
+void createRenderPass(HelloTriangleApp& app)
+{
+    if (app.deferredShading) {
+        app.renderPass = createDeferredRenderPass(app);
+        return;
+    }
+
+    app.renderPass = createSceneRenderPass(app, ScenePass::Single);
+
+    // all three are compatible, so the pipelines and framebuffers made for
+    // the single pass work in the other two as well
+    if (app.config.occlusionCulling) {
+        app.earlyRenderPass = createSceneRenderPass(app, ScenePass::Early);
+        app.lateRenderPass = createSceneRenderPass(app, ScenePass::Late);
+    }
 }
 
 void createFramebuffers(HelloTriangleApp& app)
@@ -787,15 +2539,21 @@ void createFramebuffers(HelloTriangleApp& app)
     app.swapChainFramebuffers.resize(app.swapChainImageViews.size());
 
     for (size_t i = 0; i < app.swapChainImageViews.size(); i++) {
-        VkImageView attachments[] = {
-            app.swapChainImageViews[i]
-        };
+        // with msaa the output is only the resolve target
+        VkImageView output = app.dynamicResolution ? app.offscreenImageView : app.swapChainImageViews[i];
+        std::vector<VkImageView> attachments = { output, app.depthImageView };
+        if (app.msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+            attachments = { app.colorImageView, app.depthImageView, output };
+        }
+        if (app.deferredShading) {
+            attachments = { output, app.depthImageView, app.gbufferAlbedoImageView, app.gbufferNormalImageView };
+        }
 
         VkFramebufferCreateInfo framebufferInfo {};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferInfo.renderPass = app.renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
         framebufferInfo.width = app.swapChainExtent.width;
         framebufferInfo.height = app.swapChainExtent.height;
         framebufferInfo.layers = 1;
@@ -820,66 +2578,3490 @@ void createCommandPool(HelloTriangleApp& app)
     if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
+
+    if (app.asyncCompute) {
+        poolInfo.queueFamilyIndex = app.computeFamily;
+        result = vkCreateCommandPool(app.device, &poolInfo, nullptr, &app.computeCommandPool);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+    }
 }
 
-void createCommandBuffer(HelloTriangleApp& app)
+void createCommandBuffers(HelloTriangleApp& app)
 {
+    app.commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
     VkCommandBufferAllocateInfo allocInfo {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = app.commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 1;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(app.commandBuffers.size());
 
-    auto result = vkAllocateCommandBuffers(app.device, &allocInfo, &app.commandBuffer);
+    auto result = vkAllocateCommandBuffers(app.device, &allocInfo, app.commandBuffers.data());
     if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers!");
     }
+
+    if (app.asyncCompute) {
+        app.computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.commandPool = app.computeCommandPool;
+        result = vkAllocateCommandBuffers(app.device, &allocInfo, app.computeCommandBuffers.data());
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
 }
 
-void recordCommandBufer(HelloTriangleApp& app, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+[[nodiscard]] uint32_t findMemoryType(HelloTriangleApp& app, uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
-    VkCommandBufferBeginInfo beginInfo {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;
-    beginInfo.pInheritanceInfo = nullptr;
+    // looked up without getDeviceCapabilities and its counters, the transfer
+    // worker allocates too
+    const VkPhysicalDeviceMemoryProperties& memProperties = app.deviceCapabilities.at(app.physicalDevice).memoryProperties;
 
-    auto commandBufferBeginningResult = vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    if (commandBufferBeginningResult != VK_SUCCESS) {
-        throw std::runtime_error("failed to begin recording command buffer!");
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+// shared by queueFamilies when there are two or more of them, so no queue
+// has to transfer ownership before it reads the contents
+void createSharedBuffer(HelloTriangleApp& app, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const std::vector<uint32_t>& queueFamilies,
+    VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+    VkBufferCreateInfo bufferInfo {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (queueFamilies.size() > 1) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+        bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+    }
+
+    auto result = vkCreateBuffer(app.device, &bufferInfo, nullptr, &buffer);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(app.device, buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(app, memRequirements.memoryTypeBits, properties);
+
+    auto allocResult = vkAllocateMemory(app.device, &allocInfo, nullptr, &bufferMemory);
+    if (allocResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate buffer memory!");
+    }
+
+    vkBindBufferMemory(app.device, buffer, bufferMemory, 0);
+}
+
+void createBuffer(HelloTriangleApp& app, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+    createSharedBuffer(app, size, usage, properties, {}, buffer, bufferMemory);
+}
+
+// without memory, for images bound into a shared block
+void createUnboundImage(HelloTriangleApp& app, uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits samples, VkFormat format, VkImageTiling tiling,
+    VkImageUsageFlags usage, VkImageCreateFlags flags, VkImage& image)
+{
+    VkImageCreateInfo imageInfo {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.flags = flags;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = tiling;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = samples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    auto result = vkCreateImage(app.device, &imageInfo, nullptr, &image);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+}
+
+void createImage(HelloTriangleApp& app, uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits samples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkImageCreateFlags flags, VkImage& image, VkDeviceMemory& imageMemory)
+{
+    createUnboundImage(app, width, height, mipLevels, samples, format, tiling, usage, flags, image);
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(app.device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(app, memRequirements.memoryTypeBits, properties);
+
+    auto allocResult = vkAllocateMemory(app.device, &allocInfo, nullptr, &imageMemory);
+    if (allocResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate image memory!");
+    }
+
+    vkBindImageMemory(app.device, image, imageMemory, 0);
+}
+
+[[nodiscard]] VkFormat findSupportedFormat(HelloTriangleApp& app, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
+{
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties = getFormatProperties(app, app.physicalDevice, format);
+
+        VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+        if ((supported & features) == features) {
+            return format;
+        }
+    }
+
+    throw std::runtime_error("failed to find supported format!");
+}
+
+[[nodiscard]] VkFormat findDepthFormat(HelloTriangleApp& app)
+{
+    // occlusion culling samples depth to build the depth pyramid
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (app.config.occlusionCulling) {
+        features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    }
+
+    // no stencil is used, so the plain 32 bit float format comes first
+    return findSupportedFormat(app, { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM },
+        VK_IMAGE_TILING_OPTIMAL, features);
+}
+
+// tilers can keep transient attachments on chip and never back them with
+// memory. elsewhere there is no lazily allocated memory type and they get
+// plain device memory
+[[nodiscard]] VkMemoryPropertyFlags getTransientMemoryProperties(HelloTriangleApp& app)
+{
+    const VkPhysicalDeviceMemoryProperties& memProperties = getDeviceCapabilities(app, app.physicalDevice).memoryProperties;
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+            return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        }
+    }
+
+    return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+// a swap chain sized attachment that doesn't outlive the frame. lazily
+// allocated memory is its own, anything else would only be backed in full,
+// so the image is left unbound for createTransientMemory to place in the
+// frame graph's block. the requirements stay empty for the former
+void createAttachmentImage(HelloTriangleApp& app, VkSampleCountFlagBits samples, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkImage& image, VkDeviceMemory& imageMemory, VkMemoryRequirements& requirements)
+{
+    requirements = {};
+    imageMemory = VK_NULL_HANDLE;
+
+    if (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+        createImage(app, app.swapChainExtent.width, app.swapChainExtent.height, 1, samples, format, VK_IMAGE_TILING_OPTIMAL, usage, properties, 0, image, imageMemory);
+        return;
+    }
+
+    createUnboundImage(app, app.swapChainExtent.width, app.swapChainExtent.height, 1, samples, format, VK_IMAGE_TILING_OPTIMAL, usage, 0, image);
+    vkGetImageMemoryRequirements(app.device, image, &requirements);
+}
+
+// the multisampled color target is resolved into the swap chain image at the
+// end of the subpass and never stored
+void createColorResources(HelloTriangleApp& app)
+{
+    if (app.msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+        return;
+    }
+
+    createAttachmentImage(app, app.msaaSamples, app.swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+        getTransientMemoryProperties(app), app.colorImage, app.colorImageMemory, app.colorRequirements);
+}
+
+// written and read within the deferred render pass, never stored
+void createGBuffer(HelloTriangleApp& app)
+{
+    if (!app.deferredShading) {
+        return;
+    }
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    createAttachmentImage(app, VK_SAMPLE_COUNT_1_BIT, GBUFFER_ALBEDO_FORMAT, usage, getTransientMemoryProperties(app), app.gbufferAlbedoImage, app.gbufferAlbedoImageMemory,
+        app.gbufferAlbedoRequirements);
+    createAttachmentImage(app, VK_SAMPLE_COUNT_1_BIT, GBUFFER_NORMAL_FORMAT, usage, getTransientMemoryProperties(app), app.gbufferNormalImage, app.gbufferNormalImageMemory,
+        app.gbufferNormalRequirements);
+}
+
+// the upscale blits from it, which lazily allocated memory can't back
+void createOffscreenImage(HelloTriangleApp& app)
+{
+    VkDeviceMemory unused = VK_NULL_HANDLE;
+    createAttachmentImage(app, VK_SAMPLE_COUNT_1_BIT, app.swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, app.offscreenImage, unused, app.offscreenRequirements);
+}
+
+// the scene target of dynamic resolution. the upscale is a linear blit and
+// frames are measured with timestamps, without either the scene renders at
+// the swap chain resolution
+void createOffscreenTarget(HelloTriangleApp& app)
+{
+    if (app.config.targetFrameMilliseconds <= 0.0f) {
+        return;
+    }
+
+    if (app.config.occlusionCulling) {
+        std::cout << "dynamic resolution is not available with occlusion culling" << std::endl;
+        return;
+    }
+
+    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(app, app.physicalDevice);
+
+    VkFormatProperties formatProperties = getFormatProperties(app, app.physicalDevice, app.swapChainImageFormat);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+        | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    uint32_t timestampBits = getDeviceCapabilities(app, app.physicalDevice).queueFamilies[app.graphicsFamily].timestampValidBits;
+
+    if (!(swapChainSupport.capabilites.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) || (formatProperties.optimalTilingFeatures & required) != required
+        || timestampBits == 0) {
+        std::cout << "device can't scale the resolution, rendering at " << app.swapChainExtent.width << "x" << app.swapChainExtent.height << std::endl;
+        return;
+    }
+
+    app.dynamicResolution = true;
+    app.timestampMask = timestampBits == 64 ? ~0ull : (1ull << timestampBits) - 1;
+    app.timestampPeriod = app.deviceProfile.timestampPeriod;
+    app.resolutionController = makeResolutionController(app.config.targetFrameMilliseconds, app.config.minRenderScale, 1.0f, MAX_FRAMES_IN_FLIGHT);
+
+    createOffscreenImage(app);
+
+    VkQueryPoolCreateInfo queryPoolInfo {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+
+    auto result = vkCreateQueryPool(app.device, &queryPoolInfo, nullptr, &app.timestampQueryPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create query pool!");
+    }
+    app.timestampsWritten.assign(MAX_FRAMES_IN_FLIGHT, false);
+}
+
+// the lights are binned unless there are none or every pixel is to loop
+// over all of them
+[[nodiscard]] bool usesLightClusters(const AppConfig& config)
+{
+    return config.renderPath == RenderPath::GpuDriven && config.lightCount > 0 && !config.naiveLighting;
+}
+
+uint32_t addFrameGraphResource(HelloTriangleApp& app, const GraphResourceDesc& desc, VkImage image, VkImageAspectFlags aspect)
+{
+    app.frameGraphImages.push_back({ image, aspect });
+    return addGraphResource(app.frameGraph, desc);
+}
+
+// declares what the frame records, in order. barriers come out of what the
+// passes say they touch, render pass attachments included
+void declareFrameGraph(HelloTriangleApp& app, uint32_t imageIndex)
+{
+    RenderGraph& graph = app.frameGraph;
+    resetRenderGraph(graph);
+    app.frameGraphImages.clear();
+
+    bool gpuDriven = app.config.renderPath == RenderPath::GpuDriven;
+    bool occlusion = gpuDriven && app.config.occlusionCulling;
+    bool multisampled = app.msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    // culled on the compute queue, the draw buffers arrive with the
+    // semaphore and ownership transfer drawFrame sets up
+    bool graphicsCulling = gpuDriven && !app.asyncCompute;
+    bool lightClusters = usesLightClusters(app.config);
+
+    // acquired every frame with whatever is in it, the acquire semaphore is
+    // waited for at the color attachment output stage, see drawFrame
+    GraphResourceDesc swapChainDesc {};
+    swapChainDesc.image = true;
+    swapChainDesc.transient = true;
+    swapChainDesc.external = true;
+    swapChainDesc.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    swapChainDesc.externalStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    uint32_t swapChain = addFrameGraphResource(app, swapChainDesc, app.swapChainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // the ones without memory of their own are placed in the transient block,
+    // see createAttachmentImage
+    auto addAttachment = [&](VkImage image, const VkMemoryRequirements& requirements, VkImageAspectFlags aspect) {
+        GraphResourceDesc desc {};
+        desc.image = true;
+        desc.transient = true;
+        desc.size = requirements.size;
+        desc.alignment = requirements.alignment;
+        desc.memoryTypeBits = requirements.memoryTypeBits;
+        return addFrameGraphResource(app, desc, image, aspect);
+    };
+
+    uint32_t output = swapChain;
+    if (app.dynamicResolution) {
+        output = addAttachment(app.offscreenImage, app.offscreenRequirements, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    uint32_t depth = addAttachment(app.depthImage, app.depthRequirements, VK_IMAGE_ASPECT_DEPTH_BIT);
+    uint32_t color = output;
+    if (multisampled) {
+        color = addAttachment(app.colorImage, app.colorRequirements, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+    uint32_t gbufferAlbedo = 0;
+    uint32_t gbufferNormal = 0;
+    if (app.deferredShading) {
+        gbufferAlbedo = addAttachment(app.gbufferAlbedoImage, app.gbufferAlbedoRequirements, VK_IMAGE_ASPECT_COLOR_BIT);
+        gbufferNormal = addAttachment(app.gbufferNormalImage, app.gbufferNormalRequirements, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    uint32_t drawBuffers = 0;
+    uint32_t visibility = 0;
+    uint32_t depthPyramid = 0;
+    uint32_t clusters = 0;
+    uint32_t lights = 0;
+    if (gpuDriven) {
+        // each frame in flight has its own draw buffers, but they are filled
+        // from scratch every frame
+        GraphResourceDesc drawDesc {};
+        drawDesc.transient = true;
+        drawBuffers = addFrameGraphResource(app, drawDesc, VK_NULL_HANDLE, 0);
+
+        // the late phase writes it for the early phase of the next frame
+        GraphResourceDesc visibilityDesc {};
+        visibility = addFrameGraphResource(app, visibilityDesc, VK_NULL_HANDLE, 0);
+
+        GraphResourceDesc pyramidDesc {};
+        pyramidDesc.image = true;
+        pyramidDesc.layout = VK_IMAGE_LAYOUT_GENERAL;
+        depthPyramid = addFrameGraphResource(app, pyramidDesc, app.depthPyramid, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        // synchronizes the textures it streams itself
+        addGraphPass(graph, static_cast<uint32_t>(FramePass::TextureStreaming), true);
+
+        // each frame in flight has its own light buffer, copied over whole
+        GraphResourceDesc lightDesc {};
+        lightDesc.transient = true;
+        lights = addFrameGraphResource(app, lightDesc, VK_NULL_HANDLE, 0);
+
+        uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::LightUpload), false);
+        addGraphWrite(graph, pass, lights, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+    }
+
+    if (lightClusters) {
+        // binned from scratch every frame, like the draw buffers
+        GraphResourceDesc clusterDesc {};
+        clusterDesc.transient = true;
+        clusters = addFrameGraphResource(app, clusterDesc, VK_NULL_HANDLE, 0);
+    }
+
+    if (graphicsCulling) {
+        uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::Cull), false);
+        addGraphWrite(graph, pass, drawBuffers, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, 0);
+        if (occlusion) {
+            addGraphRead(graph, pass, visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0);
+        }
+    }
+
+    if (lightClusters) {
+        uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::LightCulling), false);
+        addGraphRead(graph, pass, lights, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0);
+        addGraphWrite(graph, pass, clusters, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, 0);
+    }
+
+    // the cache keeps its contents between frames and is only drawn into on
+    // the frames a cascade went stale, the graph compiles a second variant
+    // for those
+    uint32_t shadowMap = 0;
+    if (app.shadows) {
+        bool dynamicCasters = app.shadowMapImage != VK_NULL_HANDLE;
+        uint64_t depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        uint64_t depthAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        GraphResourceDesc cacheDesc {};
+        cacheDesc.image = true;
+        cacheDesc.layout = dynamicCasters ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        uint32_t cache = addFrameGraphResource(app, cacheDesc, app.shadowCacheImage, VK_IMAGE_ASPECT_DEPTH_BIT);
+        shadowMap = cache;
+
+        // only the stale layers are cleared, the others are kept
+        if (app.staleCascadeMask != 0) {
+            uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::StaticShadows), false);
+            addGraphReadWrite(graph, pass, cache, depthStages, depthAccess, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        }
+
+        if (dynamicCasters) {
+            GraphResourceDesc mapDesc {};
+            mapDesc.image = true;
+            mapDesc.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            shadowMap = addFrameGraphResource(app, mapDesc, app.shadowMapImage, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+            uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::ShadowComposite), false);
+            addGraphRead(graph, pass, cache, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+            addGraphWrite(graph, pass, shadowMap, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+            pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::DynamicShadows), false);
+            addGraphReadWrite(graph, pass, shadowMap, depthStages, depthAccess, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        }
+    }
+
+    auto addScenePass = [&](FramePass tag, bool load) {
+        uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(tag), false);
+        if (graphicsCulling) {
+            addGraphRead(graph, pass, drawBuffers, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0);
+        }
+        if (gpuDriven) {
+            addGraphRead(graph, pass, lights, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0);
+        }
+        if (lightClusters) {
+            addGraphRead(graph, pass, clusters, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0);
+        }
+        if (app.shadows) {
+            addGraphRead(graph, pass, shadowMap, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+
+        uint64_t depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        uint64_t depthAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        uint64_t colorAccess = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        // the lighting subpass reads depth and the g-buffer back as input
+        // attachments, the layout the subpass reads them in is undone by the
+        // end of the render pass
+        if (app.deferredShading) {
+            uint64_t gbufferStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            uint64_t gbufferAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+            addGraphWrite(graph, pass, gbufferAlbedo, gbufferStages, gbufferAccess, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+            addGraphWrite(graph, pass, gbufferNormal, gbufferStages, gbufferAccess, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+            depthStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            depthAccess |= VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        }
+        if (load) {
+            addGraphReadWrite(graph, pass, depth, depthStages, depthAccess, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+            addGraphReadWrite(graph, pass, color, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorAccess, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        } else {
+            addGraphWrite(graph, pass, depth, depthStages, depthAccess, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+            addGraphWrite(graph, pass, color, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorAccess, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        }
+        // the resolve writes the samples out as the subpass ends
+        if (multisampled) {
+            addGraphWrite(graph, pass, output, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        }
+    };
+
+    if (occlusion) {
+        addScenePass(FramePass::EarlyScene, false);
+
+        uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::DepthPyramid), false);
+        addGraphRead(graph, pass, depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        addGraphWrite(graph, pass, depthPyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL);
+
+        pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::LateCull), false);
+        addGraphRead(graph, pass, depthPyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+        addGraphWrite(graph, pass, drawBuffers, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, 0);
+        addGraphWrite(graph, pass, visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, 0);
+
+        addScenePass(FramePass::LateScene, true);
+    } else {
+        addScenePass(FramePass::Scene, false);
+    }
+
+    if (app.dynamicResolution) {
+        uint32_t pass = addGraphPass(graph, static_cast<uint32_t>(FramePass::Upscale), false);
+        addGraphRead(graph, pass, output, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        addGraphWrite(graph, pass, swapChain, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    }
+}
+
+// binds the transient images of the frame graph where its compiled layout
+// puts them, then gives every attachment its view. the graph only changes
+// with the configuration and with the static shadow pass, which touches none
+// of them, so the images that share memory stay the same
+void createTransientMemory(HelloTriangleApp& app)
+{
+    declareFrameGraph(app, 0);
+    const CompiledGraph& frameGraph = compileRenderGraph(app.frameGraph);
+    app.checkedCompileCount = app.frameGraph.compileCount;
+    app.transientBindings.clear();
+
+    uint64_t placedSize = 0;
+    uint32_t placedCount = 0;
+    for (const auto& desc : app.frameGraph.resources) {
+        if (desc.transient && desc.size > 0) {
+            placedSize += desc.size;
+            placedCount++;
+        }
+    }
+    std::cout << "frame graph: " << frameGraph.passes.size() << " passes, " << app.frameGraph.culledPassCount << " culled, " << placedCount
+              << " transient images in " << frameGraph.memorySize / 1024 << " KiB (" << placedSize / 1024 << " KiB unaliased), "
+              << (app.synchronization2 ? "synchronization2" : "legacy") << " barriers" << std::endl;
+
+    if (frameGraph.memorySize > 0) {
+        VkMemoryAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = frameGraph.memorySize;
+        allocInfo.memoryTypeIndex = findMemoryType(app, frameGraph.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        auto result = vkAllocateMemory(app.device, &allocInfo, nullptr, &app.transientMemory);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate transient memory!");
+        }
+
+        for (uint32_t i = 0; i < app.frameGraph.resources.size(); i++) {
+            const GraphResourceDesc& desc = app.frameGraph.resources[i];
+            if (desc.transient && desc.size > 0) {
+                vkBindImageMemory(app.device, app.frameGraphImages[i].image, app.transientMemory, frameGraph.memoryOffsets[i]);
+                app.transientBindings.push_back({ app.frameGraphImages[i].image, frameGraph.memoryOffsets[i] });
+            }
+        }
+    }
+
+    // views need the memory bound
+    app.depthImageView = createImageView(app, app.depthImage, app.depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+    if (app.colorImage != VK_NULL_HANDLE) {
+        app.colorImageView = createImageView(app, app.colorImage, app.swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+    }
+    if (app.deferredShading) {
+        app.gbufferAlbedoImageView = createImageView(app, app.gbufferAlbedoImage, GBUFFER_ALBEDO_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+        app.gbufferNormalImageView = createImageView(app, app.gbufferNormalImage, GBUFFER_NORMAL_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+    }
+    if (app.dynamicResolution) {
+        app.offscreenImageView = createImageView(app, app.offscreenImage, app.swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+    }
+}
+
+void createDepthResources(HelloTriangleApp& app)
+{
+    app.depthFormat = findDepthFormat(app);
+
+    // occlusion culling reduces depth into the pyramid, otherwise it never
+    // has to leave the tile on gpus that can keep it there
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (app.config.occlusionCulling) {
+        usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    } else {
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        properties = getTransientMemoryProperties(app);
+    }
+    // the lighting subpass rebuilds positions from it
+    if (app.deferredShading) {
+        usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    }
+
+    createAttachmentImage(app, app.msaaSamples, app.depthFormat, usage, properties, app.depthImage, app.depthImageMemory, app.depthRequirements);
+}
+
+void createStatisticsQueryPool(HelloTriangleApp& app)
+{
+    VkQueryPoolCreateInfo queryPoolInfo {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT;
+    queryPoolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+    auto result = vkCreateQueryPool(app.device, &queryPoolInfo, nullptr, &app.statisticsQueryPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create query pool!");
+    }
+
+    app.statisticsQueryWritten.assign(MAX_FRAMES_IN_FLIGHT, false);
+}
+
+// called once the frame's fence has signaled, so the results are available
+// without waiting
+void readPipelineStatistics(HelloTriangleApp& app)
+{
+    if (app.statisticsQueryPool == VK_NULL_HANDLE || !app.statisticsQueryWritten[app.currentFrame]) {
+        return;
+    }
+
+    std::array<uint64_t, PIPELINE_STATISTIC_COUNT> results {};
+    auto result = vkGetQueryPoolResults(app.device, app.statisticsQueryPool, app.currentFrame, 1, sizeof(results), results.data(), sizeof(results), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+        app.statisticsTotals[i] += results[i];
+    }
+    app.statisticsFrames++;
+}
+
+// the new scale applies from the frame about to be recorded, the one measured
+// finished MAX_FRAMES_IN_FLIGHT frames ago
+void updateRenderScale(HelloTriangleApp& app)
+{
+    if (!app.dynamicResolution || !app.timestampsWritten[app.currentFrame]) {
+        return;
+    }
+
+    std::array<uint64_t, 2> timestamps {};
+    auto result = vkGetQueryPoolResults(app.device, app.timestampQueryPool, app.currentFrame * 2, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    float gpuMilliseconds = static_cast<float>(((timestamps[1] - timestamps[0]) & app.timestampMask) * app.timestampPeriod / 1e6);
+    float scale = updateResolutionScale(app.resolutionController, gpuMilliseconds, MAX_FRAMES_IN_FLIGHT);
+
+    app.renderExtent.width = std::max(1u, static_cast<uint32_t>(std::lround(app.swapChainExtent.width * scale)));
+    app.renderExtent.height = std::max(1u, static_cast<uint32_t>(std::lround(app.swapChainExtent.height * scale)));
+
+    app.scaleTotal += scale;
+    app.gpuMillisecondsTotal += gpuMilliseconds;
+    app.timedFrames++;
+}
+
+[[nodiscard]] VkCommandBuffer beginSingleTimeCommands(HelloTriangleApp& app)
+{
+    VkCommandBufferAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = app.commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(app.device, &allocInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    return commandBuffer;
+}
+
+void endSingleTimeCommands(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(app.graphicsQueue);
+
+    vkFreeCommandBuffers(app.device, app.commandPool, 1, &commandBuffer);
+}
+
+void createStagingRing(HelloTriangleApp& app)
+{
+    StagingRing& ring = app.stagingRing;
+
+    createBuffer(app, 2 * STAGING_RING_HALF_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ring.buffer, ring.memory);
+
+    void* mapped;
+    vkMapMemory(app.device, ring.memory, 0, 2 * STAGING_RING_HALF_SIZE, 0, &mapped);
+    ring.mapped = static_cast<uint8_t*>(mapped);
+
+    VkCommandBufferAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = app.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(ring.commandBuffers.size());
+
+    if (vkAllocateCommandBuffers(app.device, &allocInfo, ring.commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate staging command buffers!");
+    }
+
+    VkFenceCreateInfo fenceInfo {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (auto& fence : ring.fences) {
+        if (vkCreateFence(app.device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create staging fence!");
+        }
+    }
+}
+
+// copies straight from data, which may be a mapped file, into the staging
+// ring and from there into dstBuffer
+void uploadThroughStagingRing(HelloTriangleApp& app, const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+    StagingRing& ring = app.stagingRing;
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+
+    while (size > 0) {
+        uint32_t half = ring.current;
+        vkWaitForFences(app.device, 1, &ring.fences[half], VK_TRUE, UINT64_MAX);
+        vkResetFences(app.device, 1, &ring.fences[half]);
+
+        VkDeviceSize chunkSize = std::min(size, STAGING_RING_HALF_SIZE);
+        std::memcpy(ring.mapped + half * STAGING_RING_HALF_SIZE, source, static_cast<size_t>(chunkSize));
+
+        VkCommandBuffer commandBuffer = ring.commandBuffers[half];
+        vkResetCommandBuffer(commandBuffer, 0);
+
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkBufferCopy copyRegion {};
+        copyRegion.srcOffset = half * STAGING_RING_HALF_SIZE;
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = chunkSize;
+        vkCmdCopyBuffer(commandBuffer, ring.buffer, dstBuffer, 1, &copyRegion);
+
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        if (vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, ring.fences[half]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit staging copy!");
+        }
+
+        source += chunkSize;
+        dstOffset += chunkSize;
+        size -= chunkSize;
+        ring.current ^= 1;
+    }
+}
+
+void flushStagingRing(HelloTriangleApp& app)
+{
+    vkWaitForFences(app.device, static_cast<uint32_t>(app.stagingRing.fences.size()), app.stagingRing.fences.data(), VK_TRUE, UINT64_MAX);
+}
+
+void createDeviceLocalBuffer(HelloTriangleApp& app, const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+    createBuffer(app, std::max(size, MIN_BUFFER_SIZE), usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+    uploadThroughStagingRing(app, data, size, buffer, 0);
+    flushStagingRing(app);
+}
+
+// scene data culling reads as well as the draws, written once at startup
+void createSceneStorageBuffer(HelloTriangleApp& app, const void* data, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+    createSharedBuffer(app, std::max(size, MIN_BUFFER_SIZE), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, app.sharedQueueFamilies,
+        buffer, bufferMemory);
+    uploadThroughStagingRing(app, data, size, buffer, 0);
+    flushStagingRing(app);
+}
+
+void createUploadRing(HelloTriangleApp& app)
+{
+    UploadRing& ring = app.uploadRing;
+    ring.frameSize = UPLOAD_RING_FRAME_SIZE;
+
+    // instances, staging copies and the indirect draws of the shadow passes
+    createBuffer(app, ring.frameSize * MAX_FRAMES_IN_FLIGHT,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        ring.buffer, ring.memory);
+
+    // the ring stays mapped for the lifetime of the app
+    void* mapped = nullptr;
+    auto result = vkMapMemory(app.device, ring.memory, 0, ring.frameSize * MAX_FRAMES_IN_FLIGHT, 0, &mapped);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to map upload ring!");
+    }
+    ring.mapped = static_cast<uint8_t*>(mapped);
+}
+
+void beginUploadRingFrame(HelloTriangleApp& app)
+{
+    app.uploadRing.frameBegin = app.currentFrame * app.uploadRing.frameSize;
+    app.uploadRing.head = 0;
+}
+
+[[nodiscard]] VkDeviceSize allocateFromUploadRing(HelloTriangleApp& app, VkDeviceSize size, VkDeviceSize alignment)
+{
+    UploadRing& ring = app.uploadRing;
+
+    VkDeviceSize offset = (ring.head + alignment - 1) / alignment * alignment;
+    if (offset + size > ring.frameSize) {
+        throw std::runtime_error("upload ring is out of space for this frame!");
+    }
+    ring.head = offset + size;
+
+    return ring.frameBegin + offset;
+}
+
+void createBindlessTable(HelloTriangleApp& app)
+{
+    const VkPhysicalDeviceVulkan12Properties& properties12 = getDeviceCapabilities(app, app.physicalDevice).properties12;
+
+    uint32_t textureCapacity = std::min({ MAX_BINDLESS_TEXTURES, properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+        properties12.maxPerStageDescriptorUpdateAfterBindSampledImages });
+    uint32_t bufferCapacity = std::min({ MAX_BINDLESS_BUFFERS, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+    app.bindlessTextureSlots = makeBindlessSlots(textureCapacity);
+    app.bindlessBufferSlots = makeBindlessSlots(bufferCapacity);
+
+    VkSamplerCreateInfo samplerInfo {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    auto result = vkCreateSampler(app.device, &samplerInfo, nullptr, &app.bindlessSampler);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+
+    // shadow maps are sampled with a depth comparison whose 2x2 results are
+    // filtered. everything outside the map is lit
+    VkSamplerCreateInfo shadowSamplerInfo {};
+    shadowSamplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    shadowSamplerInfo.magFilter = VK_FILTER_LINEAR;
+    shadowSamplerInfo.minFilter = VK_FILTER_LINEAR;
+    shadowSamplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    shadowSamplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    shadowSamplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    shadowSamplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    shadowSamplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    shadowSamplerInfo.compareEnable = VK_TRUE;
+    shadowSamplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    shadowSamplerInfo.minLod = 0.0f;
+    shadowSamplerInfo.maxLod = 0.0f;
+
+    result = vkCreateSampler(app.device, &shadowSamplerInfo, nullptr, &app.shadowSampler);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+
+    // textures, storage buffers and two immutable samplers. the arrays may
+    // have holes and are written while the set is in use, which is what the
+    // update after bind and partially bound flags allow
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[0].descriptorCount = textureCapacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = bufferCapacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[2].pImmutableSamplers = &app.bindlessSampler;
+    bindings[3].binding = 3;
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[3].descriptorCount = 1;
+    bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[3].pImmutableSamplers = &app.shadowSampler;
+
+    std::array<VkDescriptorBindingFlags, 4> bindingFlags = {
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+        0,
+        0,
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    result = vkCreateDescriptorSetLayout(app.device, &layoutInfo, nullptr, &app.bindlessSetLayout);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    poolSizes[0].descriptorCount = textureCapacity;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = bufferCapacity;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    poolSizes[2].descriptorCount = 2;
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+
+    result = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &app.bindlessDescriptorPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = app.bindlessDescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &app.bindlessSetLayout;
+
+    result = vkAllocateDescriptorSets(app.device, &allocInfo, &app.bindlessDescriptorSet);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+}
+
+[[nodiscard]] uint32_t registerBindlessTexture(HelloTriangleApp& app, VkImageView view)
+{
+    uint32_t slot = allocateBindlessSlot(app.bindlessTextureSlots);
+
+    VkDescriptorImageInfo imageInfo {};
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet descriptorWrite {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = app.bindlessDescriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(app.device, 1, &descriptorWrite, 0, nullptr);
+    return slot;
+}
+
+[[nodiscard]] uint32_t registerBindlessBuffer(HelloTriangleApp& app, VkBuffer buffer)
+{
+    uint32_t slot = allocateBindlessSlot(app.bindlessBufferSlots);
+
+    VkDescriptorBufferInfo bufferInfo { buffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet descriptorWrite {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = app.bindlessDescriptorSet;
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(app.device, 1, &descriptorWrite, 0, nullptr);
+    return slot;
+}
+
+// the descriptor stays valid until the frames in flight are done with it,
+// only then can the slot be handed out again
+void releaseBindlessTexture(HelloTriangleApp& app, uint32_t slot)
+{
+    releaseBindlessSlot(app.bindlessTextureSlots, slot, app.frameNumber);
+}
+
+void releaseBindlessBuffer(HelloTriangleApp& app, uint32_t slot)
+{
+    releaseBindlessSlot(app.bindlessBufferSlots, slot, app.frameNumber);
+}
+
+[[nodiscard]] std::vector<uint32_t> generateTextureMip(const TextureSource& source, uint32_t mip)
+{
+    uint32_t width = std::max(1u, source.width >> mip);
+    uint32_t height = std::max(1u, source.height >> mip);
+    uint32_t blockSize = 1 << mip;
+
+    // a texel of a mip covers blockSize texels of the top level. blocks no
+    // larger than a cell sit inside one, larger ones cover as much light as
+    // dark
+    uint32_t average = 0xff000000;
+    for (uint32_t shift = 0; shift < 24; shift += 8) {
+        average |= ((((source.light >> shift) & 0xff) + ((source.dark >> shift) & 0xff)) / 2) << shift;
+    }
+
+    std::vector<uint32_t> pixels(width * height, average);
+    if (blockSize <= source.cellSize) {
+        uint32_t cellSize = source.cellSize / blockSize;
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                bool even = ((x / cellSize) + (y / cellSize)) % 2 == 0;
+                pixels[y * width + x] = even ? source.light : source.dark;
+            }
+        }
+    }
+
+    return pixels;
+}
+
+[[nodiscard]] std::vector<TextureSource> makeBuiltinTextureSources()
+{
+    std::vector<TextureSource> sources;
+
+    std::mt19937 random(7);
+    std::uniform_int_distribution<uint32_t> channel(64, 255);
+
+    for (uint32_t i = 0; i < BUILTIN_TEXTURE_COUNT; i++) {
+        TextureSource source {};
+        source.width = BUILTIN_TEXTURE_SIZE;
+        source.height = BUILTIN_TEXTURE_SIZE;
+        source.light = 0xff000000 | channel(random) << 16 | channel(random) << 8 | channel(random);
+        source.dark = 0xff000000 | ((source.light >> 2) & 0x3f3f3f);
+        source.cellSize = 4u << (i % 4);
+        sources.push_back(source);
+    }
+
+    return sources;
+}
+
+[[nodiscard]] VkFormat getTextureVkFormat(TextureFormat format)
+{
+    switch (format) {
+    case TextureFormat::Bc1:
+        return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    case TextureFormat::Bc3:
+        return VK_FORMAT_BC3_SRGB_BLOCK;
+    case TextureFormat::Bc5:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case TextureFormat::Bc7:
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:
+        return VK_FORMAT_R8G8B8A8_SRGB;
+    }
+}
+
+// writes mips [firstMip, endMip) of source to dst and adds the copies into an
+// image whose level 0 is baseMip to regions
+[[nodiscard]] VkDeviceSize writeTextureMips(const HelloTriangleApp& app, const TextureSource& source, uint32_t baseMip, uint32_t firstMip, uint32_t endMip,
+    uint8_t* dst, VkDeviceSize bufferOffset, std::vector<VkBufferImageCopy>& regions)
+{
+    VkDeviceSize written = 0;
+    for (uint32_t mip = firstMip; mip < endMip; mip++) {
+        uint32_t width = std::max(1u, source.width >> mip);
+        uint32_t height = std::max(1u, source.height >> mip);
+        VkDeviceSize mipBytes = getTextureMipBytes(app.textureFormat, width, height);
+
+        if (source.cached != nullptr) {
+            std::memcpy(dst + written, app.textureCache.data + source.cached->mipOffsets[mip], static_cast<size_t>(mipBytes));
+        } else {
+            std::vector<uint32_t> pixels = generateTextureMip(source, mip);
+            std::memcpy(dst + written, pixels.data(), static_cast<size_t>(mipBytes));
+        }
+
+        VkBufferImageCopy region {};
+        region.bufferOffset = bufferOffset + written;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip - baseMip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { width, height, 1 };
+        regions.push_back(region);
+
+        written += mipBytes;
+    }
+    return written;
+}
+
+[[nodiscard]] uint64_t getTrackedHandle(VkImage image)
+{
+    return reinterpret_cast<uint64_t>(image);
+}
+
+[[nodiscard]] Texture createTextureImage(HelloTriangleApp& app, const TextureSource& source, uint32_t residentMip, uint32_t mipCount)
+{
+    Texture texture;
+    uint32_t width = std::max(1u, source.width >> residentMip);
+    uint32_t height = std::max(1u, source.height >> residentMip);
+    VkFormat format = getTextureVkFormat(app.textureFormat);
+
+    // the downsampler writes srgb levels through unorm views, srgb formats
+    // can't be storage images
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    VkImageCreateFlags flags = 0;
+    if (app.mipGeneration == MipGeneration::Compute && app.textureFormat == TextureFormat::Rgba8) {
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+    }
+
+    createImage(app, width, height, mipCount - residentMip, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, flags, texture.image, texture.memory);
+    texture.view = createImageView(app, texture.image, format, VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount - residentMip);
+    texture.bindlessIndex = registerBindlessTexture(app, texture.view);
+    trackImage(app.barrierTracker, getTrackedHandle(texture.image), mipCount - residentMip, VK_IMAGE_LAYOUT_UNDEFINED);
+    for (uint32_t mip = residentMip; mip < mipCount; mip++) {
+        texture.bytes += getTextureMipBytes(app.textureFormat, std::max(1u, source.width >> mip), std::max(1u, source.height >> mip));
+    }
+
+    return texture;
+}
+
+[[nodiscard]] VkImageMemoryBarrier makeTextureBarrier(VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    VkImageMemoryBarrier barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    return barrier;
+}
+
+[[nodiscard]] std::vector<VkImageMemoryBarrier> makeTrackedBarriers(const TrackedBatch& batch)
+{
+    std::vector<VkImageMemoryBarrier> barriers(batch.imageBarriers.size());
+    for (size_t i = 0; i < barriers.size(); i++) {
+        const TrackedImageBarrier& tracked = batch.imageBarriers[i];
+        barriers[i] = makeTextureBarrier(reinterpret_cast<VkImage>(tracked.image), static_cast<VkAccessFlags>(tracked.srcAccess), static_cast<VkAccessFlags>(tracked.dstAccess),
+            static_cast<VkImageLayout>(tracked.oldLayout), static_cast<VkImageLayout>(tracked.newLayout));
+        barriers[i].subresourceRange.baseMipLevel = tracked.baseMip;
+        barriers[i].subresourceRange.levelCount = tracked.mipCount;
+    }
+    return barriers;
+}
+
+void recordTrackedBatch(VkCommandBuffer commandBuffer, const TrackedBatch& batch)
+{
+    if (!batch.memoryBarrier && batch.imageBarriers.empty()) {
+        return;
+    }
+
+    VkMemoryBarrier memoryBarrier {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = static_cast<VkAccessFlags>(batch.memorySrcAccess);
+    memoryBarrier.dstAccessMask = static_cast<VkAccessFlags>(batch.memoryDstAccess);
+
+    // transitions out of UNDEFINED wait for nothing
+    VkPipelineStageFlags srcStages = static_cast<VkPipelineStageFlags>(batch.srcStages);
+    VkPipelineStageFlags dstStages = static_cast<VkPipelineStageFlags>(batch.dstStages);
+    std::vector<VkImageMemoryBarrier> imageBarriers = makeTrackedBarriers(batch);
+    vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+        batch.memoryBarrier ? 1 : 0, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+// everything the uses declared since the last call need, in one barrier
+void recordTrackedBarriers(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    recordTrackedBatch(commandBuffer, takePendingBarriers(app.barrierTracker));
+}
+
+// records the released transitions as a plain barrier, for command buffers
+// the host waits for right away
+void recordReleasedBarriers(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    recordTrackedBatch(commandBuffer, takeReleasedBarriers(app.barrierTracker));
+}
+
+// the first half of the split barrier handing this frame's new textures to
+// the fragment shader. the work recorded between it and waitTextureEvent
+// doesn't have to wait for the uploads
+void signalTextureEvent(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    TrackedBatch batch = takeReleasedBarriers(app.barrierTracker);
+    if (batch.imageBarriers.empty()) {
+        return;
+    }
+
+    vkCmdSetEvent(commandBuffer, app.textureEvents[app.currentFrame], static_cast<VkPipelineStageFlags>(batch.srcStages));
+    app.signaledTextureBarriers = std::move(batch);
+}
+
+void waitTextureEvent(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    const TrackedBatch& batch = app.signaledTextureBarriers;
+    if (batch.imageBarriers.empty()) {
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier> imageBarriers = makeTrackedBarriers(batch);
+    vkCmdWaitEvents(commandBuffer, 1, &app.textureEvents[app.currentFrame], static_cast<VkPipelineStageFlags>(batch.srcStages),
+        static_cast<VkPipelineStageFlags>(batch.dstStages), 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    app.signaledTextureBarriers = {};
+}
+
+void createDownsamplePipeline(HelloTriangleApp& app)
+{
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = MAX_DOWNSAMPLE_MIPS;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    auto result = vkCreateDescriptorSetLayout(app.device, &layoutInfo, nullptr, &app.downsampleSetLayout);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DownsamplePushConstants);
+
+    app.downsamplePipelineLayout = createPipelineLayout(app, { app.downsampleSetLayout }, { pushConstantRange });
+    app.downsamplePipeline = createComputePipeline(app, "shaders/downsample_comp.spv", app.downsamplePipelineLayout);
+
+    // level 0 is only read with texelFetch
+    VkSamplerCreateInfo samplerInfo {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    result = vkCreateSampler(app.device, &samplerInfo, nullptr, &app.downsampleSampler);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = MAX_DOWNSAMPLES_PER_FRAME;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = MAX_DOWNSAMPLES_PER_FRAME * MAX_DOWNSAMPLE_MIPS;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = MAX_DOWNSAMPLES_PER_FRAME;
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = MAX_DOWNSAMPLES_PER_FRAME;
+
+    app.downsampleDescriptorPools.resize(MAX_FRAMES_IN_FLIGHT);
+    app.downsampleViews.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        result = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &app.downsampleDescriptorPools[i]);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+    }
+
+    // one counter serves every dispatch, since the last group of each puts it
+    // back to 0 and dispatches are serialized by barriers
+    createBuffer(app, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        app.downsampleCounterBuffer, app.downsampleCounterBufferMemory);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+    vkCmdFillBuffer(commandBuffer, app.downsampleCounterBuffer, 0, VK_WHOLE_SIZE, 0);
+    endSingleTimeCommands(app, commandBuffer);
+}
+
+// the gpu is done with the frame's downsamples once its fence has signaled
+void resetDownsampleFrame(HelloTriangleApp& app)
+{
+    if (app.downsamplePipeline == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkResetDescriptorPool(app.device, app.downsampleDescriptorPools[app.currentFrame], 0);
+    for (auto view : app.downsampleViews[app.currentFrame]) {
+        vkDestroyImageView(app.device, view, nullptr);
+    }
+    app.downsampleViews[app.currentFrame].clear();
+}
+
+void recordBlitChain(HelloTriangleApp& app, VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+    uint64_t handle = getTrackedHandle(image);
+
+    for (uint32_t level = 1; level < levelCount; level++) {
+        // every level is the source of the next once it has been written
+        useImage(app.barrierTracker, handle, level - 1, 1, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false);
+        useImage(app.barrierTracker, handle, level, 1, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+        recordTrackedBarriers(app, commandBuffer);
+
+        VkImageBlit blit {};
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+        blit.srcOffsets[1] = { static_cast<int32_t>(std::max(1u, width >> (level - 1))), static_cast<int32_t>(std::max(1u, height >> (level - 1))), 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        blit.dstOffsets[1] = { static_cast<int32_t>(std::max(1u, width >> level)), static_cast<int32_t>(std::max(1u, height >> level)), 1 };
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+    }
+}
+
+void recordDownsample(HelloTriangleApp& app, VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = app.downsampleDescriptorPools[app.currentFrame];
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &app.downsampleSetLayout;
+
+    VkDescriptorSet descriptorSet;
+    auto result = vkAllocateDescriptorSets(app.device, &allocInfo, &descriptorSet);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    // the source view only covers level 0, the only level in GENERAL when
+    // the dispatch reads it
+    uint32_t mipCount = levelCount - 1;
+    std::vector<VkImageView>& levelViews = app.downsampleViews[app.currentFrame];
+    VkImageView sourceView = createImageView(app, image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+    levelViews.push_back(sourceView);
+    for (uint32_t level = 1; level < levelCount; level++) {
+        levelViews.push_back(createImageView(app, image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, level, 1));
+    }
+
+    // the shader never touches levels past mipCount, they repeat the last one
+    // so every array element is valid
+    VkDescriptorImageInfo sourceInfo {};
+    sourceInfo.sampler = app.downsampleSampler;
+    sourceInfo.imageView = sourceView;
+    sourceInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkDescriptorImageInfo, MAX_DOWNSAMPLE_MIPS> mipInfos {};
+    for (uint32_t i = 0; i < MAX_DOWNSAMPLE_MIPS; i++) {
+        mipInfos[i].imageView = levelViews[levelViews.size() - mipCount + std::min(i, mipCount - 1)];
+        mipInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    VkDescriptorBufferInfo counterInfo { app.downsampleCounterBuffer, 0, VK_WHOLE_SIZE };
+
+    std::array<VkWriteDescriptorSet, 3> descriptorWrites {};
+    for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+        descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[binding].dstSet = descriptorSet;
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].dstArrayElement = 0;
+        descriptorWrites[binding].descriptorCount = 1;
+    }
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[0].pImageInfo = &sourceInfo;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[1].descriptorCount = MAX_DOWNSAMPLE_MIPS;
+    descriptorWrites[1].pImageInfo = mipInfos.data();
+    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrites[2].pBufferInfo = &counterInfo;
+
+    vkUpdateDescriptorSets(app.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+    // the counter was last reset by the previous dispatch or the initial fill
+    uint64_t handle = getTrackedHandle(image);
+    useImage(app.barrierTracker, handle, 0, 1, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false);
+    useImage(app.barrierTracker, handle, 1, mipCount, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, true);
+    useMemory(app.barrierTracker, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    recordTrackedBarriers(app, commandBuffer);
+
+    DownsamplePushConstants constants {};
+    constants.mipCount = mipCount;
+    uint32_t groupsX = (width + 63) / 64;
+    uint32_t groupsY = (height + 63) / 64;
+    constants.workGroupCount = groupsX * groupsY;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.downsamplePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.downsamplePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, app.downsamplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+}
+
+// builds levels 1 to levelCount - 1 of an rgba8 image from level 0. the
+// image must be in the barrier tracker, its levels are left in transfer or
+// general layouts for the caller to move on from
+void recordMipGeneration(HelloTriangleApp& app, VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+    if (app.mipGeneration == MipGeneration::Compute) {
+        recordDownsample(app, commandBuffer, image, width, height, levelCount);
+    } else {
+        recordBlitChain(app, commandBuffer, image, width, height, levelCount);
+    }
+}
+
+// the cache stays mapped, streamed mips are copied straight out of it
+void loadTextureCache(HelloTriangleApp& app)
+{
+    app.textureCacheFile = mapFile(app.config.textureCachePath);
+    app.textureCache = viewTextureCache(app.textureCacheFile);
+    app.textureFormat = app.textureCache.format;
+
+    VkFormatProperties properties = getFormatProperties(app, app.physicalDevice, getTextureVkFormat(app.textureFormat));
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+        | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if ((properties.optimalTilingFeatures & required) != required) {
+        throw std::runtime_error(std::string("device can't sample ") + getTextureFormatName(app.textureFormat) + " textures, cook the cache in another format!");
+    }
+
+    for (uint32_t i = 0; i < app.textureCache.textureCount; i++) {
+        const TextureCacheTexture& cached = app.textureCache.textures[i];
+        if (cached.mipCount != getMipCount(cached.width, cached.height)) {
+            throw std::runtime_error("texture cache is missing mips!");
+        }
+
+        TextureSource source {};
+        source.width = cached.width;
+        source.height = cached.height;
+        source.cached = &cached;
+        app.textureSources.push_back(source);
+    }
+
+    if (app.textureSources.empty()) {
+        throw std::runtime_error("texture cache has no textures!");
+    }
+}
+
+// only the mip tails are read and uploaded here, so startup costs the same
+// whatever the size of the textures
+void createTextures(HelloTriangleApp& app)
+{
+    auto uploadStart = std::chrono::steady_clock::now();
+
+    if (app.config.textureCachePath.empty()) {
+        app.textureSources = makeBuiltinTextureSources();
+    } else {
+        loadTextureCache(app);
+    }
+
+    app.textureStreamer = makeTextureStreamer(app.config.textureBudget, UPLOAD_RING_FRAME_SIZE / 2,
+        getTextureBlockSize(app.textureFormat), getTextureBlockBytes(app.textureFormat));
+
+    for (const auto& source : app.textureSources) {
+        uint32_t index = addStreamedTexture(app.textureStreamer, source.width, source.height, TEXTURE_TAIL_SIZE);
+        const StreamedTexture& streamed = app.textureStreamer.textures[index];
+
+        VkDeviceSize tailBytes = 0;
+        for (uint32_t mip = streamed.residentMip; mip < streamed.mipCount; mip++) {
+            tailBytes += getMipBytes(app.textureStreamer, streamed, mip);
+        }
+
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(app, tailBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(app.device, stagingBufferMemory, 0, tailBytes, 0, &data);
+        std::vector<VkBufferImageCopy> regions;
+        (void)writeTextureMips(app, source, streamed.residentMip, streamed.residentMip, streamed.mipCount, static_cast<uint8_t*>(data), 0, regions);
+        vkUnmapMemory(app.device, stagingBufferMemory);
+
+        Texture texture = createTextureImage(app, source, streamed.residentMip, streamed.mipCount);
+
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+
+        uint64_t handle = getTrackedHandle(texture.image);
+        uint32_t levelCount = streamed.mipCount - streamed.residentMip;
+        useImage(app.barrierTracker, handle, 0, levelCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+        recordTrackedBarriers(app, commandBuffer);
+
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+        releaseImage(app.barrierTracker, handle, 0, levelCount, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        recordReleasedBarriers(app, commandBuffer);
+
+        endSingleTimeCommands(app, commandBuffer);
+
+        vkDestroyBuffer(app.device, stagingBuffer, nullptr);
+        vkFreeMemory(app.device, stagingBufferMemory, nullptr);
+
+        app.textures.push_back(texture);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - uploadStart).count();
+    std::cout << "uploaded " << app.textures.size() << " " << getTextureFormatName(app.textureFormat) << " texture mip tails, "
+              << app.textureStreamer.residentBytes / 1024 << " KB in " << seconds * 1000.0 << " ms" << std::endl;
+
+    app.textureTableBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.textureTableBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    app.textureTables.resize(MAX_FRAMES_IN_FLIGHT);
+    app.textureTableIndices.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        VkDeviceSize tableSize = app.textures.size() * sizeof(uint32_t);
+        createBuffer(app, tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            app.textureTableBuffers[i], app.textureTableBuffersMemory[i]);
+
+        void* mapped;
+        vkMapMemory(app.device, app.textureTableBuffersMemory[i], 0, tableSize, 0, &mapped);
+        app.textureTables[i] = static_cast<uint32_t*>(mapped);
+        app.textureTableIndices[i] = registerBindlessBuffer(app, app.textureTableBuffers[i]);
+    }
+}
+
+// where the levels of a texture after a residency change come from. with
+// gpu mip generation only the finest new mip is uploaded, the others are
+// built from it
+struct ResidencyUpload {
+    uint32_t loadedLevels;
+    uint32_t uploadEnd;
+    bool generateMips;
+};
+
+[[nodiscard]] bool isPowerOfTwo(uint32_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+[[nodiscard]] ResidencyUpload planResidencyUpload(const HelloTriangleApp& app, const StreamingChange& change)
+{
+    const TextureSource& source = app.textureSources[change.texture];
+    uint32_t baseWidth = std::max(1u, source.width >> change.residentMip);
+    uint32_t baseHeight = std::max(1u, source.height >> change.residentMip);
+
+    ResidencyUpload upload {};
+    upload.loadedLevels = change.oldResidentMip > change.residentMip ? change.oldResidentMip - change.residentMip : 0;
+    // the downsampler halves every level exactly, so it only takes power of
+    // two sizes, the others are uploaded in full
+    bool downsampleSize = std::max(baseWidth, baseHeight) <= MAX_DOWNSAMPLE_SIZE && isPowerOfTwo(baseWidth) && isPowerOfTwo(baseHeight);
+    upload.generateMips = app.mipGeneration != MipGeneration::Cpu && app.textureFormat == TextureFormat::Rgba8 && upload.loadedLevels > 1
+        && (app.mipGeneration == MipGeneration::Blit || downsampleSize);
+    upload.uploadEnd = upload.generateMips ? change.residentMip + 1 : change.oldResidentMip;
+    return upload;
+}
+
+// each of these takes one of the frame's MAX_DOWNSAMPLES_PER_FRAME descriptor
+// sets
+[[nodiscard]] bool usesDownsample(const HelloTriangleApp& app, const StreamingChange& change)
+{
+    return app.mipGeneration == MipGeneration::Compute && planResidencyUpload(app, change).generateMips;
+}
+
+// swaps in texture, created for the mips in change, and declares what the
+// copies into it do, the barriers of every change in the frame go out
+// together. uploaded is set when the transfer queue has already filled the
+// new mips. returns the old texture, which is retired but still read from
+[[nodiscard]] Texture beginTextureResidencyChange(HelloTriangleApp& app, const StreamingChange& change, const Texture& texture, bool uploaded)
+{
+    const StreamedTexture& streamed = app.textureStreamer.textures[change.texture];
+    Texture oldTexture = app.textures[change.texture];
+    ResidencyUpload upload = planResidencyUpload(app, change);
+
+    uint64_t handle = getTrackedHandle(texture.image);
+    if (!uploaded && upload.uploadEnd > change.residentMip) {
+        useImage(app.barrierTracker, handle, 0, upload.uploadEnd - change.residentMip, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+    }
+
+    // the frames still in flight only read the old texture, the tracker
+    // knows to wait for them before its layout changes
+    uint32_t firstCopied = std::max(change.residentMip, change.oldResidentMip);
+    useImage(app.barrierTracker, handle, firstCopied - change.residentMip, streamed.mipCount - firstCopied, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+    useImage(app.barrierTracker, getTrackedHandle(oldTexture.image), firstCopied - change.oldResidentMip, streamed.mipCount - firstCopied,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false);
+
+    releaseBindlessTexture(app, oldTexture.bindlessIndex);
+    app.retiredTextures.emplace_back(oldTexture, app.frameNumber);
+    app.textures[change.texture] = texture;
+    return oldTexture;
+}
+
+// fills the new texture, the mips both have in common are copied on the gpu
+// and only the new ones come from the source. the texture is released to
+// the fragment shader, whoever records the release decides when it waits
+void recordTextureResidencyChange(HelloTriangleApp& app, VkCommandBuffer commandBuffer, const StreamingChange& change, const Texture& oldTexture, bool uploaded)
+{
+    const TextureSource& source = app.textureSources[change.texture];
+    const StreamedTexture& streamed = app.textureStreamer.textures[change.texture];
+    const Texture& texture = app.textures[change.texture];
+    ResidencyUpload upload = planResidencyUpload(app, change);
+
+    if (upload.loadedLevels > 0 && !uploaded) {
+        VkDeviceSize bytes = 0;
+        for (uint32_t mip = change.residentMip; mip < upload.uploadEnd; mip++) {
+            bytes += getMipBytes(app.textureStreamer, streamed, mip);
+        }
+
+        // copies out of a buffer have to start on a block boundary
+        VkDeviceSize offset = allocateFromUploadRing(app, bytes, getTextureBlockBytes(app.textureFormat));
+        std::vector<VkBufferImageCopy> regions;
+        (void)writeTextureMips(app, source, change.residentMip, change.residentMip, upload.uploadEnd, app.uploadRing.mapped + offset, offset, regions);
+        vkCmdCopyBufferToImage(commandBuffer, app.uploadRing.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+    }
+
+    std::vector<VkImageCopy> copies;
+    for (uint32_t mip = std::max(change.residentMip, change.oldResidentMip); mip < streamed.mipCount; mip++) {
+        uint32_t width = std::max(1u, source.width >> mip);
+        uint32_t height = std::max(1u, source.height >> mip);
+
+        VkImageCopy copy {};
+        copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - change.oldResidentMip, 0, 1 };
+        copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - change.residentMip, 0, 1 };
+        copy.extent = { width, height, 1 };
+        copies.push_back(copy);
+    }
+    vkCmdCopyImage(commandBuffer, oldTexture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(copies.size()), copies.data());
+
+    if (upload.generateMips) {
+        uint32_t baseWidth = std::max(1u, source.width >> change.residentMip);
+        uint32_t baseHeight = std::max(1u, source.height >> change.residentMip);
+        recordMipGeneration(app, commandBuffer, texture.image, baseWidth, baseHeight, upload.loadedLevels);
+    }
+
+    releaseImage(app.barrierTracker, getTrackedHandle(texture.image), 0, streamed.mipCount - change.residentMip, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// asks for the mip whose texels come closest to one per pixel on each visible
+// object, assuming the texture is stretched over the bounding sphere
+void requestTextureMips(HelloTriangleApp& app, const Camera& camera)
+{
+    // the vectorized kernel the shadow casters go through, only the visible
+    // objects are looked at after it
+    app.visibleObjects.clear();
+    cullSpheres(extractFrustumPlanes(camera.viewProj), app.objectBounds, 0, app.objectBounds.size(), app.visibleObjects);
+    float pixelsPerUnit = app.renderExtent.height * 0.5f / std::tan(camera.verticalFov * 0.5f);
+
+    for (uint32_t index : app.visibleObjects) {
+        const ObjectData& object = app.objects[index];
+        float distance = std::max(glm::length(glm::vec3(object.boundingSphere) - camera.position) - object.boundingSphere.w, camera.nearPlane);
+        float screenSize = 2.0f * object.boundingSphere.w * pixelsPerUnit / distance;
+        const TextureSource& source = app.textureSources[object.textureIndex];
+        float texelsPerPixel = std::max(source.width, source.height) / std::max(screenSize, 1.0f);
+        uint32_t mip = static_cast<uint32_t>(std::max(0.0f, std::floor(std::log2(texelsPerPixel))));
+
+        requestTextureMip(app.textureStreamer, object.textureIndex, mip, app.frameNumber);
+    }
+}
+
+void reclaimUploads(HelloTriangleApp& app, uint64_t completedValue)
+{
+    TransferWorker& worker = app.transferWorker;
+    auto finished = std::stable_partition(worker.submitted.begin(), worker.submitted.end(),
+        [completedValue](const auto& upload) { return upload.timelineValue > completedValue; });
+    for (auto it = finished; it != worker.submitted.end(); ++it) {
+        vkFreeCommandBuffers(app.device, worker.commandPool, 1, &it->commandBuffer);
+        vkDestroyBuffer(app.device, it->stagingBuffer, nullptr);
+        vkFreeMemory(app.device, it->stagingBufferMemory, nullptr);
+    }
+    worker.submitted.erase(finished, worker.submitted.end());
+}
+
+// runs on the worker thread. the mips go through a staging buffer of their
+// own, the upload ring belongs to the frames
+[[nodiscard]] SubmittedUpload submitUpload(HelloTriangleApp& app, const UploadJob& job)
+{
+    TransferWorker& worker = app.transferWorker;
+    const TextureSource& source = app.textureSources[job.texture];
+
+    SubmittedUpload submitted {};
+    submitted.timelineValue = job.timelineValue;
+
+    VkDeviceSize bytes = 0;
+    for (uint32_t mip = job.residentMip; mip < job.uploadEnd; mip++) {
+        bytes += getTextureMipBytes(app.textureFormat, std::max(1u, source.width >> mip), std::max(1u, source.height >> mip));
+    }
+    createBuffer(app, bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        submitted.stagingBuffer, submitted.stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(app.device, submitted.stagingBufferMemory, 0, bytes, 0, &data);
+    std::vector<VkBufferImageCopy> regions;
+    (void)writeTextureMips(app, source, job.residentMip, job.residentMip, job.uploadEnd, static_cast<uint8_t*>(data), 0, regions);
+    vkUnmapMemory(app.device, submitted.stagingBufferMemory);
+
+    VkCommandBufferAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = worker.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(app.device, &allocInfo, &submitted.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(submitted.commandBuffer, &beginInfo);
+
+    VkImageMemoryBarrier barrier = makeTextureBarrier(job.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    barrier.subresourceRange.levelCount = job.uploadEnd - job.residentMip;
+    vkCmdPipelineBarrier(submitted.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdCopyBufferToImage(submitted.commandBuffer, submitted.stagingBuffer, job.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()),
+        regions.data());
+
+    // the release half of the ownership transfer, acquireFinishedUploads
+    // records the acquire on the graphics queue
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = app.transferFamily;
+    barrier.dstQueueFamilyIndex = app.graphicsFamily;
+    vkCmdPipelineBarrier(submitted.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    if (vkEndCommandBuffer(submitted.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &submitted.timelineValue;
+
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &submitted.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &worker.timeline;
+    if (vkQueueSubmit(app.transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit texture upload!");
+    }
+    return submitted;
+}
+
+// jobs are submitted in the order they were queued, so the timeline values
+// they signal only go up
+void runTransferWorker(HelloTriangleApp& app)
+{
+    TransferWorker& worker = app.transferWorker;
+    while (true) {
+        UploadJob job {};
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            auto ready = [&worker] { return worker.stopping || !worker.jobs.empty(); };
+            // with uploads in flight it looks in now and then to free their
+            // staging buffers
+            if (worker.submitted.empty()) {
+                worker.wake.wait(lock, ready);
+            } else {
+                worker.wake.wait_for(lock, std::chrono::milliseconds(4), ready);
+            }
+            if (worker.stopping) {
+                break;
+            }
+            if (!worker.jobs.empty()) {
+                job = worker.jobs.front();
+                worker.jobs.pop_front();
+            }
+        }
+
+        if (job.timelineValue != 0) {
+            worker.submitted.push_back(submitUpload(app, job));
+        }
+        uint64_t completedValue = 0;
+        vkGetSemaphoreCounterValue(app.device, worker.timeline, &completedValue);
+        reclaimUploads(app, completedValue);
+    }
+
+    // jobs still queued are dropped, their textures are destroyed with the
+    // pending uploads
+    vkQueueWaitIdle(app.transferQueue);
+    reclaimUploads(app, UINT64_MAX);
+}
+
+void startTransferWorker(HelloTriangleApp& app)
+{
+    TransferWorker& worker = app.transferWorker;
+
+    VkCommandPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = app.transferFamily;
+    if (vkCreateCommandPool(app.device, &poolInfo, nullptr, &worker.commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &worker.timeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload timeline semaphore!");
+    }
+
+    worker.thread = std::thread([&app] { runTransferWorker(app); });
+}
+
+// has to happen before anything waits for the whole device, the worker may
+// be submitting to the transfer queue
+void stopTransferWorker(HelloTriangleApp& app)
+{
+    TransferWorker& worker = app.transferWorker;
+    if (!worker.thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.stopping = true;
+    }
+    worker.wake.notify_one();
+    worker.thread.join();
+}
+
+[[nodiscard]] bool hasPendingUpload(const HelloTriangleApp& app, uint32_t texture)
+{
+    return std::any_of(app.pendingUploads.begin(), app.pendingUploads.end(),
+        [texture](const TextureUpload& upload) { return upload.change.texture == texture; });
+}
+
+// creates the texture for change and hands its new mips to the transfer
+// worker, the texture is swapped in once they have arrived
+void queueTextureUpload(HelloTriangleApp& app, const StreamingChange& change)
+{
+    const StreamedTexture& streamed = app.textureStreamer.textures[change.texture];
+
+    TextureUpload upload {};
+    upload.change = change;
+    upload.texture = createTextureImage(app, app.textureSources[change.texture], change.residentMip, streamed.mipCount);
+    upload.timelineValue = ++app.lastUploadValue;
+
+    UploadJob job {};
+    job.timelineValue = upload.timelineValue;
+    job.texture = change.texture;
+    job.image = upload.texture.image;
+    job.residentMip = change.residentMip;
+    job.uploadEnd = planResidencyUpload(app, change).uploadEnd;
+
+    {
+        std::lock_guard<std::mutex> lock(app.transferWorker.mutex);
+        app.transferWorker.jobs.push_back(job);
+    }
+    app.transferWorker.wake.notify_one();
+    app.pendingUploads.push_back(upload);
+}
+
+// the acquire half of the ownership transfer for every upload the transfer
+// queue has finished, as far as the frame's downsamples go. the rest stay
+// pending for the next frame. the frame's submit waits for the timeline to
+// reach the last of them, which it already has, so the wait never stalls
+[[nodiscard]] std::vector<TextureUpload> acquireFinishedUploads(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    uint64_t completedValue = 0;
+    vkGetSemaphoreCounterValue(app.device, app.transferWorker.timeline, &completedValue);
+
+    uint32_t downsamples = 0;
+    auto firstPending = std::find_if(app.pendingUploads.begin(), app.pendingUploads.end(), [&](const TextureUpload& upload) {
+        if (upload.timelineValue > completedValue) {
+            return true;
+        }
+        if (usesDownsample(app, upload.change)) {
+            if (downsamples == MAX_DOWNSAMPLES_PER_FRAME) {
+                return true;
+            }
+            downsamples++;
+        }
+        return false;
+    });
+    std::vector<TextureUpload> finished(app.pendingUploads.begin(), firstPending);
+    app.pendingUploads.erase(app.pendingUploads.begin(), firstPending);
+    if (finished.empty()) {
+        return finished;
+    }
+
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (const auto& upload : finished) {
+        uint32_t levelCount = planResidencyUpload(app, upload.change).uploadEnd - upload.change.residentMip;
+
+        VkImageMemoryBarrier barrier = makeTextureBarrier(upload.texture.image, 0, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        barrier.srcQueueFamilyIndex = app.transferFamily;
+        barrier.dstQueueFamilyIndex = app.graphicsFamily;
+        barrier.subresourceRange.levelCount = levelCount;
+        barriers.push_back(barrier);
+
+        acquireImage(app.barrierTracker, getTrackedHandle(upload.texture.image), 0, levelCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        app.uploadWaitValue = upload.timelineValue;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+    return finished;
+}
+
+void recordTextureStreaming(HelloTriangleApp& app, VkCommandBuffer commandBuffer, const Camera& camera)
+{
+    requestTextureMips(app, camera);
+    std::vector<StreamingChange> changes = std::move(app.deferredChanges);
+    app.deferredChanges.clear();
+
+    // the resident bytes already count what pending uploads and waiting
+    // changes turn each texture into, the images they replace are extra. so
+    // are the retired ones until the frames reading them finish
+    uint64_t inFlightBytes = 0;
+    for (const auto& retired : app.retiredTextures) {
+        inFlightBytes += retired.first.bytes;
+    }
+    for (const auto& upload : app.pendingUploads) {
+        inFlightBytes += app.textures[upload.change.texture].bytes;
+    }
+    for (const auto& change : changes) {
+        inFlightBytes += app.textures[change.texture].bytes;
+    }
+    app.textureStreamer.inFlightBytes = inFlightBytes;
+    std::vector<StreamingChange> newChanges = updateTextureStreaming(app.textureStreamer, app.frameNumber);
+    changes.insert(changes.end(), newChanges.begin(), newChanges.end());
+
+    app.uploadWaitValue = 0;
+    std::vector<TextureUpload> uploads;
+    if (app.transferUploads) {
+        uploads = acquireFinishedUploads(app, commandBuffer);
+    }
+
+    // every change starts from the texture the one before it left, so a
+    // texture changes at most once a frame and not while an upload for it is
+    // pending, later changes wait their turn
+    // the same goes for changes past the frame's downsample descriptor sets
+    std::vector<bool> changed(app.textures.size(), false);
+    std::vector<StreamingChange> recorded;
+    std::vector<bool> uploaded;
+    std::vector<Texture> oldTextures;
+    uint32_t downsamples = 0;
+    for (const auto& upload : uploads) {
+        oldTextures.push_back(beginTextureResidencyChange(app, upload.change, upload.texture, true));
+        recorded.push_back(upload.change);
+        uploaded.push_back(true);
+        changed[upload.change.texture] = true;
+        downsamples += usesDownsample(app, upload.change) ? 1 : 0;
+    }
+    for (const auto& change : changes) {
+        if (changed[change.texture] || hasPendingUpload(app, change.texture)) {
+            app.deferredChanges.push_back(change);
+            continue;
+        }
+
+        if (app.transferUploads && planResidencyUpload(app, change).loadedLevels > 0) {
+            changed[change.texture] = true;
+            queueTextureUpload(app, change);
+            continue;
+        }
+
+        if (usesDownsample(app, change)) {
+            if (downsamples == MAX_DOWNSAMPLES_PER_FRAME) {
+                app.deferredChanges.push_back(change);
+                continue;
+            }
+            downsamples++;
+        }
+        changed[change.texture] = true;
+
+        const StreamedTexture& streamed = app.textureStreamer.textures[change.texture];
+        Texture texture = createTextureImage(app, app.textureSources[change.texture], change.residentMip, streamed.mipCount);
+        oldTextures.push_back(beginTextureResidencyChange(app, change, texture, false));
+        recorded.push_back(change);
+        uploaded.push_back(false);
+    }
+    recordTrackedBarriers(app, commandBuffer);
+
+    for (size_t i = 0; i < recorded.size(); i++) {
+        recordTextureResidencyChange(app, commandBuffer, recorded[i], oldTextures[i], uploaded[i]);
+    }
+    signalTextureEvent(app, commandBuffer);
+
+    // the fence of this frame has signaled, so its table is free to rewrite
+    uint32_t* table = app.textureTables[app.currentFrame];
+    for (size_t i = 0; i < app.textures.size(); i++) {
+        table[i] = app.textures[i].bindlessIndex;
+    }
+}
+
+void destroyTexture(HelloTriangleApp& app, const Texture& texture)
+{
+    forgetImage(app.barrierTracker, getTrackedHandle(texture.image));
+    vkDestroyImageView(app.device, texture.view, nullptr);
+    vkDestroyImage(app.device, texture.image, nullptr);
+    vkFreeMemory(app.device, texture.memory, nullptr);
+}
+
+[[nodiscard]] float getSceneSize(const HelloTriangleApp& app)
+{
+    // keeps the object density roughly constant whatever the object count
+    return 4.0f * std::cbrt(static_cast<float>(app.config.objectCount));
+}
+
+[[nodiscard]] Camera computeCamera(const HelloTriangleApp& app)
+{
+    float aspect = app.swapChainExtent.width / static_cast<float>(app.swapChainExtent.height);
+
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        // orbit through the scene so that a good part of it is always behind
+        // the camera or outside the frustum
+        float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - app.startTime).count();
+        float sceneSize = getSceneSize(app);
+        float orbitRadius = sceneSize * 0.35f;
+
+        glm::vec3 eye(std::cos(time * 0.1f) * orbitRadius, sceneSize * 0.1f, std::sin(time * 0.1f) * orbitRadius);
+        float fov = glm::radians(60.0f);
+        float nearPlane = 0.1f;
+        glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        float farPlane = sceneSize * 2.0f;
+        glm::mat4 proj = glm::perspective(fov, aspect, nearPlane, farPlane);
+        proj[1][1] *= -1;
+
+        return { proj * view, proj, eye, fov, nearPlane, view, farPlane };
+    }
+
+    // instances are laid out on a square grid in the xy plane, back the camera
+    // off far enough to see all of it
+    uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(app.config.instanceCount))));
+    float fov = glm::radians(45.0f);
+    float distance = std::max(1.5f, gridSize * 0.6f / std::tan(fov * 0.5f));
+
+    glm::vec3 eye(0.0f, 0.0f, distance);
+    float nearPlane = 0.1f;
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    float farPlane = distance * 2.0f;
+    glm::mat4 proj = glm::perspective(fov, aspect, nearPlane, farPlane);
+
+    // glm was made for opengl, where clip space y points up
+    proj[1][1] *= -1;
+
+    return { proj * view, proj, eye, fov, nearPlane, view, farPlane };
+}
+
+[[nodiscard]] glm::vec3 getInstancePosition(uint32_t index, uint32_t count)
+{
+    uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+    float spacing = 1.2f;
+    float origin = (gridSize - 1) * spacing * 0.5f;
+
+    return glm::vec3((index % gridSize) * spacing - origin, (index / gridSize) * spacing - origin, 0.0f);
+}
+
+void createInstanceBounds(HelloTriangleApp& app)
+{
+    // instances only spin around their center, so the bounds never change.
+    // 0.71 covers the triangle at any rotation
+    for (uint32_t i = 0; i < app.config.instanceCount; i++) {
+        app.instanceBounds.add(glm::vec4(getInstancePosition(i, app.config.instanceCount), 0.71f));
+    }
+}
+
+void updateInstances(HelloTriangleApp& app)
+{
+    uint32_t count = app.config.instanceCount;
+
+    app.visibleInstances.clear();
+    cullSpheres(extractFrustumPlanes(computeCamera(app).viewProj), app.instanceBounds, 0, count, app.visibleInstances);
+
+    uint32_t visibleCount = static_cast<uint32_t>(app.visibleInstances.size());
+    app.instanceOffset = allocateFromUploadRing(app, visibleCount * sizeof(InstanceData), alignof(InstanceData));
+
+    float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - app.startTime).count();
+
+    // written straight into mapped memory, which may be write combined, so the
+    // instances are filled front to back and never read back
+    InstanceData* instances = reinterpret_cast<InstanceData*>(app.uploadRing.mapped + app.instanceOffset);
+    for (uint32_t v = 0; v < visibleCount; v++) {
+        uint32_t i = app.visibleInstances[v];
+        float angle = count == 1 ? 0.0f : time + i * 0.1f;
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), getInstancePosition(i, count));
+        instances[v].model = glm::rotate(model, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+
+        if (count == 1) {
+            instances[v].color = glm::vec4(1.0f);
+        } else {
+            uint32_t hash = i * 2654435761u;
+            instances[v].color = glm::vec4(
+                0.5f + 0.5f * ((hash >> 8) & 0xff) / 255.0f,
+                0.5f + 0.5f * ((hash >> 16) & 0xff) / 255.0f,
+                0.5f + 0.5f * ((hash >> 24) & 0xff) / 255.0f,
+                1.0f);
+        }
+    }
+}
+
+[[nodiscard]] std::vector<MeshData> makeBuiltinMeshes()
+{
+    std::vector<MeshData> meshes;
+    meshes.push_back(makeCubeMesh());
+    meshes.push_back(makeIcosphereMesh(4));
+    return meshes;
+}
+
+void createScene(HelloTriangleApp& app)
+{
+    // every mesh lives in one shared vertex and index buffer, so a single
+    // bind covers every draw the culling pass emits. lods only differ in their
+    // indices, so they all reference the same vertices
+    SceneGeometry builtinGeometry;
+    MappedFile meshCache;
+    SceneGeometryView geometry;
+
+    auto loadStart = std::chrono::steady_clock::now();
+    if (app.config.meshCachePath.empty()) {
+        builtinGeometry = buildSceneGeometry(makeBuiltinMeshes(), app.config.vertexFormat);
+        geometry = viewSceneGeometry(builtinGeometry);
+    } else {
+        try {
+            meshCache = mapFile(app.config.meshCachePath);
+            geometry = viewMeshCache(meshCache);
+        } catch (const std::runtime_error& error) {
+            // a missing, stale or damaged cache is rebuilt from the obj files
+            // it came from when they were given, and rewritten for next time
+            unmapFile(meshCache);
+            if (app.config.meshSources.empty()) {
+                throw;
+            }
+            std::cout << error.what() << " rebuilding it from " << app.config.meshSources.size() << " obj files" << std::endl;
+
+            std::vector<MeshData> meshes;
+            for (const auto& source : app.config.meshSources) {
+                meshes.push_back(loadObjMesh(source));
+            }
+            builtinGeometry = buildSceneGeometry(meshes, app.config.vertexFormat);
+            writeMeshCache(app.config.meshCachePath, builtinGeometry);
+            geometry = viewSceneGeometry(builtinGeometry);
+        }
+    }
+
+    if (geometry.meshCount == 0) {
+        throw std::runtime_error("scene has no meshes!");
+    }
+    app.vertexFormat = geometry.vertexFormat;
+
+    std::mt19937 random(1337);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float sceneSize = getSceneSize(app);
+
+    app.objects.resize(app.config.objectCount);
+    for (auto& object : app.objects) {
+        glm::vec3 position = (glm::vec3(unit(random), unit(random), unit(random)) - 0.5f) * sceneSize;
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + 0.01f);
+        float angle = unit(random) * glm::radians(360.0f);
+        float scale = 0.5f + unit(random);
+
+        object.meshIndex = static_cast<uint32_t>(random() % geometry.meshCount);
+        object.textureIndex = static_cast<uint32_t>(random() % app.textures.size());
+        object.model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), position), angle, axis), glm::vec3(scale));
+        object.color = glm::vec4(0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random), 1.0f);
+
+        glm::vec4 bounds = geometry.meshes[object.meshIndex].boundingSphere;
+        object.boundingSphere = glm::vec4(glm::vec3(object.model * glm::vec4(glm::vec3(bounds), 1.0f)), bounds.w * scale);
+        app.objectBounds.add(object.boundingSphere);
+    }
+
+    app.shadowMeshDraws.resize(geometry.meshCount);
+    for (uint32_t i = 0; i < geometry.meshCount; i++) {
+        const MeshCacheMesh& mesh = geometry.meshes[i];
+        app.shadowMeshDraws[i] = { mesh.lods[0].indexCount, 1, mesh.lods[0].firstIndex, mesh.vertexOffset, 0 };
+    }
+
+    // with a mesh cache these read straight out of the mapped file, pages are
+    // faulted in as the staging ring copies them
+    VkDeviceSize vertexBytes = geometry.vertexCount * getVertexStride(geometry.vertexFormat);
+    VkDeviceSize indexBytes = geometry.indexCount * sizeof(uint32_t);
+    createDeviceLocalBuffer(app, geometry.vertexData, vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, app.vertexBuffer, app.vertexBufferMemory);
+    createDeviceLocalBuffer(app, geometry.indices, indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, app.indexBuffer, app.indexBufferMemory);
+    createSceneStorageBuffer(app, geometry.meshes, geometry.meshCount * sizeof(MeshCacheMesh), app.meshInfoBuffer, app.meshInfoBufferMemory);
+    createSceneStorageBuffer(app, geometry.meshlets, geometry.meshletCount * sizeof(MeshCacheMeshlet), app.meshletBuffer, app.meshletBufferMemory);
+    createSceneStorageBuffer(app, app.objects.data(), app.objects.size() * sizeof(ObjectData), app.objectBuffer, app.objectBufferMemory);
+    app.objectBufferIndex = registerBindlessBuffer(app, app.objectBuffer);
+    app.meshInfoBufferIndex = registerBindlessBuffer(app, app.meshInfoBuffer);
+
+    if (!app.config.meshCachePath.empty()) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        double megabytes = (vertexBytes + indexBytes) / (1024.0 * 1024.0);
+        std::cout << "loaded " << app.config.meshCachePath << ": " << geometry.meshCount << " meshes, " << megabytes << " MB in "
+                  << seconds * 1000.0 << " ms (" << megabytes / seconds << " MB/s)" << std::endl;
+        unmapFile(meshCache);
+    }
+
+    uint64_t drawCapacity = app.config.objectCount;
+    if (app.config.clusterCulling) {
+        uint32_t maxMeshlets = 0;
+        for (uint32_t i = 0; i < geometry.meshCount; i++) {
+            maxMeshlets = std::max(maxMeshlets, geometry.meshes[i].meshletCount);
+        }
+        drawCapacity = std::min<uint64_t>(drawCapacity * maxMeshlets, MAX_CLUSTER_DRAWS);
+    }
+    app.drawCapacity = static_cast<uint32_t>(drawCapacity);
+
+    app.maxDrawCount = std::min(app.drawCapacity, app.deviceProfile.maxDrawIndirectCount);
+
+    // the culling pass rewrites these every frame, so each frame in flight
+    // needs its own copy
+    app.drawCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.drawCommandBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    app.drawCountBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.drawCountBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(app, std::max<VkDeviceSize>(app.drawCapacity * sizeof(VkDrawIndexedIndirectCommand), MIN_BUFFER_SIZE),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, app.drawCommandBuffers[i], app.drawCommandBuffersMemory[i]);
+        createBuffer(app, sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, app.drawCountBuffers[i], app.drawCountBuffersMemory[i]);
+    }
+
+    // nothing counts as visible at first, so the very first late phase draws
+    // everything that survives the frustum test
+    std::vector<uint32_t> visibility(app.objects.size(), 0);
+    app.visibilityBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.visibilityBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createDeviceLocalBuffer(app, visibility.data(), visibility.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            app.visibilityBuffers[i], app.visibilityBuffersMemory[i]);
+    }
+}
+
+// the light buffers are rewritten every frame but read by every pixel, so
+// they live on the gpu and are filled through the upload ring. the cluster
+// buffers stay on the gpu that fills them
+void createLights(HelloTriangleApp& app)
+{
+    app.sceneLights = makeSceneLights(app.config.lightCount, getSceneSize(app), 7331);
+
+    // the header is a multiple of 16 bytes, so the lights keep their vec4
+    // alignment
+    app.lightBufferSize = sizeof(LightBufferHeader) + app.sceneLights.size() * sizeof(LightData);
+    app.lightBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.lightBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    app.lightBufferIndices.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(app, app.lightBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            app.lightBuffers[i], app.lightBuffersMemory[i]);
+        app.lightBufferIndices[i] = registerBindlessBuffer(app, app.lightBuffers[i]);
+    }
+
+    if (!usesLightClusters(app.config)) {
+        return;
+    }
+
+    app.clusterBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.clusterBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    app.clusterBufferIndices.resize(MAX_FRAMES_IN_FLIGHT);
+    app.lightIndexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.lightIndexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    app.lightIndexBufferIndices.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(app, CLUSTER_COUNT * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            app.clusterBuffers[i], app.clusterBuffersMemory[i]);
+        createBuffer(app, CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            app.lightIndexBuffers[i], app.lightIndexBuffersMemory[i]);
+        app.clusterBufferIndices[i] = registerBindlessBuffer(app, app.clusterBuffers[i]);
+        app.lightIndexBufferIndices[i] = registerBindlessBuffer(app, app.lightIndexBuffers[i]);
+    }
+
+    // a couple of atomics per overflowing cluster, the cpu reads them where
+    // they are
+    app.lightOverflowBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    app.lightOverflowBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    app.mappedLightOverflows.resize(MAX_FRAMES_IN_FLIGHT);
+    app.lightOverflowBufferIndices.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(app, sizeof(LightOverflow), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            app.lightOverflowBuffers[i], app.lightOverflowBuffersMemory[i]);
+
+        void* mapped;
+        auto result = vkMapMemory(app.device, app.lightOverflowBuffersMemory[i], 0, sizeof(LightOverflow), 0, &mapped);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to map light overflow buffer!");
+        }
+        app.mappedLightOverflows[i] = static_cast<LightOverflow*>(mapped);
+        *app.mappedLightOverflows[i] = {};
+        app.lightOverflowBufferIndices[i] = registerBindlessBuffer(app, app.lightOverflowBuffers[i]);
+    }
+
+    createLightCullPipeline(app);
+}
+
+// stages the frame's lights in the upload ring, the light upload pass copies
+// them into the light buffer. the header also carries the sun and the
+// cascades updateShadowCascades made for this frame
+void updateLights(HelloTriangleApp& app, const glm::vec3& sunDirection)
+{
+    float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - app.startTime).count();
+
+    LightBufferHeader header {};
+    header.lightCount = static_cast<uint32_t>(app.sceneLights.size());
+    header.shadowMap = app.shadows ? app.shadowSampledIndex : NO_SHADOWS;
+    header.sunDirection = glm::vec4(sunDirection, 0.0f);
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        header.cascadeSplits[i] = app.cascadeSplits[i];
+        header.cascadeTexelSizes[i] = app.shadowCascades[i].texelSize;
+        header.cascadeViewProj[i] = app.shadowCascades[i].viewProj;
+    }
+
+    app.lightUploadOffset = allocateFromUploadRing(app, app.lightBufferSize, alignof(LightBufferHeader));
+    uint8_t* mapped = app.uploadRing.mapped + app.lightUploadOffset;
+    std::memcpy(mapped, &header, sizeof(header));
+    animateLights(app.sceneLights, time, reinterpret_cast<LightData*>(mapped + sizeof(LightBufferHeader)));
+}
+
+void recordLightUpload(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    VkBufferCopy copy {};
+    copy.srcOffset = app.lightUploadOffset;
+    copy.dstOffset = 0;
+    copy.size = app.lightBufferSize;
+    vkCmdCopyBuffer(commandBuffer, app.uploadRing.buffer, app.lightBuffers[app.currentFrame], 1, &copy);
+}
+
+// the frame that last used this slot is done, so its counts are final
+void readLightOverflow(HelloTriangleApp& app)
+{
+    if (app.mappedLightOverflows.empty() || app.frameNumber < MAX_FRAMES_IN_FLIGHT) {
+        return;
+    }
+
+    LightOverflow& overflow = *app.mappedLightOverflows[app.currentFrame];
+    if (overflow.clusters > 0) {
+        app.lightOverflowFrames++;
+        app.overflowClusterTotal += overflow.clusters;
+        app.droppedLightTotal += overflow.droppedLights;
+    }
+    app.lightCullFrames++;
+    overflow = {};
+}
+
+[[nodiscard]] VkRenderPass createShadowRenderPass(HelloTriangleApp& app, VkAttachmentLoadOp loadOp)
+{
+    VkAttachmentDescription depthAttachment {};
+    depthAttachment.format = app.shadowFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = loadOp;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // the frame graph moves the layers in and out of the attachment layout
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef {};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    VkRenderPass renderPass;
+    auto result = vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &renderPass);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+
+    return renderPass;
+}
+
+[[nodiscard]] VkImageView createShadowView(HelloTriangleApp& app, VkImage image, VkImageViewType viewType, uint32_t baseLayer, uint32_t layerCount)
+{
+    VkImageViewCreateInfo viewInfo {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = viewType;
+    viewInfo.format = app.shadowFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = baseLayer;
+    viewInfo.subresourceRange.layerCount = layerCount;
+
+    VkImageView imageView;
+    auto result = vkCreateImageView(app.device, &viewInfo, nullptr, &imageView);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image view!");
+    }
+
+    return imageView;
+}
+
+// one layer per cascade, each with a view and a framebuffer to draw it on
+// its own
+void createShadowImage(HelloTriangleApp& app, VkImageUsageFlags usage, VkImage& image, VkDeviceMemory& imageMemory, std::vector<VkImageView>& layerViews,
+    std::vector<VkFramebuffer>& framebuffers)
+{
+    VkImageCreateInfo imageInfo {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = SHADOW_MAP_SIZE;
+    imageInfo.extent.height = SHADOW_MAP_SIZE;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = SHADOW_CASCADE_COUNT;
+    imageInfo.format = app.shadowFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    auto result = vkCreateImage(app.device, &imageInfo, nullptr, &image);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(app.device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(app, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    result = vkAllocateMemory(app.device, &allocInfo, nullptr, &imageMemory);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate image memory!");
+    }
+    vkBindImageMemory(app.device, image, imageMemory, 0);
+
+    layerViews.resize(SHADOW_CASCADE_COUNT);
+    framebuffers.resize(SHADOW_CASCADE_COUNT);
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        layerViews[i] = createShadowView(app, image, VK_IMAGE_VIEW_TYPE_2D, i, 1);
+
+        VkFramebufferCreateInfo framebufferInfo {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = app.shadowClearRenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &layerViews[i];
+        framebufferInfo.width = SHADOW_MAP_SIZE;
+        framebufferInfo.height = SHADOW_MAP_SIZE;
+        framebufferInfo.layers = 1;
+
+        result = vkCreateFramebuffer(app.device, &framebufferInfo, nullptr, &framebuffers[i]);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create framebuffer!");
+        }
+    }
+}
+
+// position only, depth biased against acne. no culling, the casters aren't
+// all closed meshes
+void createShadowPipeline(HelloTriangleApp& app)
+{
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ShadowPushConstants);
+
+    app.shadowPipelineLayout = createPipelineLayout(app, { app.bindlessSetLayout }, { pushConstantRange });
+
+    bool packed = app.vertexFormat == VertexFormat::Packed;
+    auto bindingDescription = getVertexBindingDescription(app.vertexFormat);
+    auto attributeDescriptions = packed ? getPackedVertexAttributeDescriptions() : getVertexAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1;
+    vertexInputInfo.pVertexAttributeDescriptions = &attributeDescriptions[0];
+
+    VkShaderModule vertShaderModule = createShaderModule(app, readFile(packed ? "shaders/shadow_packed_vert.spv" : "shaders/shadow_vert.spv"));
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo {};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_TRUE;
+    rasterizer.depthBiasConstantFactor = 2.0f;
+    rasterizer.depthBiasClamp = 0.0f;
+    rasterizer.depthBiasSlopeFactor = 2.5f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading = 1.0f;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 0;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertShaderStageInfo;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = app.shadowPipelineLayout;
+    // the load variant is compatible, it only differs in the load op
+    pipelineInfo.renderPass = app.shadowClearRenderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    auto result = vkCreateGraphicsPipelines(app.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &app.shadowPipeline);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    vkDestroyShaderModule(app.device, vertShaderModule, nullptr);
+}
+
+// without dynamic casters the scene samples the cache directly. with them,
+// every frame copies the cache into the shadow map and draws the dynamic
+// casters on top
+void createShadowResources(HelloTriangleApp& app)
+{
+    uint32_t objectCount = static_cast<uint32_t>(app.objects.size());
+    app.staticCasterCount = objectCount - std::min(app.config.dynamicCasterCount, objectCount);
+    bool dynamicCasters = app.staticCasterCount < objectCount;
+
+    // the cascades reach back to everything around the origin
+    float sceneRadius = 0.0f;
+    for (const auto& object : app.objects) {
+        sceneRadius = std::max(sceneRadius, glm::length(glm::vec3(object.boundingSphere)) + object.boundingSphere.w);
+    }
+    app.sceneSphere = glm::vec4(0.0f, 0.0f, 0.0f, sceneRadius);
+
+    app.shadowClearRenderPass = createShadowRenderPass(app, VK_ATTACHMENT_LOAD_OP_CLEAR);
+    app.shadowLoadRenderPass = createShadowRenderPass(app, VK_ATTACHMENT_LOAD_OP_LOAD);
+
+    VkImageUsageFlags cacheUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (dynamicCasters ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : VK_IMAGE_USAGE_SAMPLED_BIT);
+    createShadowImage(app, cacheUsage, app.shadowCacheImage, app.shadowCacheImageMemory, app.shadowCacheLayerViews, app.shadowCacheFramebuffers);
+
+    VkImage sampledImage = app.shadowCacheImage;
+    if (dynamicCasters) {
+        createShadowImage(app, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            app.shadowMapImage, app.shadowMapImageMemory, app.shadowMapLayerViews, app.shadowMapFramebuffers);
+        sampledImage = app.shadowMapImage;
+    }
+    app.shadowSampledView = createShadowView(app, sampledImage, VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, SHADOW_CASCADE_COUNT);
+    app.shadowSampledIndex = registerBindlessTexture(app, app.shadowSampledView);
+
+    // into the layouts the frame graph expects between frames. every cascade
+    // starts out stale, so nothing reads the undefined contents
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.push_back(makeTextureBarrier(app.shadowCacheImage, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED,
+        dynamicCasters ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+    if (dynamicCasters) {
+        barriers.push_back(makeTextureBarrier(app.shadowMapImage, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+    }
+    for (auto& barrier : barriers) {
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.layerCount = SHADOW_CASCADE_COUNT;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    endSingleTimeCommands(app, commandBuffer);
+
+    createShadowPipeline(app);
+}
+
+// culls the objects in [begin, end) against a cascade and writes a draw of
+// lod 0 for each one left into the upload ring
+[[nodiscard]] ShadowDrawRange writeShadowDraws(HelloTriangleApp& app, const glm::mat4& viewProj, uint32_t begin, uint32_t end)
+{
+    app.shadowCasters.clear();
+    cullSpheres(extractFrustumPlanes(viewProj), app.objectBounds, begin, end, app.shadowCasters);
+
+    ShadowDrawRange range {};
+    range.count = static_cast<uint32_t>(app.shadowCasters.size());
+    range.offset = allocateFromUploadRing(app, range.count * sizeof(VkDrawIndexedIndirectCommand), alignof(VkDrawIndexedIndirectCommand));
+
+    auto* draws = reinterpret_cast<VkDrawIndexedIndirectCommand*>(app.uploadRing.mapped + range.offset);
+    for (uint32_t i = 0; i < range.count; i++) {
+        uint32_t object = app.shadowCasters[i];
+        VkDrawIndexedIndirectCommand draw = app.shadowMeshDraws[app.objects[object].meshIndex];
+        draw.firstInstance = object;
+        draws[i] = draw;
+    }
+    return range;
+}
+
+// fits the cascades around the camera's frustum. a cascade is only made
+// again, and its static casters drawn again, once the camera has left the
+// margin it was made with or the sun has turned
+void updateShadowCascades(HelloTriangleApp& app, const Camera& camera, const glm::vec3& sunDirection)
+{
+    float aspect = app.swapChainExtent.width / static_cast<float>(app.swapChainExtent.height);
+    float tanHalfFov = std::tan(camera.verticalFov * 0.5f);
+    glm::vec3 forward = -glm::vec3(camera.view[0][2], camera.view[1][2], camera.view[2][2]);
+    uint32_t objectCount = static_cast<uint32_t>(app.objects.size());
+
+    app.cascadeSplits = computeCascadeSplits(camera.nearPlane, camera.farPlane);
+    app.staleCascadeMask = 0;
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        float nearDepth = i == 0 ? camera.nearPlane : app.cascadeSplits[i - 1];
+        glm::vec4 slice = getFrustumSliceSphere(camera.position, forward, tanHalfFov, aspect, nearDepth, app.cascadeSplits[i]);
+
+        ShadowCascade& cascade = app.shadowCascades[i];
+        if (!isShadowCascadeCurrent(cascade, sunDirection, slice)) {
+            cascade = makeShadowCascade(sunDirection, slice, app.sceneSphere, SHADOW_MAP_SIZE);
+            app.staticShadowDraws[i] = writeShadowDraws(app, cascade.viewProj, 0, app.staticCasterCount);
+            app.staleCascadeMask |= 1u << i;
+            app.cascadeRedrawCount++;
+        }
+
+        if (app.staticCasterCount < objectCount) {
+            app.dynamicShadowDraws[i] = writeShadowDraws(app, cascade.viewProj, app.staticCasterCount, objectCount);
+        }
+    }
+    app.shadowFrames++;
+}
+
+[[nodiscard]] uint32_t previousPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+// the culling shaders always bind the pyramid, so it exists even when
+// occlusion culling is off. it stays in the general layout, where it can be
+// both sampled and written
+void createDepthPyramid(HelloTriangleApp& app)
+{
+    app.depthPyramidWidth = previousPowerOfTwo(app.swapChainExtent.width);
+    app.depthPyramidHeight = previousPowerOfTwo(app.swapChainExtent.height);
+    app.depthPyramidLevels = 1;
+    while ((std::max(app.depthPyramidWidth, app.depthPyramidHeight) >> app.depthPyramidLevels) > 0) {
+        app.depthPyramidLevels++;
+    }
+
+    createImage(app, app.depthPyramidWidth, app.depthPyramidHeight, app.depthPyramidLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, app.depthPyramid, app.depthPyramidMemory);
+
+    app.depthPyramidView = createImageView(app, app.depthPyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, app.depthPyramidLevels);
+    app.depthPyramidLevelViews.resize(app.depthPyramidLevels);
+    for (uint32_t level = 0; level < app.depthPyramidLevels; level++) {
+        app.depthPyramidLevelViews[level] = createImageView(app, app.depthPyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+    }
+
+    // the shaders only use texelFetch, so filtering does not matter
+    VkSamplerCreateInfo samplerInfo {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(app.depthPyramidLevels);
+
+    auto result = vkCreateSampler(app.device, &samplerInfo, nullptr, &app.depthPyramidSampler);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+
+    // cleared to the far plane, so nothing is occluded before the first
+    // reduction
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+
+    VkImageSubresourceRange range {};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = app.depthPyramidLevels;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    // tracked only for the clear, the frame graph takes it over from GENERAL
+    uint64_t handle = getTrackedHandle(app.depthPyramid);
+    trackImage(app.barrierTracker, handle, app.depthPyramidLevels, VK_IMAGE_LAYOUT_UNDEFINED);
+    useImage(app.barrierTracker, handle, 0, app.depthPyramidLevels, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true);
+    recordTrackedBarriers(app, commandBuffer);
+
+    VkClearColorValue farPlane = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+    vkCmdClearColorImage(commandBuffer, app.depthPyramid, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &range);
+
+    useImage(app.barrierTracker, handle, 0, app.depthPyramidLevels, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, false);
+    recordTrackedBarriers(app, commandBuffer);
+    forgetImage(app.barrierTracker, handle);
+
+    endSingleTimeCommands(app, commandBuffer);
+}
+
+void createDepthReducePipeline(HelloTriangleApp& app)
+{
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    auto result = vkCreateDescriptorSetLayout(app.device, &layoutInfo, nullptr, &app.depthReduceSetLayout);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    app.depthReducePipelineLayout = createPipelineLayout(app, { app.depthReduceSetLayout }, {});
+    app.depthReducePipeline = createComputePipeline(app, "shaders/depth_reduce_comp.spv", app.depthReducePipelineLayout);
+
+    // one set per level, each reads the level above it or the depth buffer
+    std::array<VkDescriptorPoolSize, 2> poolSizes {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = app.depthPyramidLevels;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = app.depthPyramidLevels;
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = app.depthPyramidLevels;
+
+    result = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &app.depthReduceDescriptorPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(app.depthPyramidLevels, app.depthReduceSetLayout);
+
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = app.depthReduceDescriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+
+    app.depthReduceDescriptorSets.resize(app.depthPyramidLevels);
+    result = vkAllocateDescriptorSets(app.device, &allocInfo, app.depthReduceDescriptorSets.data());
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    for (uint32_t level = 0; level < app.depthPyramidLevels; level++) {
+        VkDescriptorImageInfo sourceInfo {};
+        sourceInfo.sampler = app.depthPyramidSampler;
+        sourceInfo.imageView = level == 0 ? app.depthImageView : app.depthPyramidLevelViews[level - 1];
+        sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo destinationInfo {};
+        destinationInfo.imageView = app.depthPyramidLevelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites {};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = app.depthReduceDescriptorSets[level];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = bindings[binding].descriptorType;
+            descriptorWrites[binding].descriptorCount = 1;
+        }
+        descriptorWrites[0].pImageInfo = &sourceInfo;
+        descriptorWrites[1].pImageInfo = &destinationInfo;
+
+        vkUpdateDescriptorSets(app.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void createDescriptorPool(HelloTriangleApp& app)
+{
+    std::array<VkDescriptorPoolSize, 2> poolSizes {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 7 * MAX_FRAMES_IN_FLIGHT;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+    auto result = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &app.descriptorPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+}
+
+void createSceneDescriptorSets(HelloTriangleApp& app)
+{
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, app.sceneSetLayout);
+
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = app.descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+
+    app.sceneDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    auto result = vkAllocateDescriptorSets(app.device, &allocInfo, app.sceneDescriptorSets.data());
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        size_t previousFrame = (i + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT;
+        VkDescriptorBufferInfo bufferInfos[7] = {
+            { app.objectBuffer, 0, VK_WHOLE_SIZE },
+            { app.meshInfoBuffer, 0, VK_WHOLE_SIZE },
+            { app.drawCommandBuffers[i], 0, VK_WHOLE_SIZE },
+            { app.drawCountBuffers[i], 0, VK_WHOLE_SIZE },
+            { app.meshletBuffer, 0, VK_WHOLE_SIZE },
+            { app.visibilityBuffers[previousFrame], 0, VK_WHOLE_SIZE },
+            { app.visibilityBuffers[i], 0, VK_WHOLE_SIZE },
+        };
+
+        VkDescriptorImageInfo pyramidInfo {};
+        pyramidInfo.sampler = app.depthPyramidSampler;
+        pyramidInfo.imageView = app.depthPyramidView;
+        pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 8> descriptorWrites {};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = app.sceneDescriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+        descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[7].pBufferInfo = nullptr;
+        descriptorWrites[7].pImageInfo = &pyramidInfo;
+
+        vkUpdateDescriptorSets(app.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void recordCullingPass(HelloTriangleApp& app, VkCommandBuffer commandBuffer, const Camera& camera, CullPhase phase)
+{
+    // the frame graph orders the pass against the draws around it, only the
+    // clear of the count is synchronized here
+    vkCmdFillBuffer(commandBuffer, app.drawCountBuffers[app.currentFrame], 0, sizeof(uint32_t), 0);
+    useMemory(app.barrierTracker, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    recordTrackedBarriers(app, commandBuffer);
+
+    CullPushConstants pushConstants {};
+    pushConstants.viewProj = camera.viewProj;
+    pushConstants.cameraPosition = glm::vec4(camera.position, 1.0f);
+    pushConstants.lodScale = app.renderExtent.height / (2.0f * std::tan(camera.verticalFov * 0.5f));
+    pushConstants.lodThreshold = app.config.lodThreshold;
+    pushConstants.objectCount = app.config.objectCount;
+    pushConstants.drawCapacity = app.drawCapacity;
+    pushConstants.projection00 = camera.projection[0][0];
+    pushConstants.projection11 = -camera.projection[1][1];
+    pushConstants.nearPlane = camera.nearPlane;
+    pushConstants.phase = phase;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.cullPipelineLayout, 0, 1, &app.sceneDescriptorSets[app.currentFrame], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, app.cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+    if (app.config.clusterCulling) {
+        // one workgroup per object, spread over y as well since a single
+        // dimension only guarantees 65535 groups
+        uint32_t groupsX = std::min(app.config.objectCount, 65535u);
+        uint32_t groupsY = (app.config.objectCount + groupsX - 1) / groupsX;
+        vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+    } else {
+        vkCmdDispatch(commandBuffer, (app.config.objectCount + 63) / 64, 1, 1);
+    }
+}
+
+// bins every light into the clusters its range touches, one workgroup per
+// cluster
+void recordLightCulling(HelloTriangleApp& app, VkCommandBuffer commandBuffer, const Camera& camera)
+{
+    ClusterSlicing slicing = getClusterSlicing(camera.nearPlane, camera.farPlane);
+
+    LightCullPushConstants pushConstants {};
+    pushConstants.view = camera.view;
+    pushConstants.projection00 = camera.projection[0][0];
+    pushConstants.projection11 = -camera.projection[1][1];
+    pushConstants.sliceScale = slicing.scale;
+    pushConstants.sliceBias = slicing.bias;
+    pushConstants.lightBuffer = app.lightBufferIndices[app.currentFrame];
+    pushConstants.clusterBuffer = app.clusterBufferIndices[app.currentFrame];
+    pushConstants.lightIndexBuffer = app.lightIndexBufferIndices[app.currentFrame];
+    pushConstants.overflowBuffer = app.lightOverflowBufferIndices[app.currentFrame];
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.lightCullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.lightCullPipelineLayout, 0, 1, &app.bindlessDescriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, app.lightCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, CLUSTER_COUNT, 1, 1);
+}
+
+// one cascade's worth of casters into a layer of the cache or the shadow map
+void recordShadowDraws(HelloTriangleApp& app, VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer,
+    const ShadowCascade& cascade, const ShadowDrawRange& draws)
+{
+    VkClearValue clearValue {};
+    clearValue.depthStencil = { 1.0f, 0 };
+
+    VkRenderPassBeginInfo renderPassInfo {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffer;
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE };
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearValue;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(SHADOW_MAP_SIZE);
+    viewport.height = static_cast<float>(SHADOW_MAP_SIZE);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor {};
+    scissor.offset = { 0, 0 };
+    scissor.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    ShadowPushConstants pushConstants {};
+    pushConstants.viewProj = cascade.viewProj;
+    pushConstants.objectBuffer = app.objectBufferIndex;
+    pushConstants.meshBuffer = app.meshInfoBufferIndex;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.shadowPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.shadowPipelineLayout, 0, 1, &app.bindlessDescriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, app.shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &app.vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, app.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    // the cpu wrote the draws, so their count is known and no count buffer
+    // is needed
+    uint32_t maxDrawCount = app.deviceProfile.maxDrawIndirectCount;
+    for (uint32_t first = 0; first < draws.count; first += maxDrawCount) {
+        uint32_t count = std::min(draws.count - first, maxDrawCount);
+        vkCmdDrawIndexedIndirect(commandBuffer, app.uploadRing.buffer, draws.offset + first * sizeof(VkDrawIndexedIndirectCommand), count,
+            sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void recordStaticShadows(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        if (app.staleCascadeMask & (1u << i)) {
+            recordShadowDraws(app, commandBuffer, app.shadowClearRenderPass, app.shadowCacheFramebuffers[i], app.shadowCascades[i], app.staticShadowDraws[i]);
+        }
+    }
+}
+
+// every layer at once, copying is far cheaper than drawing the static
+// casters again
+void recordShadowComposite(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    VkImageCopy region {};
+    region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, SHADOW_CASCADE_COUNT };
+    region.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, SHADOW_CASCADE_COUNT };
+    region.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 };
+
+    vkCmdCopyImage(commandBuffer, app.shadowCacheImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, app.shadowMapImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+        &region);
+}
+
+void recordDynamicShadows(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        if (app.dynamicShadowDraws[i].count > 0) {
+            recordShadowDraws(app, commandBuffer, app.shadowLoadRenderPass, app.shadowMapFramebuffers[i], app.shadowCascades[i], app.dynamicShadowDraws[i]);
+        }
+    }
+}
+
+void recordDepthPyramid(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.depthReducePipeline);
+
+    // each level waits for the one above it, the frame graph covers the
+    // first one and the culling after
+    for (uint32_t level = 0; level < app.depthPyramidLevels; level++) {
+        if (level > 0) {
+            useMemory(app.barrierTracker, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT);
+            recordTrackedBarriers(app, commandBuffer);
+        }
+
+        uint32_t width = std::max(app.depthPyramidWidth >> level, 1u);
+        uint32_t height = std::max(app.depthPyramidHeight >> level, 1u);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app.depthReducePipelineLayout, 0, 1, &app.depthReduceDescriptorSets[level], 0, nullptr);
+        vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
     }
+}
+
+// moves on to the lighting subpass and lights the g-buffer with what the
+// forward path would have pushed to the mesh shaders
+void recordDeferredLighting(HelloTriangleApp& app, VkCommandBuffer commandBuffer, const Camera& camera, const MeshPushConstants& meshPushConstants)
+{
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+    DeferredLightingPushConstants pushConstants {};
+    pushConstants.inverseViewProj = glm::inverse(camera.viewProj);
+    pushConstants.cameraPosition = meshPushConstants.cameraPosition;
+    pushConstants.cameraForward = meshPushConstants.cameraForward;
+    pushConstants.tileSize = meshPushConstants.tileSize;
+    pushConstants.renderSize = glm::vec2(app.renderExtent.width, app.renderExtent.height);
+    pushConstants.lightBuffer = meshPushConstants.lightBuffer;
+    pushConstants.clusterBuffer = meshPushConstants.clusterBuffer;
+    pushConstants.lightIndexBuffer = meshPushConstants.lightIndexBuffer;
+
+    std::array<VkDescriptorSet, 2> descriptorSets = { app.bindlessDescriptorSet, app.gbufferDescriptorSet };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.deferredLightingPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.deferredLightingPipelineLayout, 0,
+        static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+    vkCmdPushConstants(commandBuffer, app.deferredLightingPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
 
+void recordScenePass(HelloTriangleApp& app, VkCommandBuffer commandBuffer, uint32_t imageIndex, VkRenderPass renderPass, const Camera& camera)
+{
     VkRenderPassBeginInfo renderPassInfo {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = app.renderPass;
+    renderPassInfo.renderPass = renderPass;
     renderPassInfo.framebuffer = app.swapChainFramebuffers[imageIndex];
 
     renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = app.swapChainExtent;
+    renderPassInfo.renderArea.extent = app.renderExtent;
 
-    VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 1.0f } } };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    // color and depth come first in every scene render pass, whatever follows
+    // them isn't cleared
+    std::array<VkClearValue, 2> clearValues {};
+    clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+    clearValues[1].depthStencil = { 1.0f, 0 };
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.graphicsPipeline);
 
     VkViewport viewport {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = static_cast<float>(app.swapChainExtent.width);
-    viewport.height = static_cast<float>(app.swapChainExtent.height);
+    viewport.width = static_cast<float>(app.renderExtent.width);
+    viewport.height = static_cast<float>(app.renderExtent.height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     VkRect2D scissor {};
     scissor.offset = { 0, 0 };
-    scissor.extent = app.swapChainExtent;
+    scissor.extent = app.renderExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    // with a pre-pass the same draws go out twice, first depth only and then
+    // shaded with an EQUAL test so every pixel is shaded at most once
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        // the one descriptor set bind of the pass, textures and buffers are
+        // picked by slot in the shaders
+        ClusterSlicing slicing = getClusterSlicing(camera.nearPlane, camera.farPlane);
+        glm::vec3 forward = -glm::vec3(camera.view[0][2], camera.view[1][2], camera.view[2][2]);
+        bool lightClusters = usesLightClusters(app.config);
+
+        MeshPushConstants pushConstants {};
+        pushConstants.viewProj = camera.viewProj;
+        pushConstants.cameraPosition = glm::vec4(camera.position, slicing.scale);
+        pushConstants.cameraForward = glm::vec4(forward, slicing.bias);
+        pushConstants.objectBuffer = app.objectBufferIndex;
+        pushConstants.meshBuffer = app.meshInfoBufferIndex;
+        pushConstants.textureTable = app.textureTableIndices[app.currentFrame];
+        pushConstants.lightBuffer = app.lightBufferIndices[app.currentFrame];
+        pushConstants.clusterBuffer = lightClusters ? app.clusterBufferIndices[app.currentFrame] : NO_CLUSTERS;
+        pushConstants.lightIndexBuffer = lightClusters ? app.lightIndexBufferIndices[app.currentFrame] : NO_CLUSTERS;
+        pushConstants.tileSize = glm::vec2(app.renderExtent.width / static_cast<float>(CLUSTER_GRID_X), app.renderExtent.height / static_cast<float>(CLUSTER_GRID_Y));
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.meshPipelineLayout, 0, 1, &app.bindlessDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, app.meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &app.vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, app.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+        // the same handful of commands whatever the object count, the gpu
+        // decides what actually gets drawn
+        if (app.meshDepthPipeline != VK_NULL_HANDLE) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.meshDepthPipeline);
+            vkCmdDrawIndexedIndirectCount(commandBuffer, app.drawCommandBuffers[app.currentFrame], 0,
+                app.drawCountBuffers[app.currentFrame], 0, app.maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.meshPipeline);
+        vkCmdDrawIndexedIndirectCount(commandBuffer, app.drawCommandBuffers[app.currentFrame], 0,
+            app.drawCountBuffers[app.currentFrame], 0, app.maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+
+        if (app.deferredShading) {
+            recordDeferredLighting(app, commandBuffer, camera, pushConstants);
+        }
+    } else {
+        vkCmdPushConstants(commandBuffer, app.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(camera.viewProj), &camera.viewProj);
+
+        VkBuffer vertexBuffers[] = { app.uploadRing.buffer };
+        VkDeviceSize offsets[] = { app.instanceOffset };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+        uint32_t instanceCount = static_cast<uint32_t>(app.visibleInstances.size());
+        if (app.graphicsDepthPipeline != VK_NULL_HANDLE) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.graphicsDepthPipeline);
+            vkCmdDraw(commandBuffer, 3, instanceCount, 0, 0);
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.graphicsPipeline);
+        vkCmdDraw(commandBuffer, 3, instanceCount, 0, 0);
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+// stretches the rendered corner of the offscreen target over the swap chain
+// image
+void recordUpscale(HelloTriangleApp& app, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    VkImageBlit blit {};
+    blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    blit.srcOffsets[1] = { static_cast<int32_t>(app.renderExtent.width), static_cast<int32_t>(app.renderExtent.height), 1 };
+    blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    blit.dstOffsets[1] = { static_cast<int32_t>(app.swapChainExtent.width), static_cast<int32_t>(app.swapChainExtent.height), 1 };
+    vkCmdBlitImage(commandBuffer, app.offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, app.swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+        VK_FILTER_LINEAR);
+}
+
+// one call per batch. without synchronization2 the stages of every barrier
+// in the batch are merged, which is all vkCmdPipelineBarrier can express
+void recordGraphBarriers(HelloTriangleApp& app, VkCommandBuffer commandBuffer, const GraphBarrierBatch& batch)
+{
+    bool memoryBarrier = batch.dstStages != 0;
+    if (!memoryBarrier && batch.imageBarriers.empty()) {
+        return;
+    }
+
+    if (app.synchronization2) {
+        VkMemoryBarrier2KHR globalBarrier {};
+        globalBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+        globalBarrier.srcStageMask = batch.srcStages;
+        globalBarrier.srcAccessMask = batch.srcAccess;
+        globalBarrier.dstStageMask = batch.dstStages;
+        globalBarrier.dstAccessMask = batch.dstAccess;
+
+        std::vector<VkImageMemoryBarrier2KHR> imageBarriers(batch.imageBarriers.size());
+        for (size_t i = 0; i < imageBarriers.size(); i++) {
+            const GraphBarrier& barrier = batch.imageBarriers[i];
+            const FrameGraphImage& image = app.frameGraphImages[barrier.resource];
+
+            imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+            imageBarriers[i].srcStageMask = barrier.srcStages;
+            imageBarriers[i].srcAccessMask = barrier.srcAccess;
+            imageBarriers[i].dstStageMask = barrier.dstStages;
+            imageBarriers[i].dstAccessMask = barrier.dstAccess;
+            imageBarriers[i].oldLayout = static_cast<VkImageLayout>(barrier.oldLayout);
+            imageBarriers[i].newLayout = static_cast<VkImageLayout>(barrier.newLayout);
+            imageBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarriers[i].image = image.image;
+            imageBarriers[i].subresourceRange = { image.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+        }
+
+        VkDependencyInfoKHR dependencyInfo {};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependencyInfo.memoryBarrierCount = memoryBarrier ? 1 : 0;
+        dependencyInfo.pMemoryBarriers = &globalBarrier;
+        dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+        dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+        app.cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+        return;
+    }
+
+    // the graph only uses stages and access bits that exist in both versions
+    VkPipelineStageFlags srcStages = static_cast<VkPipelineStageFlags>(batch.srcStages);
+    VkPipelineStageFlags dstStages = static_cast<VkPipelineStageFlags>(batch.dstStages);
+
+    VkMemoryBarrier globalBarrier {};
+    globalBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    globalBarrier.srcAccessMask = static_cast<VkAccessFlags>(batch.srcAccess);
+    globalBarrier.dstAccessMask = static_cast<VkAccessFlags>(batch.dstAccess);
+
+    std::vector<VkImageMemoryBarrier> imageBarriers(batch.imageBarriers.size());
+    for (size_t i = 0; i < imageBarriers.size(); i++) {
+        const GraphBarrier& barrier = batch.imageBarriers[i];
+        const FrameGraphImage& image = app.frameGraphImages[barrier.resource];
+
+        imageBarriers[i] = makeTextureBarrier(image.image, static_cast<VkAccessFlags>(barrier.srcAccess), static_cast<VkAccessFlags>(barrier.dstAccess),
+            static_cast<VkImageLayout>(barrier.oldLayout), static_cast<VkImageLayout>(barrier.newLayout));
+        imageBarriers[i].subresourceRange.aspectMask = image.aspect;
+        imageBarriers[i].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        srcStages |= static_cast<VkPipelineStageFlags>(barrier.srcStages);
+        dstStages |= static_cast<VkPipelineStageFlags>(barrier.dstStages);
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        memoryBarrier ? 1 : 0, &globalBarrier, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+// covers the pre-pass and the shading passes but not the culling before them
+void beginStatisticsQuery(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    if (app.statisticsQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, app.statisticsQueryPool, app.currentFrame, 1);
+        vkCmdBeginQuery(commandBuffer, app.statisticsQueryPool, app.currentFrame, 0);
+    }
+}
+
+void endStatisticsQuery(HelloTriangleApp& app, VkCommandBuffer commandBuffer)
+{
+    if (app.statisticsQueryPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(commandBuffer, app.statisticsQueryPool, app.currentFrame);
+        app.statisticsQueryWritten[app.currentFrame] = true;
+    }
+}
+
+void recordFramePass(HelloTriangleApp& app, VkCommandBuffer commandBuffer, uint32_t imageIndex, const Camera& camera, FramePass pass)
+{
+    bool occlusion = app.config.renderPath == RenderPath::GpuDriven && app.config.occlusionCulling;
+
+    switch (pass) {
+    case FramePass::TextureStreaming:
+        recordTextureStreaming(app, commandBuffer, camera);
+        break;
+    case FramePass::Cull:
+        recordCullingPass(app, commandBuffer, camera, occlusion ? CullPhase::Early : CullPhase::All);
+        break;
+    case FramePass::LightUpload:
+        recordLightUpload(app, commandBuffer);
+        break;
+    case FramePass::LightCulling:
+        recordLightCulling(app, commandBuffer, camera);
+        break;
+    case FramePass::StaticShadows:
+        recordStaticShadows(app, commandBuffer);
+        break;
+    case FramePass::ShadowComposite:
+        recordShadowComposite(app, commandBuffer);
+        break;
+    case FramePass::DynamicShadows:
+        recordDynamicShadows(app, commandBuffer);
+        break;
+    case FramePass::EarlyScene:
+        waitTextureEvent(app, commandBuffer);
+        beginStatisticsQuery(app, commandBuffer);
+        recordScenePass(app, commandBuffer, imageIndex, app.earlyRenderPass, camera);
+        break;
+    case FramePass::DepthPyramid:
+        recordDepthPyramid(app, commandBuffer);
+        break;
+    case FramePass::LateCull:
+        recordCullingPass(app, commandBuffer, camera, CullPhase::Late);
+        break;
+    case FramePass::LateScene:
+        recordScenePass(app, commandBuffer, imageIndex, app.lateRenderPass, camera);
+        endStatisticsQuery(app, commandBuffer);
+        break;
+    case FramePass::Scene:
+        waitTextureEvent(app, commandBuffer);
+        beginStatisticsQuery(app, commandBuffer);
+        recordScenePass(app, commandBuffer, imageIndex, app.renderPass, camera);
+        endStatisticsQuery(app, commandBuffer);
+        break;
+    case FramePass::Upscale:
+        recordUpscale(app, commandBuffer, imageIndex);
+        break;
+    }
+}
+
+// hands the frame's draw buffers from the compute queue family to the
+// graphics one. the compute queue records it as the release, the graphics
+// queue as the acquire, each side's access mask is ignored on the other
+[[nodiscard]] std::array<VkBufferMemoryBarrier, 2> makeDrawBufferTransfer(const HelloTriangleApp& app, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    std::array<VkBuffer, 2> buffers = { app.drawCommandBuffers[app.currentFrame], app.drawCountBuffers[app.currentFrame] };
+
+    std::array<VkBufferMemoryBarrier, 2> barriers {};
+    for (size_t i = 0; i < barriers.size(); i++) {
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = srcAccess;
+        barriers[i].dstAccessMask = dstAccess;
+        barriers[i].srcQueueFamilyIndex = app.computeFamily;
+        barriers[i].dstQueueFamilyIndex = app.graphicsFamily;
+        barriers[i].buffer = buffers[i];
+        barriers[i].offset = 0;
+        barriers[i].size = VK_WHOLE_SIZE;
+    }
+    return barriers;
+}
+
+// culls on the compute queue while the graphics queue may still be drawing
+// the previous frame. nothing has to go back to the compute queue, the next
+// culling of these buffers overwrites them
+void submitAsyncCulling(HelloTriangleApp& app, const Camera& camera)
+{
+    VkCommandBuffer commandBuffer = app.computeCommandBuffers[app.currentFrame];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    recordCullingPass(app, commandBuffer, camera, CullPhase::All);
+
+    std::array<VkBufferMemoryBarrier, 2> releaseBarriers = makeDrawBufferTransfer(app, VK_ACCESS_SHADER_WRITE_BIT, 0);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+        static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data(), 0, nullptr);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &app.cullFinishedSemaphores[app.currentFrame];
+
+    // the graphics submit waits for the semaphore, so the frame's fence
+    // covers this submit too
+    if (vkQueueSubmit(app.computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit culling command buffer!");
+    }
+}
+
+void recordCommandBufer(HelloTriangleApp& app, VkCommandBuffer commandBuffer, uint32_t imageIndex, const Camera& camera)
+{
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0;
+    beginInfo.pInheritanceInfo = nullptr;
+
+    auto commandBufferBeginningResult = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (commandBufferBeginningResult != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    if (app.dynamicResolution) {
+        vkCmdResetQueryPool(commandBuffer, app.timestampQueryPool, app.currentFrame * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, app.timestampQueryPool, app.currentFrame * 2);
+    }
+
+    if (app.asyncCompute) {
+        std::array<VkBufferMemoryBarrier, 2> acquireBarriers = makeDrawBufferTransfer(app, 0, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr,
+            static_cast<uint32_t>(acquireBarriers.size()), acquireBarriers.data(), 0, nullptr);
+    }
+
+    declareFrameGraph(app, imageIndex);
+    const CompiledGraph& frameGraph = compileRenderGraph(app.frameGraph);
+
+    // a recompile may only move transient images that weren't bound yet
+    if (app.frameGraph.compileCount != app.checkedCompileCount) {
+        for (uint32_t i = 0; i < app.frameGraph.resources.size(); i++) {
+            const GraphResourceDesc& desc = app.frameGraph.resources[i];
+            if (!desc.transient || desc.size == 0) {
+                continue;
+            }
+            std::pair<VkImage, VkDeviceSize> binding = { app.frameGraphImages[i].image, frameGraph.memoryOffsets[i] };
+            if (std::find(app.transientBindings.begin(), app.transientBindings.end(), binding) == app.transientBindings.end()) {
+                throw std::runtime_error("frame graph moved a transient image!");
+            }
+        }
+        app.checkedCompileCount = app.frameGraph.compileCount;
+    }
+
+    for (size_t i = 0; i < frameGraph.passes.size(); i++) {
+        recordGraphBarriers(app, commandBuffer, frameGraph.batches[i]);
+        FramePass pass = static_cast<FramePass>(app.frameGraph.passes[frameGraph.passes[i]].tag);
+        recordFramePass(app, commandBuffer, imageIndex, camera, pass);
+    }
+    recordGraphBarriers(app, commandBuffer, frameGraph.finalBatch);
+    endBarrierFrame(app.barrierTracker);
 
-    vkCmdEndRenderPass(commandBuffer);
+    if (app.dynamicResolution) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, app.timestampQueryPool, app.currentFrame * 2 + 1);
+        app.timestampsWritten[app.currentFrame] = true;
+    }
 
     auto commandBufferEndingResult = vkEndCommandBuffer(commandBuffer);
     if (commandBufferEndingResult != VK_SUCCESS) {
@@ -889,6 +6071,11 @@ void recordCommandBufer(HelloTriangleApp& app, VkCommandBuffer commandBuffer, ui
 
 void createSyncObjects(HelloTriangleApp& app)
 {
+    app.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    app.imageFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    app.inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    app.textureEvents.resize(MAX_FRAMES_IN_FLIGHT);
+
     VkSemaphoreCreateInfo semaphoreInfo {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
@@ -896,13 +6083,39 @@ void createSyncObjects(HelloTriangleApp& app)
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    auto availableCreationResult = vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &app.imageAvailableSemaphore);
-    auto finishedCreationResult = vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &app.imageFinishedSemaphore);
-    auto fenceResult = vkCreateFence(app.device, &fenceInfo, nullptr, &app.inFlightFence);
+    VkEventCreateInfo eventInfo {};
+    eventInfo.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        auto availableCreationResult = vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &app.imageAvailableSemaphores[i]);
+        auto finishedCreationResult = vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &app.imageFinishedSemaphores[i]);
+        auto fenceResult = vkCreateFence(app.device, &fenceInfo, nullptr, &app.inFlightFences[i]);
+        auto eventResult = vkCreateEvent(app.device, &eventInfo, nullptr, &app.textureEvents[i]);
+
+        if (availableCreationResult != VK_SUCCESS || finishedCreationResult != VK_SUCCESS || fenceResult != VK_SUCCESS || eventResult != VK_SUCCESS) {
+            throw std::runtime_error("failed to create sync objects!");
+        }
+    }
+
+    if (app.asyncCompute) {
+        app.cullFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &app.cullFinishedSemaphores[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create sync objects!");
+            }
+        }
+    }
+}
 
-    if (availableCreationResult != VK_SUCCESS || finishedCreationResult != VK_SUCCESS || fenceResult != VK_SUCCESS) {
-        throw std::runtime_error("failed to create sync objects!");
+void printStartupProfile(const HelloTriangleApp& app)
+{
+    const StartupProfiler& profiler = app.startupProfiler;
+    std::cout << "startup: " << getStartupMilliseconds(profiler) << " ms\n";
+    for (const auto& phase : profiler.phases) {
+        std::cout << "\t" << phase.name << ": " << phase.milliseconds << " ms\n";
     }
+    std::cout << "\tcapability cache: " << app.deviceCapabilities.size() << " devices, " << app.capabilityQueries << " driver queries, "
+              << app.capabilityHits << " lookups answered from the cache" << std::endl;
 }
 
 void initVulkan(HelloTriangleApp& app)
@@ -910,47 +6123,265 @@ void initVulkan(HelloTriangleApp& app)
     createInstance(app);
     setupDebugMessenger(app);
     createSurface(app);
+    markStartupPhase(app.startupProfiler, "instance and surface");
     pickPhysicalDevice(app);
+    chooseMipGeneration(app);
+    chooseShadingPath(app);
+    chooseShadows(app);
+    chooseMsaaSamples(app);
+    markStartupPhase(app.startupProfiler, "device selection");
     createLogicalDevice(app);
+    markStartupPhase(app.startupProfiler, "logical device");
     createSwapChain(app);
     createImageViews(app);
+    createOffscreenTarget(app);
+    createColorResources(app);
+    createDepthResources(app);
+    createGBuffer(app);
+    createTransientMemory(app);
     createRenderPass(app);
     createGraphicsPipeline(app);
     createFramebuffers(app);
+    markStartupPhase(app.startupProfiler, "swap chain and render passes");
     createCommandPool(app);
-    createCommandBuffer(app);
+    createCommandBuffers(app);
+    createUploadRing(app);
+    // only the gpu driven scene uploads device local buffers
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        createStagingRing(app);
+    }
+
+    if (app.mipGeneration == MipGeneration::Compute) {
+        createDownsamplePipeline(app);
+    }
+
+    markStartupPhase(app.startupProfiler, "command buffers and rings");
+
+    // both paths report their scene as its own phase
+    if (app.config.renderPath == RenderPath::Instanced) {
+        createInstanceBounds(app);
+    } else {
+        createSceneDescriptorSetLayout(app);
+        createCullPipeline(app);
+        createBindlessTable(app);
+        createTextures(app);
+        createScene(app);
+        createLights(app);
+        if (app.shadows) {
+            createShadowResources(app);
+        }
+        // the vertex layout is only known once the scene is loaded
+        createMeshPipeline(app);
+        if (app.deferredShading) {
+            createDeferredLightingPipeline(app);
+        }
+        createDepthPyramid(app);
+        if (app.config.occlusionCulling) {
+            createDepthReducePipeline(app);
+        }
+        createDescriptorPool(app);
+        createSceneDescriptorSets(app);
+    }
+    markStartupPhase(app.startupProfiler, "scene");
+
+    if (app.config.pipelineStatistics) {
+        createStatisticsQueryPool(app);
+    }
+
     createSyncObjects(app);
+    if (app.transferUploads) {
+        startTransferWorker(app);
+    }
+    markStartupPhase(app.startupProfiler, "sync objects");
+
+    if (app.config.profileStartup) {
+        printStartupProfile(app);
+    }
+
+    app.startTime = std::chrono::steady_clock::now();
+}
+
+// everything that bakes in the sample count: the attachments, the render
+// passes, the framebuffers and every graphics pipeline
+void destroySampleCountResources(HelloTriangleApp& app)
+{
+    for (auto framebuffer : app.swapChainFramebuffers) {
+        vkDestroyFramebuffer(app.device, framebuffer, nullptr);
+    }
+    if (app.colorImage != VK_NULL_HANDLE) {
+        vkDestroyImageView(app.device, app.colorImageView, nullptr);
+        vkDestroyImage(app.device, app.colorImage, nullptr);
+        vkFreeMemory(app.device, app.colorImageMemory, nullptr);
+        app.colorImage = VK_NULL_HANDLE;
+        app.colorImageView = VK_NULL_HANDLE;
+        app.colorImageMemory = VK_NULL_HANDLE;
+    }
+    vkDestroyImageView(app.device, app.depthImageView, nullptr);
+    vkDestroyImage(app.device, app.depthImage, nullptr);
+    vkFreeMemory(app.device, app.depthImageMemory, nullptr);
+    vkDestroyRenderPass(app.device, app.renderPass, nullptr);
+    vkDestroyRenderPass(app.device, app.earlyRenderPass, nullptr);
+    vkDestroyRenderPass(app.device, app.lateRenderPass, nullptr);
+    vkDestroyPipeline(app.device, app.graphicsPipeline, nullptr);
+    vkDestroyPipeline(app.device, app.graphicsDepthPipeline, nullptr);
+    vkDestroyPipelineLayout(app.device, app.pipelineLayout, nullptr);
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        vkDestroyPipeline(app.device, app.meshPipeline, nullptr);
+        vkDestroyPipeline(app.device, app.meshDepthPipeline, nullptr);
+        vkDestroyPipelineLayout(app.device, app.meshPipelineLayout, nullptr);
+    }
+    if (app.deferredLightingPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(app.device, app.deferredLightingPipeline, nullptr);
+        vkDestroyPipelineLayout(app.device, app.deferredLightingPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(app.device, app.gbufferDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(app.device, app.gbufferSetLayout, nullptr);
+    }
+}
+
+// steps to the next supported sample count, wrapping around to 1
+void switchMsaaSamples(HelloTriangleApp& app)
+{
+    if (app.config.occlusionCulling) {
+        std::cout << "msaa is not available with occlusion culling" << std::endl;
+        return;
+    }
+    if (app.deferredShading) {
+        std::cout << "msaa is not available with deferred shading" << std::endl;
+        return;
+    }
+
+    VkSampleCountFlags supported = app.deviceProfile.sampleCounts;
+    uint32_t samples = app.msaaSamples;
+    do {
+        samples = samples >= VK_SAMPLE_COUNT_64_BIT ? 1 : samples * 2;
+    } while (!(supported & samples));
+
+    // waits for the frames rather than the device, the transfer worker may
+    // be submitting to its queue
+    vkWaitForFences(app.device, MAX_FRAMES_IN_FLIGHT, app.inFlightFences.data(), VK_TRUE, UINT64_MAX);
+    destroySampleCountResources(app);
+
+    // images can't be bound twice, so the offscreen target is made again for
+    // the new block. the g-buffer would be too, but it never meets msaa
+    if (app.dynamicResolution) {
+        vkDestroyImageView(app.device, app.offscreenImageView, nullptr);
+        vkDestroyImage(app.device, app.offscreenImage, nullptr);
+        createOffscreenImage(app);
+    }
+    vkFreeMemory(app.device, app.transientMemory, nullptr);
+    app.transientMemory = VK_NULL_HANDLE;
+
+    app.msaaSamples = static_cast<VkSampleCountFlagBits>(samples);
+    createColorResources(app);
+    createDepthResources(app);
+    createTransientMemory(app);
+    createRenderPass(app);
+    createGraphicsPipeline(app);
+    createFramebuffers(app);
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        createMeshPipeline(app);
+    }
+
+    std::cout << "msaa: " << samples << "x" << std::endl;
 }
 
 void drawFrame(HelloTriangleApp& app)
 {
-    vkWaitForFences(app.device, 1, &app.inFlightFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(app.device, 1, &app.inFlightFence);
+    VkFence inFlightFence = app.inFlightFences[app.currentFrame];
+    VkCommandBuffer commandBuffer = app.commandBuffers[app.currentFrame];
+
+    vkWaitForFences(app.device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+
+    readPipelineStatistics(app);
+    readLightOverflow(app);
+    updateRenderScale(app);
+    resetDownsampleFrame(app);
+    vkResetEvent(app.device, app.textureEvents[app.currentFrame]);
+
+    // the frame that last used this fence is done, and with it everything
+    // released MAX_FRAMES_IN_FLIGHT frames ago
+    app.frameNumber++;
+    if (app.frameNumber > MAX_FRAMES_IN_FLIGHT) {
+        uint64_t completedFrame = app.frameNumber - MAX_FRAMES_IN_FLIGHT;
+        reclaimBindlessSlots(app.bindlessTextureSlots, completedFrame);
+        reclaimBindlessSlots(app.bindlessBufferSlots, completedFrame);
+
+        auto destroyable = std::stable_partition(app.retiredTextures.begin(), app.retiredTextures.end(),
+            [completedFrame](const auto& retired) { return retired.second > completedFrame; });
+        for (auto it = destroyable; it != app.retiredTextures.end(); ++it) {
+            destroyTexture(app, it->first);
+        }
+        app.retiredTextures.erase(destroyable, app.retiredTextures.end());
+    }
 
+    // the swap chain is never recreated, so an out of date one ends the app.
+    // the fence is only reset once a submit is sure to signal it again
     uint32_t imageIndex;
-    vkAcquireNextImageKHR(app.device, app.swapChain, UINT64_MAX, app.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    auto acquireResult = vkAcquireNextImageKHR(app.device, app.swapChain, UINT64_MAX, app.imageAvailableSemaphores[app.currentFrame], VK_NULL_HANDLE, &imageIndex);
+    if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("failed to acquire swap chain image!");
+    }
+    vkResetFences(app.device, 1, &inFlightFence);
+
+    // culling doesn't need the swap chain image, but its semaphore is only
+    // waited for by this frame's submit, which a failed acquire never makes
+    Camera camera = computeCamera(app);
+    if (app.asyncCompute) {
+        submitAsyncCulling(app, camera);
+    }
+
+    // the fence guarantees the gpu is done with this frame's ring slice
+    beginUploadRingFrame(app);
+    if (app.config.renderPath == RenderPath::Instanced) {
+        updateInstances(app);
+    } else {
+        float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - app.startTime).count();
+        glm::vec3 sunDirection = getSunDirection(time * app.config.sunSpeed);
+        if (app.shadows) {
+            updateShadowCascades(app, camera, sunDirection);
+        }
+        updateLights(app, sunDirection);
+    }
 
-    vkResetCommandBuffer(app.commandBuffer, 0);
+    vkResetCommandBuffer(commandBuffer, 0);
 
-    recordCommandBufer(app, app.commandBuffer, imageIndex);
+    recordCommandBufer(app, commandBuffer, imageIndex, camera);
 
     VkSubmitInfo submitInfo {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { app.imageAvailableSemaphore };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    std::vector<VkSemaphore> waitSemaphores = { app.imageAvailableSemaphores[app.currentFrame] };
+    std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    if (app.asyncCompute) {
+        waitSemaphores.push_back(app.cullFinishedSemaphores[app.currentFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    }
+
+    // binary semaphores ignore their wait value
+    std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+    if (app.uploadWaitValue > 0) {
+        waitSemaphores.push_back(app.transferWorker.timeline);
+        waitStages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+        waitValues.push_back(app.uploadWaitValue);
+
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        submitInfo.pNext = &timelineInfo;
+    }
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
 
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &app.commandBuffer;
+    submitInfo.pCommandBuffers = &commandBuffer;
 
-    VkSemaphore signalSemaphores[] = { app.imageFinishedSemaphore };
+    VkSemaphore signalSemaphores[] = { app.imageFinishedSemaphores[app.currentFrame] };
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    auto result = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, app.inFlightFence);
+    auto result = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, inFlightFence);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
@@ -968,16 +6399,91 @@ void drawFrame(HelloTriangleApp& app)
     presentInfo.pResults = nullptr;
 
     vkQueuePresentKHR(app.presentQueue, &presentInfo);
+
+    app.currentFrame = (app.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 void mainLoop(HelloTriangleApp& app)
 {
+    uint32_t frameCount = 0;
+    auto benchmarkStart = std::chrono::steady_clock::now();
+    resetBarrierCounts(app.barrierTracker);
+
     while (!glfwWindowShouldClose(app.window)) {
         glfwPollEvents();
+        if (app.msaaSwitchRequested) {
+            app.msaaSwitchRequested = false;
+            switchMsaaSamples(app);
+        }
         drawFrame(app);
+
+        frameCount++;
+        if (app.config.benchmark && frameCount == app.config.benchmarkFrames) {
+            break;
+        }
     }
 
+    stopTransferWorker(app);
     vkDeviceWaitIdle(app.device);
+
+    if (app.config.benchmark) {
+        bool gpuDriven = app.config.renderPath == RenderPath::GpuDriven;
+        uint32_t itemCount = gpuDriven ? app.config.objectCount : app.config.instanceCount;
+        const char* itemName = gpuDriven ? "objects" : "instances";
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - benchmarkStart).count();
+        double itemsPerSecond = static_cast<double>(itemCount) * frameCount / seconds;
+
+        std::cout << "benchmark: " << frameCount << " frames of " << itemCount << " " << itemName << " in " << seconds << " s\n";
+        std::cout << "\t" << seconds * 1000.0 / frameCount << " ms/frame\n";
+        std::cout << "\t" << itemsPerSecond / 1e6 << " million " << itemName << "/s" << std::endl;
+    }
+
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        const TextureStreamer& streamer = app.textureStreamer;
+        std::cout << "texture streaming: " << streamer.loadCount << " mips loaded (" << streamer.loadedBytes / (1024 * 1024) << " MB), "
+                  << streamer.evictionCount << " evicted, " << streamer.residentBytes / (1024 * 1024) << " MB resident, peak "
+                  << streamer.peakBytes / (1024 * 1024) << " of " << streamer.budget / (1024 * 1024) << " MB with the images in flight" << std::endl;
+    }
+
+    const BarrierTracker& tracker = app.barrierTracker;
+    if (tracker.frameCount > 0 && tracker.totalCounts.issued + tracker.totalCounts.elided > 0) {
+        const BarrierCounts& total = tracker.totalCounts;
+        const BarrierCounts& last = tracker.lastFrameCounts;
+        std::cout << "barrier tracker: " << total.issued << " barriers issued in " << total.batches << " batches, " << total.elided
+                  << " uses elided over " << tracker.frameCount << " frames, last frame " << last.issued << " issued, " << last.elided
+                  << " elided" << std::endl;
+    }
+
+    if (app.lightCullFrames > 0) {
+        std::cout << "light clusters: " << app.sceneLights.size() << " lights, " << app.lightOverflowFrames << " of " << app.lightCullFrames
+                  << " frames overflowed " << MAX_LIGHTS_PER_CLUSTER << " lights per cluster";
+        if (app.lightOverflowFrames > 0) {
+            std::cout << ", " << static_cast<double>(app.overflowClusterTotal) / app.lightOverflowFrames << " clusters and "
+                      << static_cast<double>(app.droppedLightTotal) / app.lightOverflowFrames << " lights dropped per overflowing frame";
+        }
+        std::cout << std::endl;
+    }
+
+    if (app.shadowFrames > 0) {
+        std::cout << "shadows: " << app.cascadeRedrawCount << " cascade redraws over " << app.shadowFrames << " frames, "
+                  << app.objects.size() - app.staticCasterCount << " dynamic casters drawn every frame" << std::endl;
+    }
+
+    if (app.timedFrames > 0) {
+        std::cout << "dynamic resolution: " << app.gpuMillisecondsTotal / app.timedFrames << " ms average gpu time against a "
+                  << app.config.targetFrameMilliseconds << " ms target, average scale " << app.scaleTotal / app.timedFrames << ", "
+                  << app.resolutionController.changeCount << " scale changes" << std::endl;
+    }
+
+    if (app.statisticsFrames > 0) {
+        const char* names[PIPELINE_STATISTIC_COUNT] = { "vertex shader invocations", "clipping primitives", "fragment shader invocations" };
+        std::cout << "pipeline statistics, average of " << app.statisticsFrames << " frames" << (app.config.depthPrePass ? " with depth pre-pass" : "") << ":\n";
+        for (uint32_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+            std::cout << "\t" << names[i] << ": " << app.statisticsTotals[i] / app.statisticsFrames << "\n";
+        }
+        std::cout << std::flush;
+    }
 }
 
 void cleanup(HelloTriangleApp& app)
@@ -985,19 +6491,166 @@ void cleanup(HelloTriangleApp& app)
     if (enableValidationLayers) {
         DestroyDebugUtilsMessengerEXT(app.instance, app.debugMessenger, nullptr);
     }
-    for (auto framebuffer : app.swapChainFramebuffers) {
-        vkDestroyFramebuffer(app.device, framebuffer, nullptr);
+    destroySampleCountResources(app);
+    if (app.deferredShading) {
+        vkDestroyImageView(app.device, app.gbufferAlbedoImageView, nullptr);
+        vkDestroyImage(app.device, app.gbufferAlbedoImage, nullptr);
+        vkFreeMemory(app.device, app.gbufferAlbedoImageMemory, nullptr);
+        vkDestroyImageView(app.device, app.gbufferNormalImageView, nullptr);
+        vkDestroyImage(app.device, app.gbufferNormalImage, nullptr);
+        vkFreeMemory(app.device, app.gbufferNormalImageMemory, nullptr);
     }
     for (auto imageView : app.swapChainImageViews) {
         vkDestroyImageView(app.device, imageView, nullptr);
     }
-    vkDestroySemaphore(app.device, app.imageAvailableSemaphore, nullptr);
-    vkDestroySemaphore(app.device, app.imageFinishedSemaphore, nullptr);
-    vkDestroyFence(app.device, app.inFlightFence, nullptr);
+    vkFreeMemory(app.device, app.transientMemory, nullptr);
+    if (app.dynamicResolution) {
+        vkDestroyImageView(app.device, app.offscreenImageView, nullptr);
+        vkDestroyImage(app.device, app.offscreenImage, nullptr);
+        vkDestroyQueryPool(app.device, app.timestampQueryPool, nullptr);
+    }
+    if (app.statisticsQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(app.device, app.statisticsQueryPool, nullptr);
+    }
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroySemaphore(app.device, app.imageAvailableSemaphores[i], nullptr);
+        vkDestroySemaphore(app.device, app.imageFinishedSemaphores[i], nullptr);
+        vkDestroyFence(app.device, app.inFlightFences[i], nullptr);
+        vkDestroyEvent(app.device, app.textureEvents[i], nullptr);
+    }
+    for (auto semaphore : app.cullFinishedSemaphores) {
+        vkDestroySemaphore(app.device, semaphore, nullptr);
+    }
+    if (app.downsamplePipeline != VK_NULL_HANDLE) {
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            for (auto view : app.downsampleViews[i]) {
+                vkDestroyImageView(app.device, view, nullptr);
+            }
+            vkDestroyDescriptorPool(app.device, app.downsampleDescriptorPools[i], nullptr);
+        }
+        vkDestroyBuffer(app.device, app.downsampleCounterBuffer, nullptr);
+        vkFreeMemory(app.device, app.downsampleCounterBufferMemory, nullptr);
+        vkDestroySampler(app.device, app.downsampleSampler, nullptr);
+        vkDestroyPipeline(app.device, app.downsamplePipeline, nullptr);
+        vkDestroyPipelineLayout(app.device, app.downsamplePipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(app.device, app.downsampleSetLayout, nullptr);
+    }
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyBuffer(app.device, app.drawCommandBuffers[i], nullptr);
+            vkFreeMemory(app.device, app.drawCommandBuffersMemory[i], nullptr);
+            vkDestroyBuffer(app.device, app.drawCountBuffers[i], nullptr);
+            vkFreeMemory(app.device, app.drawCountBuffersMemory[i], nullptr);
+            vkDestroyBuffer(app.device, app.visibilityBuffers[i], nullptr);
+            vkFreeMemory(app.device, app.visibilityBuffersMemory[i], nullptr);
+        }
+        if (app.config.occlusionCulling) {
+            vkDestroyDescriptorPool(app.device, app.depthReduceDescriptorPool, nullptr);
+            vkDestroyPipeline(app.device, app.depthReducePipeline, nullptr);
+            vkDestroyPipelineLayout(app.device, app.depthReducePipelineLayout, nullptr);
+            vkDestroyDescriptorSetLayout(app.device, app.depthReduceSetLayout, nullptr);
+        }
+        vkDestroySampler(app.device, app.depthPyramidSampler, nullptr);
+        for (auto levelView : app.depthPyramidLevelViews) {
+            vkDestroyImageView(app.device, levelView, nullptr);
+        }
+        vkDestroyImageView(app.device, app.depthPyramidView, nullptr);
+        vkDestroyImage(app.device, app.depthPyramid, nullptr);
+        vkFreeMemory(app.device, app.depthPyramidMemory, nullptr);
+        vkDestroyBuffer(app.device, app.vertexBuffer, nullptr);
+        vkFreeMemory(app.device, app.vertexBufferMemory, nullptr);
+        vkDestroyBuffer(app.device, app.indexBuffer, nullptr);
+        vkFreeMemory(app.device, app.indexBufferMemory, nullptr);
+        vkDestroyBuffer(app.device, app.objectBuffer, nullptr);
+        vkFreeMemory(app.device, app.objectBufferMemory, nullptr);
+        vkDestroyBuffer(app.device, app.meshInfoBuffer, nullptr);
+        vkFreeMemory(app.device, app.meshInfoBufferMemory, nullptr);
+        vkDestroyBuffer(app.device, app.meshletBuffer, nullptr);
+        vkFreeMemory(app.device, app.meshletBufferMemory, nullptr);
+        vkDestroyDescriptorPool(app.device, app.descriptorPool, nullptr);
+        vkDestroyPipeline(app.device, app.cullPipeline, nullptr);
+        vkDestroyPipelineLayout(app.device, app.cullPipelineLayout, nullptr);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyBuffer(app.device, app.lightBuffers[i], nullptr);
+            vkFreeMemory(app.device, app.lightBuffersMemory[i], nullptr);
+        }
+        if (usesLightClusters(app.config)) {
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                vkDestroyBuffer(app.device, app.clusterBuffers[i], nullptr);
+                vkFreeMemory(app.device, app.clusterBuffersMemory[i], nullptr);
+                vkDestroyBuffer(app.device, app.lightIndexBuffers[i], nullptr);
+                vkFreeMemory(app.device, app.lightIndexBuffersMemory[i], nullptr);
+                vkUnmapMemory(app.device, app.lightOverflowBuffersMemory[i]);
+                vkDestroyBuffer(app.device, app.lightOverflowBuffers[i], nullptr);
+                vkFreeMemory(app.device, app.lightOverflowBuffersMemory[i], nullptr);
+            }
+            vkDestroyPipeline(app.device, app.lightCullPipeline, nullptr);
+            vkDestroyPipelineLayout(app.device, app.lightCullPipelineLayout, nullptr);
+        }
+        if (app.shadows) {
+            for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+                vkDestroyFramebuffer(app.device, app.shadowCacheFramebuffers[i], nullptr);
+                vkDestroyImageView(app.device, app.shadowCacheLayerViews[i], nullptr);
+            }
+            vkDestroyImage(app.device, app.shadowCacheImage, nullptr);
+            vkFreeMemory(app.device, app.shadowCacheImageMemory, nullptr);
+            if (app.shadowMapImage != VK_NULL_HANDLE) {
+                for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+                    vkDestroyFramebuffer(app.device, app.shadowMapFramebuffers[i], nullptr);
+                    vkDestroyImageView(app.device, app.shadowMapLayerViews[i], nullptr);
+                }
+                vkDestroyImage(app.device, app.shadowMapImage, nullptr);
+                vkFreeMemory(app.device, app.shadowMapImageMemory, nullptr);
+            }
+            vkDestroyImageView(app.device, app.shadowSampledView, nullptr);
+            vkDestroyRenderPass(app.device, app.shadowClearRenderPass, nullptr);
+            vkDestroyRenderPass(app.device, app.shadowLoadRenderPass, nullptr);
+            vkDestroyPipeline(app.device, app.shadowPipeline, nullptr);
+            vkDestroyPipelineLayout(app.device, app.shadowPipelineLayout, nullptr);
+        }
+        vkDestroyDescriptorSetLayout(app.device, app.sceneSetLayout, nullptr);
+        for (const auto& texture : app.textures) {
+            destroyTexture(app, texture);
+        }
+        for (const auto& retired : app.retiredTextures) {
+            destroyTexture(app, retired.first);
+        }
+        for (const auto& upload : app.pendingUploads) {
+            destroyTexture(app, upload.texture);
+        }
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkUnmapMemory(app.device, app.textureTableBuffersMemory[i]);
+            vkDestroyBuffer(app.device, app.textureTableBuffers[i], nullptr);
+            vkFreeMemory(app.device, app.textureTableBuffersMemory[i], nullptr);
+        }
+        if (app.textureCacheFile.data != nullptr) {
+            unmapFile(app.textureCacheFile);
+        }
+        vkDestroyDescriptorPool(app.device, app.bindlessDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(app.device, app.bindlessSetLayout, nullptr);
+        vkDestroySampler(app.device, app.bindlessSampler, nullptr);
+        vkDestroySampler(app.device, app.shadowSampler, nullptr);
+    }
+    if (app.config.renderPath == RenderPath::GpuDriven) {
+        for (auto fence : app.stagingRing.fences) {
+            vkDestroyFence(app.device, fence, nullptr);
+        }
+        vkUnmapMemory(app.device, app.stagingRing.memory);
+        vkDestroyBuffer(app.device, app.stagingRing.buffer, nullptr);
+        vkFreeMemory(app.device, app.stagingRing.memory, nullptr);
+    }
+
+    vkUnmapMemory(app.device, app.uploadRing.memory);
+    vkDestroyBuffer(app.device, app.uploadRing.buffer, nullptr);
+    vkFreeMemory(app.device, app.uploadRing.memory, nullptr);
     vkDestroyCommandPool(app.device, app.commandPool, nullptr);
-    vkDestroyRenderPass(app.device, app.renderPass, nullptr);
-    vkDestroyPipeline(app.device, app.graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(app.device, app.pipelineLayout, nullptr);
+    if (app.asyncCompute) {
+        vkDestroyCommandPool(app.device, app.computeCommandPool, nullptr);
+    }
+    if (app.transferUploads) {
+        vkDestroyCommandPool(app.device, app.transferWorker.commandPool, nullptr);
+        vkDestroySemaphore(app.device, app.transferWorker.timeline, nullptr);
+    }
     vkDestroySwapchainKHR(app.device, app.swapChain, nullptr);
     vkDestroySurfaceKHR(app.instance, app.surface, nullptr);
     vkDestroyDevice(app.device, nullptr);
@@ -1006,13 +6659,586 @@ void cleanup(HelloTriangleApp& app)
     glfwTerminate();
 }
 
-int main()
+[[nodiscard]] TextureFormat parseTextureFormat(const std::string& name)
+{
+    for (auto format : { TextureFormat::Rgba8, TextureFormat::Bc1, TextureFormat::Bc3, TextureFormat::Bc5, TextureFormat::Bc7 }) {
+        if (name == getTextureFormatName(format)) {
+            return format;
+        }
+    }
+    throw std::runtime_error("unknown texture format: " + name);
+}
+
+[[nodiscard]] CompressionQuality parseCompressionQuality(const std::string& name)
+{
+    for (auto quality : { CompressionQuality::Fast, CompressionQuality::Default, CompressionQuality::Best }) {
+        if (name == getCompressionQualityName(quality)) {
+            return quality;
+        }
+    }
+    throw std::runtime_error("unknown texture quality: " + name);
+}
+
+[[nodiscard]] MipGeneration parseMipGeneration(const std::string& name)
+{
+    if (name == "cpu") {
+        return MipGeneration::Cpu;
+    } else if (name == "blit") {
+        return MipGeneration::Blit;
+    } else if (name == "compute") {
+        return MipGeneration::Compute;
+    }
+    throw std::runtime_error("unknown mip generation: " + name);
+}
+
+[[nodiscard]] AppConfig parseCommandLine(int argc, char** argv)
+{
+    AppConfig config;
+    config.deviceSelection = readDeviceSelectionVariable();
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--device" && hasValue) {
+            config.deviceSelection = argv[++i];
+        } else if (arg == "--profile-startup") {
+            config.profileStartup = true;
+        } else if (arg == "--instances" && hasValue) {
+            config.instanceCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--gpu-driven") {
+            config.renderPath = RenderPath::GpuDriven;
+        } else if (arg == "--objects" && hasValue) {
+            config.objectCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--clusters") {
+            config.renderPath = RenderPath::GpuDriven;
+            config.clusterCulling = true;
+        } else if (arg == "--packed-vertices") {
+            config.vertexFormat = VertexFormat::Packed;
+        } else if (arg == "--occlusion") {
+            config.renderPath = RenderPath::GpuDriven;
+            config.occlusionCulling = true;
+        } else if (arg == "--async-compute") {
+            config.renderPath = RenderPath::GpuDriven;
+            config.asyncCompute = true;
+        } else if (arg == "--no-transfer-queue") {
+            config.transferQueue = false;
+        } else if (arg == "--lod-threshold" && hasValue) {
+            config.lodThreshold = std::max(0.0f, std::stof(argv[++i]));
+        } else if (arg == "--mesh-cache" && hasValue) {
+            config.meshCachePath = argv[++i];
+            while (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                config.meshSources.push_back(argv[++i]);
+            }
+        } else if (arg == "--build-mesh-cache" && hasValue) {
+            config.buildMeshCachePath = argv[++i];
+            while (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                config.meshSources.push_back(argv[++i]);
+            }
+        } else if (arg == "--bench-mesh-opt") {
+            config.benchmarkMeshOptimization = true;
+            while (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                config.meshSources.push_back(argv[++i]);
+            }
+        } else if (arg == "--lights" && hasValue) {
+            config.renderPath = RenderPath::GpuDriven;
+            config.lightCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--naive-lights") {
+            config.renderPath = RenderPath::GpuDriven;
+            config.naiveLighting = true;
+        } else if (arg == "--deferred") {
+            config.renderPath = RenderPath::GpuDriven;
+            config.deferredShading = true;
+        } else if (arg == "--shadows") {
+            config.renderPath = RenderPath::GpuDriven;
+            config.shadows = true;
+        } else if (arg == "--dynamic-casters" && hasValue) {
+            config.renderPath = RenderPath::GpuDriven;
+            config.shadows = true;
+            config.dynamicCasterCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--sun-speed" && hasValue) {
+            config.sunSpeed = std::stof(argv[++i]);
+        } else if (arg == "--depth-prepass") {
+            config.depthPrePass = true;
+        } else if (arg == "--texture-budget" && hasValue) {
+            config.textureBudget = std::stoull(argv[++i]) * 1024 * 1024;
+        } else if (arg == "--texture-cache" && hasValue) {
+            config.renderPath = RenderPath::GpuDriven;
+            config.textureCachePath = argv[++i];
+        } else if (arg == "--build-texture-cache" && hasValue) {
+            config.buildTextureCachePath = argv[++i];
+        } else if (arg == "--texture-format" && hasValue) {
+            config.textureFormat = parseTextureFormat(argv[++i]);
+        } else if (arg == "--texture-quality" && hasValue) {
+            config.compressionQuality = parseCompressionQuality(argv[++i]);
+        } else if (arg == "--bench-texture-compression") {
+            config.benchmarkTextureCompression = true;
+        } else if (arg == "--msaa" && hasValue) {
+            config.msaaSamples = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (config.msaaSamples == 0 || config.msaaSamples > 64 || (config.msaaSamples & (config.msaaSamples - 1)) != 0) {
+                throw std::runtime_error("msaa sample count must be a power of two up to 64!");
+            }
+        } else if (arg == "--dynamic-resolution" && hasValue) {
+            config.targetFrameMilliseconds = std::max(0.0f, std::stof(argv[++i]));
+        } else if (arg == "--min-render-scale" && hasValue) {
+            config.minRenderScale = std::clamp(std::stof(argv[++i]), 0.1f, 1.0f);
+        } else if (arg == "--mip-generation" && hasValue) {
+            config.mipGeneration = parseMipGeneration(argv[++i]);
+        } else if (arg == "--bench-mipgen") {
+            config.benchmarkMipGeneration = true;
+        } else if (arg == "--pipeline-stats") {
+            config.pipelineStatistics = true;
+        } else if (arg == "--bench-culling") {
+            config.benchmarkCulling = true;
+        } else if (arg == "--benchmark") {
+            config.benchmark = true;
+        } else if (arg == "--frames" && hasValue) {
+            config.benchmarkFrames = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else {
+            throw std::runtime_error("unknown argument: " + arg);
+        }
+    }
+
+    // the benchmark needs the downsampler, blits need nothing created
+    if (config.benchmarkMipGeneration) {
+        config.mipGeneration = MipGeneration::Compute;
+    }
+
+    if (config.instanceCount * sizeof(InstanceData) > UPLOAD_RING_FRAME_SIZE) {
+        throw std::runtime_error("too many instances for the upload ring!");
+    }
+
+    // texture streaming keeps the other half of the ring
+    if (config.shadows && config.objectCount * SHADOW_CASCADE_COUNT * sizeof(VkDrawIndexedIndirectCommand) > UPLOAD_RING_FRAME_SIZE / 2) {
+        throw std::runtime_error("too many objects for the shadow draws in the upload ring!");
+    }
+
+    return config;
+}
+
+// culls --objects random spheres against a fixed camera, no window or device
+// needed. the scalar glm loop is the baseline the simd kernels are measured
+// against
+void runCullingBenchmark(const AppConfig& config)
+{
+    uint32_t count = config.objectCount;
+    uint32_t iterations = config.benchmarkFrames;
+    float sceneSize = 4.0f * std::cbrt(static_cast<float>(count));
+
+    std::mt19937 random(1337);
+    std::uniform_real_distribution<float> position(-0.5f * sceneSize, 0.5f * sceneSize);
+    std::uniform_real_distribution<float> radius(0.25f, 1.0f);
+
+    std::vector<glm::vec4> spheres(count);
+    SphereBounds sphereBounds;
+    AabbBounds aabbBounds;
+    for (auto& sphere : spheres) {
+        sphere = glm::vec4(position(random), position(random), position(random), radius(random));
+        sphereBounds.add(sphere);
+        aabbBounds.add(glm::vec3(sphere) - sphere.w, glm::vec3(sphere) + sphere.w);
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, sceneSize);
+    FrustumPlanes planes = extractFrustumPlanes(proj * view);
+
+    uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> visible;
+    std::vector<std::vector<uint32_t>> visibleChunks(threadCount);
+    for (auto& chunk : visibleChunks) {
+        chunk.reserve(count / threadCount + 8);
+    }
+    visible.reserve(count);
+
+    // started before the clock, only the culling itself is timed
+    CullingWorkers workers;
+    startCullingWorkers(workers, threadCount - 1);
+
+    auto measure = [&](const char* name, auto&& cull) {
+        auto start = std::chrono::steady_clock::now();
+        size_t visibleCount = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            visible.clear();
+            visibleCount = cull();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "\t" << name << ": " << seconds * 1000.0 / iterations << " ms/pass, "
+                  << static_cast<double>(count) * iterations / seconds / 1e6 << " million/s, "
+                  << visibleCount << " visible\n";
+        return seconds;
+    };
+
+    std::cout << "culling benchmark: " << count << " volumes, " << iterations << " passes, "
+              << getCullingKernelName() << " kernels, " << threadCount << " threads\n";
+
+    double scalarSeconds = measure("scalar vec4 spheres", [&] {
+        cullSpheresScalar(planes, spheres, visible);
+        return visible.size();
+    });
+    double simdSeconds = measure("soa spheres", [&] {
+        cullSpheres(planes, sphereBounds, 0, count, visible);
+        return visible.size();
+    });
+    measure("soa aabbs", [&] {
+        cullAabbs(planes, aabbBounds, 0, count, visible);
+        return visible.size();
+    });
+    double parallelSeconds = measure("soa spheres, parallel", [&] {
+        cullSpheresParallel(workers, planes, sphereBounds, visibleChunks);
+        size_t visibleCount = 0;
+        for (const auto& chunk : visibleChunks) {
+            visibleCount += chunk.size();
+        }
+        return visibleCount;
+    });
+    stopCullingWorkers(workers);
+
+    std::cout << "\tsoa speedup: " << scalarSeconds / simdSeconds << "x, parallel speedup: " << scalarSeconds / parallelSeconds << "x" << std::endl;
+}
+
+// imports every source mesh, or the built in ones when there are none, and
+// writes them out together with their lod chains
+void buildMeshCache(const AppConfig& config)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<MeshData> meshes;
+    for (const auto& source : config.meshSources) {
+        meshes.push_back(loadObjMesh(source));
+    }
+    if (meshes.empty()) {
+        meshes = makeBuiltinMeshes();
+    }
+
+    SceneGeometry geometry = buildSceneGeometry(meshes, config.vertexFormat);
+    writeMeshCache(config.buildMeshCachePath, geometry);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "wrote " << config.buildMeshCachePath << ": " << geometry.meshes.size() << " meshes, " << geometry.vertexCount << " "
+              << getVertexFormatName(geometry.vertexFormat) << " vertices, "
+              << geometry.indices.size() / 3 << " triangles including lods in " << seconds << " s" << std::endl;
+}
+
+// runs the import optimization passes one by one and reports how the vertex
+// cache behaves after each. without sources the built in meshes are used,
+// plus an icosphere with shuffled triangles standing in for exporter output
+void runMeshOptimizationBenchmark(const AppConfig& config)
+{
+    std::vector<std::pair<std::string, MeshData>> meshes;
+    for (const auto& source : config.meshSources) {
+        meshes.emplace_back(source, loadObjMesh(source));
+    }
+    if (meshes.empty()) {
+        meshes.emplace_back("cube", makeCubeMesh());
+        meshes.emplace_back("icosphere", makeIcosphereMesh(6));
+
+        MeshData shuffled = makeIcosphereMesh(6);
+        std::vector<uint32_t> order(shuffled.indices.size() / 3);
+        for (uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937(1337));
+
+        std::vector<uint32_t> indices;
+        indices.reserve(shuffled.indices.size());
+        for (uint32_t t : order) {
+            indices.insert(indices.end(), shuffled.indices.begin() + t * 3, shuffled.indices.begin() + t * 3 + 3);
+        }
+        shuffled.indices = std::move(indices);
+        meshes.emplace_back("shuffled icosphere", std::move(shuffled));
+    }
+
+    auto report = [](const char* stage, const MeshData& mesh, double seconds) {
+        VertexCacheStats stats = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+        std::cout << "\t" << stage << ": acmr " << stats.acmr << ", atvr " << stats.atvr;
+        if (seconds > 0.0) {
+            std::cout << ", " << seconds * 1000.0 << " ms";
+        }
+        std::cout << "\n";
+    };
+
+    for (auto& [name, mesh] : meshes) {
+        std::cout << name << ": " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles\n";
+        report("input", mesh, 0.0);
+
+        auto start = std::chrono::steady_clock::now();
+        optimizeVertexCache(mesh.indices, mesh.vertices.size());
+        auto cacheDone = std::chrono::steady_clock::now();
+        report("vertex cache", mesh, std::chrono::duration<double>(cacheDone - start).count());
+
+        optimizeOverdraw(mesh.indices, mesh);
+        auto overdrawDone = std::chrono::steady_clock::now();
+        report("overdraw", mesh, std::chrono::duration<double>(overdrawDone - cacheDone).count());
+
+        optimizeVertexFetch(mesh);
+        auto fetchDone = std::chrono::steady_clock::now();
+        report("vertex fetch", mesh, std::chrono::duration<double>(fetchDone - overdrawDone).count());
+    }
+    std::cout << std::flush;
+}
+
+// encodes every mip of the built in textures, all cores work on one mip at
+// a time
+void buildTextureCache(const AppConfig& config)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    TextureCacheData cache;
+    cache.format = config.textureFormat;
+    uint64_t pixelCount = 0;
+    double totalError = 0.0;
+    uint32_t mipTotal = 0;
+
+    for (const auto& source : makeBuiltinTextureSources()) {
+        TextureCacheTexture texture {};
+        texture.width = source.width;
+        texture.height = source.height;
+        texture.mipCount = getMipCount(source.width, source.height);
+
+        for (uint32_t mip = 0; mip < texture.mipCount; mip++) {
+            uint32_t width = std::max(1u, source.width >> mip);
+            uint32_t height = std::max(1u, source.height >> mip);
+            std::vector<uint32_t> pixels = generateTextureMip(source, mip);
+
+            texture.mipOffsets[mip] = cache.data.size();
+            cache.data.resize(cache.data.size() + getTextureMipBytes(cache.format, width, height));
+            totalError += compressTexture(pixels.data(), width, height, cache.format, config.compressionQuality,
+                cache.data.data() + texture.mipOffsets[mip], threadCount);
+            pixelCount += static_cast<uint64_t>(width) * height;
+            mipTotal++;
+        }
+        cache.textures.push_back(texture);
+    }
+
+    writeTextureCache(config.buildTextureCachePath, cache);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "wrote " << config.buildTextureCachePath << ": " << cache.textures.size() << " " << getTextureFormatName(cache.format)
+              << " textures, " << cache.data.size() / (1024 * 1024) << " MB, mean squared error " << totalError / mipTotal << " in "
+              << seconds << " s (" << pixelCount / seconds / 1e6 << " megapixels/s)" << std::endl;
+}
+
+// noise, gradients and hard edges, which is harder on the encoders than the
+// built in checkerboards
+[[nodiscard]] std::vector<uint32_t> makeCompressionTestImage(uint32_t size)
+{
+    std::vector<uint32_t> pixels(size * size);
+    std::mt19937 random(1337);
+
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            float u = x / static_cast<float>(size);
+            float v = y / static_cast<float>(size);
+            uint32_t noise = random() & 0x1f;
+
+            uint32_t r = static_cast<uint32_t>(127.5f + 127.5f * std::sin(u * 40.0f + v * 7.0f));
+            uint32_t g = static_cast<uint32_t>(v * 255.0f);
+            uint32_t b = std::min(255u, ((x / 32 + y / 32) % 2 == 0 ? 200u : 40u) + noise);
+            uint32_t a = static_cast<uint32_t>(127.5f + 127.5f * std::cos(v * 20.0f));
+            pixels[y * size + x] = a << 24 | b << 16 | g << 8 | r;
+        }
+    }
+
+    return pixels;
+}
+
+void runTextureCompressionBenchmark()
+{
+    const uint32_t size = 1024;
+    std::vector<uint32_t> pixels = makeCompressionTestImage(size);
+    uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    double megapixels = size * size / 1e6;
+
+    std::cout << "texture compression benchmark: " << size << "x" << size << " image, " << getCompressionKernelName() << " kernels, "
+              << threadCount << " threads\n";
+
+    for (auto format : { TextureFormat::Bc1, TextureFormat::Bc3, TextureFormat::Bc5, TextureFormat::Bc7 }) {
+        std::vector<uint8_t> output(getTextureMipBytes(format, size, size));
+
+        for (auto quality : { CompressionQuality::Fast, CompressionQuality::Default, CompressionQuality::Best }) {
+            auto measure = [&](uint32_t threads, double& error) {
+                auto start = std::chrono::steady_clock::now();
+                error = compressTexture(pixels.data(), size, size, format, quality, output.data(), threads);
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            };
+
+            double error = 0.0;
+            double singleSeconds = measure(1, error);
+            double parallelSeconds = measure(threadCount, error);
+            double psnr = 10.0 * std::log10(255.0 * 255.0 / std::max(error, 1e-6));
+
+            std::cout << "\t" << getTextureFormatName(format) << " " << getCompressionQualityName(quality) << ": "
+                      << megapixels / singleSeconds << " megapixels/s on one thread, " << megapixels / parallelSeconds << " on all, "
+                      << psnr << " dB psnr\n";
+        }
+    }
+    std::cout << std::flush;
+}
+
+// builds the full chain below a 4096x4096 level 0 with both gpu methods and
+// times them with timestamp queries. worth running on a software driver too,
+// where blits are often the slow path
+void runMipGenerationBenchmark(HelloTriangleApp& app)
+{
+    const uint32_t size = MAX_DOWNSAMPLE_SIZE;
+    uint32_t levelCount = getMipCount(size, size);
+    uint32_t iterations = std::min(app.config.benchmarkFrames, 100u);
+
+    if (!app.deviceProfile.timestampComputeAndGraphics) {
+        throw std::runtime_error("device can't write timestamps!");
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2;
+
+    VkQueryPool queryPool;
+    auto result = vkCreateQueryPool(app.device, &queryPoolInfo, nullptr, &queryPool);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create query pool!");
+    }
+
+    VkImage image;
+    VkDeviceMemory imageMemory;
+    createImage(app, size, size, levelCount, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT, image, imageMemory);
+
+    std::vector<uint32_t> pixels = makeCompressionTestImage(size);
+    VkDeviceSize imageBytes = pixels.size() * sizeof(uint32_t);
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(app, imageBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(app.device, stagingBufferMemory, 0, imageBytes, 0, &data);
+    std::memcpy(data, pixels.data(), static_cast<size_t>(imageBytes));
+    vkUnmapMemory(app.device, stagingBufferMemory);
+
+    uint64_t handle = getTrackedHandle(image);
+    trackImage(app.barrierTracker, handle, levelCount, VK_IMAGE_LAYOUT_UNDEFINED);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+
+    useImage(app.barrierTracker, handle, 0, 1, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+    recordTrackedBarriers(app, commandBuffer);
+
+    VkBufferImageCopy region {};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { size, size, 1 };
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    releaseImage(app.barrierTracker, handle, 0, 1, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    recordReleasedBarriers(app, commandBuffer);
+
+    endSingleTimeCommands(app, commandBuffer);
+
+    vkDestroyBuffer(app.device, stagingBuffer, nullptr);
+    vkFreeMemory(app.device, stagingBufferMemory, nullptr);
+
+    std::cout << "mip generation benchmark: " << levelCount - 1 << " mips below " << size << "x" << size << ", " << iterations << " runs on "
+              << app.deviceProfile.name << "\n";
+
+    auto measure = [&](const char* name, MipGeneration method) {
+        app.mipGeneration = method;
+        double totalMilliseconds = 0.0;
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            commandBuffer = beginSingleTimeCommands(app);
+            vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+
+            // every run starts from the state a streamed texture is in, with
+            // level 0 just uploaded. the other levels are moved out of
+            // whatever the last run left them in as they are written, as a
+            // new texture's would be out of UNDEFINED
+            useImage(app.barrierTracker, handle, 0, 1, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+            recordTrackedBarriers(app, commandBuffer);
+
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+            recordMipGeneration(app, commandBuffer, image, size, size, levelCount);
+            releaseImage(app.barrierTracker, handle, 0, levelCount, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            recordReleasedBarriers(app, commandBuffer);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+
+            endSingleTimeCommands(app, commandBuffer);
+            resetDownsampleFrame(app);
+
+            std::array<uint64_t, 2> timestamps {};
+            result = vkGetQueryPoolResults(app.device, queryPool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("failed to read timestamps!");
+            }
+            totalMilliseconds += (timestamps[1] - timestamps[0]) * app.deviceProfile.timestampPeriod / 1e6;
+        }
+
+        double milliseconds = totalMilliseconds / iterations;
+        std::cout << "\t" << name << ": " << milliseconds << " ms/chain\n";
+        return milliseconds;
+    };
+
+    double blitMilliseconds = 0.0;
+    double computeMilliseconds = 0.0;
+    if (app.deviceProfile.blitMipGeneration) {
+        blitMilliseconds = measure("blit chain", MipGeneration::Blit);
+    } else {
+        std::cout << "\tblit chain: no linear filtered blits on this device\n";
+    }
+    if (app.downsamplePipeline != VK_NULL_HANDLE) {
+        computeMilliseconds = measure("single pass downsampler", MipGeneration::Compute);
+    } else {
+        std::cout << "\tsingle pass downsampler: unsupported on this device\n";
+    }
+    if (blitMilliseconds > 0.0 && computeMilliseconds > 0.0) {
+        std::cout << "\tdownsampler speedup: " << blitMilliseconds / computeMilliseconds << "x\n";
+    }
+    std::cout << std::flush;
+
+    forgetImage(app.barrierTracker, handle);
+    vkDestroyImage(app.device, image, nullptr);
+    vkFreeMemory(app.device, imageMemory, nullptr);
+    vkDestroyQueryPool(app.device, queryPool, nullptr);
+}
+
+int main(int argc, char** argv)
 {
     try {
         HelloTriangleApp app;
+        app.config = parseCommandLine(argc, argv);
+        if (app.config.benchmarkCulling) {
+            runCullingBenchmark(app.config);
+            return 0;
+        }
+        if (app.config.benchmarkMeshOptimization) {
+            runMeshOptimizationBenchmark(app.config);
+            return 0;
+        }
+        if (!app.config.buildMeshCachePath.empty()) {
+            buildMeshCache(app.config);
+            return 0;
+        }
+        if (app.config.benchmarkTextureCompression) {
+            runTextureCompressionBenchmark();
+            return 0;
+        }
+        if (!app.config.buildTextureCachePath.empty()) {
+            buildTextureCache(app.config);
+            return 0;
+        }
+
+        beginStartupProfile(app.startupProfiler);
         initWindow(app);
+        markStartupPhase(app.startupProfiler, "window");
         initVulkan(app);
-        mainLoop(app);
+        if (app.config.benchmarkMipGeneration) {
+            runMipGenerationBenchmark(app);
+        } else {
+            mainLoop(app);
+        }
         cleanup(app);
 
     } catch (const std::exception& e) {
@@ -1021,4 +7247,4 @@ int main()
     }
 
     return 0;
-}
\ No newline at end of file
+}
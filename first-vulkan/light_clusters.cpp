@@ -0,0 +1,58 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+std::vector<SceneLight> makeSceneLights(uint32_t count, float sceneSize, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<SceneLight> lights(count);
+    for (auto& light : lights) {
+        light.center = (glm::vec3(unit(random), unit(random), unit(random)) - 0.5f) * sceneSize;
+        light.orbitRadius = 0.5f + 2.0f * unit(random);
+        light.orbitSpeed = (unit(random) - 0.5f) * 2.0f;
+        light.phase = unit(random) * 6.2831853f;
+        light.range = 2.0f + 4.0f * unit(random);
+
+        // saturated colors, so overlapping lights are easy to tell apart
+        glm::vec3 color(unit(random), unit(random), unit(random));
+        light.color = color / std::max(std::max(color.x, color.y), std::max(color.z, 0.01f)) * 2.0f;
+
+        light.spot = unit(random) < 0.25f;
+        float outerAngle = 0.3f + 0.5f * unit(random);
+        light.cosOuter = light.spot ? std::cos(outerAngle) : -2.0f;
+        light.cosInner = light.spot ? std::cos(outerAngle * 0.7f) : -1.0f;
+        // a spot light reaches further along its cone
+        light.range *= light.spot ? 2.0f : 1.0f;
+    }
+    return lights;
+}
+
+void animateLights(const std::vector<SceneLight>& lights, float time, LightData* out)
+{
+    for (size_t i = 0; i < lights.size(); i++) {
+        const SceneLight& light = lights[i];
+        float angle = light.phase + time * light.orbitSpeed;
+        glm::vec3 offset(std::cos(angle), 0.0f, std::sin(angle));
+        glm::vec3 position = light.center + offset * light.orbitRadius;
+
+        // along the tangent of the orbit, tilted down
+        glm::vec3 direction = glm::vec3(-offset.z, -1.0f, offset.x) * 0.70710678f;
+
+        out[i].positionRange = glm::vec4(position, light.range);
+        out[i].colorCosInner = glm::vec4(light.color, light.cosInner);
+        out[i].directionCosOuter = glm::vec4(direction, light.cosOuter);
+    }
+}
+
+ClusterSlicing getClusterSlicing(float nearPlane, float farPlane)
+{
+    float logRatio = std::log(farPlane / nearPlane);
+    ClusterSlicing slicing {};
+    slicing.scale = CLUSTER_GRID_Z / logRatio;
+    slicing.bias = CLUSTER_GRID_Z * std::log(nearPlane) / logRatio;
+    return slicing;
+}
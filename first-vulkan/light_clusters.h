@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+// the view frustum is cut into CLUSTER_GRID_X by CLUSTER_GRID_Y screen tiles,
+// each split into CLUSTER_GRID_Z depth slices spaced exponentially between
+// the near and the far plane, so clusters stay roughly cube shaped. mirrors
+// the defines in shaders/common.glsl
+const uint32_t CLUSTER_GRID_X = 16;
+const uint32_t CLUSTER_GRID_Y = 9;
+const uint32_t CLUSTER_GRID_Z = 24;
+const uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+// each cluster has a fixed range of the light index buffer, lights past it
+// are dropped from the cluster
+const uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+
+// mirrors LightData in shaders/common.glsl. point lights have a cone that
+// covers everything
+struct LightData {
+    // xyz is the position, w the range
+    glm::vec4 positionRange;
+    // rgb is the color times intensity, w the cosine of the inner cone angle
+    glm::vec4 colorCosInner;
+    // xyz is the spot direction, w the cosine of the outer cone angle
+    glm::vec4 directionCosOuter;
+};
+
+// a light as generated, animateLights moves it along a circle around center
+struct SceneLight {
+    glm::vec3 center;
+    float orbitRadius;
+    // radians per second
+    float orbitSpeed;
+    float phase;
+    float range;
+    glm::vec3 color;
+    bool spot;
+    float cosInner;
+    float cosOuter;
+};
+
+// spread over the same cube as the scene objects, about a quarter are spot
+// lights
+[[nodiscard]] std::vector<SceneLight> makeSceneLights(uint32_t count, float sceneSize, uint32_t seed);
+
+// writes where the lights are at time, front to back so it can go straight
+// into write combined memory. spot lights point along their orbit and down
+void animateLights(const std::vector<SceneLight>& lights, float time, LightData* out);
+
+// slice = log(depth) * scale - bias, so slice s begins at depth
+// exp((s + bias) / scale)
+struct ClusterSlicing {
+    float scale;
+    float bias;
+};
+
+[[nodiscard]] ClusterSlicing getClusterSlicing(float nearPlane, float farPlane);
@@ -0,0 +1,137 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <unordered_map>
+
+MeshData makeCubeMesh()
+{
+    // normal and the "right" axis of every face, up is normal x right
+    const glm::vec3 faces[6][2] = {
+        { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+        { { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+        { { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+        { { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+        { { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f } },
+        { { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f } },
+    };
+
+    const glm::vec2 corners[4] = {
+        { -1.0f, -1.0f },
+        { 1.0f, -1.0f },
+        { 1.0f, 1.0f },
+        { -1.0f, 1.0f },
+    };
+
+    MeshData mesh;
+    for (const auto& face : faces) {
+        glm::vec3 normal = face[0];
+        glm::vec3 right = face[1];
+        glm::vec3 up = glm::cross(normal, right);
+
+        uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+        for (const auto& corner : corners) {
+            Vertex vertex {};
+            vertex.position = 0.5f * (normal + corner.x * right + corner.y * up);
+            vertex.normal = normal;
+            vertex.uv = corner * 0.5f + 0.5f;
+            mesh.vertices.push_back(vertex);
+        }
+
+        mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 2, base + 2, base + 3, base });
+    }
+
+    return mesh;
+}
+
+MeshData makeIcosphereMesh(uint32_t subdivisions)
+{
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+
+    std::vector<glm::vec3> positions = {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+        { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+        { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+    };
+
+    std::vector<uint32_t> indices = {
+        0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+        1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+        4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+    };
+
+    for (auto& position : positions) {
+        position = glm::normalize(position);
+    }
+
+    for (uint32_t level = 0; level < subdivisions; level++) {
+        // edges are shared by two triangles, so midpoints are cached by edge
+        std::unordered_map<uint64_t, uint32_t> midpoints;
+        auto midpoint = [&](uint32_t a, uint32_t b) {
+            uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+            auto it = midpoints.find(key);
+            if (it != midpoints.end()) {
+                return it->second;
+            }
+
+            uint32_t index = static_cast<uint32_t>(positions.size());
+            positions.push_back(glm::normalize(positions[a] + positions[b]));
+            midpoints.emplace(key, index);
+            return index;
+        };
+
+        std::vector<uint32_t> subdivided;
+        subdivided.reserve(indices.size() * 4);
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            uint32_t a = indices[i + 0];
+            uint32_t b = indices[i + 1];
+            uint32_t c = indices[i + 2];
+            uint32_t ab = midpoint(a, b);
+            uint32_t bc = midpoint(b, c);
+            uint32_t ca = midpoint(c, a);
+
+            subdivided.insert(subdivided.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+        }
+        indices = std::move(subdivided);
+    }
+
+    const float pi = 3.14159265358979f;
+
+    MeshData mesh;
+    mesh.vertices.reserve(positions.size());
+    for (const auto& position : positions) {
+        Vertex vertex {};
+        vertex.position = position * 0.5f;
+        vertex.normal = position;
+        vertex.uv = glm::vec2(std::atan2(position.z, position.x) / (2.0f * pi) + 0.5f, std::acos(position.y) / pi);
+        mesh.vertices.push_back(vertex);
+    }
+    mesh.indices = std::move(indices);
+
+    return mesh;
+}
+
+glm::vec4 computeBoundingSphere(const MeshData& mesh)
+{
+    if (mesh.vertices.empty()) {
+        return glm::vec4(0.0f);
+    }
+
+    glm::vec3 minBounds = mesh.vertices[0].position;
+    glm::vec3 maxBounds = mesh.vertices[0].position;
+    for (const auto& vertex : mesh.vertices) {
+        minBounds = glm::min(minBounds, vertex.position);
+        maxBounds = glm::max(maxBounds, vertex.position);
+    }
+
+    glm::vec3 center = (minBounds + maxBounds) * 0.5f;
+    float radius = 0.0f;
+    for (const auto& vertex : mesh.vertices) {
+        radius = std::max(radius, glm::length(vertex.position - center));
+    }
+
+    return glm::vec4(center, radius);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// all generated meshes are centered on the origin, fit in the unit cube and use
+// counter clockwise winding for front faces
+[[nodiscard]] MeshData makeCubeMesh();
+[[nodiscard]] MeshData makeIcosphereMesh(uint32_t subdivisions);
+
+// xyz is the center, w the radius
+[[nodiscard]] glm::vec4 computeBoundingSphere(const MeshData& mesh);
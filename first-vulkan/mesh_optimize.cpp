@@ -0,0 +1,327 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <limits>
+
+namespace {
+
+// a fifo cache with timestamps instead of an actual queue, a vertex is cached
+// while fewer than cacheSize misses happened since it was loaded. returns
+// true and loads the vertex on a miss
+[[nodiscard]] bool missVertexCache(std::vector<uint64_t>& loadedAt, uint64_t& misses, uint32_t index, uint32_t cacheSize)
+{
+    if (loadedAt[index] != 0 && misses - loadedAt[index] < cacheSize) {
+        return false;
+    }
+    misses++;
+    loadedAt[index] = misses;
+    return true;
+}
+
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+    std::vector<uint64_t> loadedAt(vertexCount, 0);
+    uint64_t misses = 0;
+
+    for (uint32_t index : indices) {
+        (void)missVertexCache(loadedAt, misses, index, cacheSize);
+    }
+
+    size_t triangleCount = indices.size() / 3;
+    VertexCacheStats stats {};
+    stats.acmr = triangleCount ? static_cast<float>(misses) / triangleCount : 0.0f;
+    stats.atvr = vertexCount ? static_cast<float>(misses) / vertexCount : 0.0f;
+    return stats;
+}
+
+namespace {
+
+const int FORSYTH_CACHE_SIZE = 32;
+
+[[nodiscard]] float forsythVertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // used by the last triangle, deliberately not the best choice so
+            // strips don't run away in one direction
+            score = 0.75f;
+        } else {
+            float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+
+    // finishes off vertices with few triangles left so they can leave the cache
+    score += 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+    return score;
+}
+
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // vertex to triangle adjacency as one flat array
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices) {
+        remaining[index]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (int i = 0; i < 3; i++) {
+            adjacency[fill[indices[t * 3 + i]]++] = t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    // one spare slot per triangle corner for vertices about to be pushed out
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    size_t scanCursor = 0;
+    uint32_t best = static_cast<uint32_t>(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+    while (true) {
+        emitted[best] = true;
+        uint32_t triangle[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // the emitted triangle's vertices go to the front of the cache
+        nextCache.assign(triangle, triangle + 3);
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                nextCache.push_back(v);
+            }
+        }
+
+        for (uint32_t v : triangle) {
+            remaining[v]--;
+            uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+            uint32_t* end = begin + remaining[v] + 1;
+            *std::find(begin, end, best) = *(end - 1);
+        }
+
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint32_t v = nextCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // only triangles touching the cache changed score, the best of them
+        // is the next triangle
+        best = std::numeric_limits<uint32_t>::max();
+        float bestScore = -1.0f;
+        for (uint32_t v : nextCache) {
+            for (uint32_t i = adjacencyOffsets[v]; i < adjacencyOffsets[v] + remaining[v]; i++) {
+                uint32_t t = adjacency[i];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+                if (score > bestScore) {
+                    best = t;
+                    bestScore = score;
+                }
+            }
+        }
+
+        if (nextCache.size() > FORSYTH_CACHE_SIZE) {
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        std::swap(cache, nextCache);
+
+        // nothing left around the cache, restart from the first triangle that
+        // hasn't been emitted, a full search would make this quadratic
+        if (best == std::numeric_limits<uint32_t>::max()) {
+            while (scanCursor < triangleCount && emitted[scanCursor]) {
+                scanCursor++;
+            }
+            if (scanCursor == triangleCount) {
+                break;
+            }
+            best = static_cast<uint32_t>(scanCursor);
+        }
+    }
+
+    indices = std::move(result);
+}
+
+namespace {
+
+// walks the triangles with the same cache as analyzeVertexCache and cuts a
+// cluster wherever a triangle misses on all three vertices, those cuts cost
+// nothing. clusters of at least minSoftTriangles are also cut once they are
+// as cache friendly as acmrLimit allows, which keeps them small enough to sort
+[[nodiscard]] std::vector<uint32_t> findClusterStarts(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize, float acmrLimit, uint32_t minSoftTriangles)
+{
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint64_t> loadedAt(vertexCount, 0);
+    uint64_t misses = 0;
+    uint64_t clusterMisses = 0;
+    uint32_t clusterTriangles = 0;
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        uint32_t triangleMisses = 0;
+        for (int i = 0; i < 3; i++) {
+            if (missVertexCache(loadedAt, misses, indices[t * 3 + i], cacheSize)) {
+                triangleMisses++;
+            }
+        }
+
+        bool hardBoundary = triangleMisses == 3;
+        bool softBoundary = clusterTriangles >= minSoftTriangles && static_cast<float>(clusterMisses) / clusterTriangles <= acmrLimit;
+        if (t == 0 || hardBoundary || softBoundary) {
+            clusterStarts.push_back(t);
+            clusterMisses = 0;
+            clusterTriangles = 0;
+        }
+        clusterMisses += triangleMisses;
+        clusterTriangles++;
+    }
+    clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+    return clusterStarts;
+}
+
+// clusters facing away from the center are on the outside and likely to
+// occlude the rest, so they go first
+[[nodiscard]] std::vector<uint32_t> sortClusters(const std::vector<uint32_t>& indices, const MeshData& mesh, const std::vector<uint32_t>& clusterStarts)
+{
+    size_t triangleCount = indices.size() / 3;
+
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        glm::vec3 a = mesh.vertices[indices[t * 3]].position;
+        glm::vec3 b = mesh.vertices[indices[t * 3 + 1]].position;
+        glm::vec3 c = mesh.vertices[indices[t * 3 + 2]].position;
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCenter += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    meshCenter = meshArea > 0.0f ? meshCenter / meshArea : glm::vec3(0.0f);
+
+    size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 center(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+            glm::vec3 p0 = mesh.vertices[indices[t * 3]].position;
+            glm::vec3 p1 = mesh.vertices[indices[t * 3 + 1]].position;
+            glm::vec3 p2 = mesh.vertices[indices[t * 3 + 2]].position;
+            glm::vec3 weightedNormal = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(weightedNormal);
+            center += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += weightedNormal;
+            area += triangleArea;
+        }
+        center = area > 0.0f ? center / area : center;
+        float normalLength = glm::length(normal);
+        normal = normalLength > 0.0f ? normal / normalLength : normal;
+        sortKeys[c] = glm::dot(center - meshCenter, normal);
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    for (uint32_t c = 0; c < clusterCount; c++) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t c : order) {
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+    }
+    return result;
+}
+
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const MeshData& mesh, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    const uint32_t cacheSize = 16;
+    float acmrLimit = analyzeVertexCache(indices, mesh.vertices.size(), cacheSize).acmr * threshold;
+
+    // every cluster starts with a cold cache once reordered, so smaller
+    // clusters sort better but cost more. grow them until the result stays
+    // within the threshold, in the end only the free hard boundaries are left
+    for (uint32_t minSoftTriangles = 16;; minSoftTriangles *= 2) {
+        bool softCuts = minSoftTriangles < triangleCount;
+        std::vector<uint32_t> clusterStarts = findClusterStarts(indices, mesh.vertices.size(), cacheSize, acmrLimit,
+            softCuts ? minSoftTriangles : std::numeric_limits<uint32_t>::max());
+        std::vector<uint32_t> sorted = sortClusters(indices, mesh, clusterStarts);
+
+        if (analyzeVertexCache(sorted, mesh.vertices.size(), cacheSize).acmr <= acmrLimit) {
+            indices = std::move(sorted);
+            return;
+        }
+        if (!softCuts) {
+            return;
+        }
+    }
+}
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (auto& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh.vertices = std::move(vertices);
+}
+
+void optimizeMesh(MeshData& mesh)
+{
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh);
+    optimizeVertexFetch(mesh);
+}
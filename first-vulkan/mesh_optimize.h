@@ -0,0 +1,34 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats {
+    // average cache miss ratio, vertex shader invocations per triangle.
+    // 0.5 is the ideal for a large regular grid, 3 means no reuse at all
+    float acmr;
+    // average transform to vertex ratio, 1 means every vertex is shaded once
+    float atvr;
+};
+
+// simulates a fifo post transform cache, 16 entries is close enough to what
+// current gpus behave like
+[[nodiscard]] VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// forsyth's linear speed vertex cache optimization, reorders triangles only
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// splits cache optimized triangles into clusters where the cache is cold
+// anyway and orders the clusters from the outside of the mesh in, so front
+// most surfaces tend to be drawn first. threshold is how much worse than the
+// input the acmr is allowed to get, 1.05 gives up at most 5%
+void optimizeOverdraw(std::vector<uint32_t>& indices, const MeshData& mesh, float threshold = 1.05f);
+
+// reorders vertices by first use so fetches walk memory linearly, drops
+// unreferenced vertices and remaps indices to match
+void optimizeVertexFetch(MeshData& mesh);
+
+// all three passes in order, what the importer runs on every mesh
+void optimizeMesh(MeshData& mesh);
@@ -0,0 +1,316 @@
+#include "mesh_simplify.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <glm/geometric.hpp>
+#include <queue>
+#include <unordered_map>
+
+namespace {
+
+// symmetric 4x4 matrix, only the upper triangle is stored
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    void addPlane(const glm::dvec3& n, double d)
+    {
+        a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z; a03 += n.x * d;
+        a11 += n.y * n.y; a12 += n.y * n.z; a13 += n.y * d;
+        a22 += n.z * n.z; a23 += n.z * d;
+        a33 += d * d;
+    }
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+        a11 += other.a11; a12 += other.a12; a13 += other.a13;
+        a22 += other.a22; a23 += other.a23;
+        a33 += other.a33;
+        return *this;
+    }
+
+    // sum of the squared distances from p to every accumulated plane
+    [[nodiscard]] double evaluate(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+            + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+            + a22 * z * z + 2 * a23 * z
+            + a33;
+    }
+};
+
+struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const
+    {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+[[nodiscard]] uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+}
+
+std::vector<uint32_t> simplifyMesh(const MeshData& mesh, size_t targetIndexCount, float* resultError)
+{
+    size_t vertexCount = mesh.vertices.size();
+    size_t triangleCount = mesh.indices.size() / 3;
+
+    // collapses work on positions, so vertices that only differ in their
+    // attributes are welded first
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> weldMap;
+    std::vector<uint32_t> welded(vertexCount);
+    std::vector<uint32_t> representative;
+    std::vector<uint32_t> weldCount;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        auto [it, inserted] = weldMap.emplace(mesh.vertices[v].position, static_cast<uint32_t>(representative.size()));
+        if (inserted) {
+            representative.push_back(v);
+            weldCount.push_back(0);
+        }
+        welded[v] = it->second;
+        weldCount[it->second]++;
+    }
+
+    size_t weldedCount = representative.size();
+    auto position = [&](uint32_t w) { return mesh.vertices[representative[w]].position; };
+
+    std::vector<bool> locked(weldedCount);
+    for (size_t w = 0; w < weldedCount; w++) {
+        locked[w] = weldCount[w] > 1;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int e = 0; e < 3; e++) {
+            edgeUses[edgeKey(welded[mesh.indices[t * 3 + e]], welded[mesh.indices[t * 3 + (e + 1) % 3]])]++;
+        }
+    }
+    for (const auto& [key, uses] : edgeUses) {
+        if (uses == 1) {
+            locked[key >> 32] = true;
+            locked[key & 0xffffffffu] = true;
+        }
+    }
+
+    // triangles keep referencing original vertices, the welded ids are only
+    // looked up through them
+    std::vector<std::array<uint32_t, 3>> triangles(triangleCount);
+    std::vector<bool> removed(triangleCount);
+    std::vector<Quadric> quadrics(weldedCount);
+    std::vector<std::vector<uint32_t>> vertexTriangles(weldedCount);
+    size_t liveTriangles = 0;
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        triangles[t] = { mesh.indices[t * 3 + 0], mesh.indices[t * 3 + 1], mesh.indices[t * 3 + 2] };
+
+        uint32_t a = welded[triangles[t][0]], b = welded[triangles[t][1]], c = welded[triangles[t][2]];
+        if (a == b || b == c || c == a) {
+            removed[t] = true;
+            continue;
+        }
+        liveTriangles++;
+
+        glm::dvec3 normal = glm::cross(glm::dvec3(position(b) - position(a)), glm::dvec3(position(c) - position(a)));
+        double length = glm::length(normal);
+        if (length > 0.0) {
+            normal /= length;
+            Quadric plane;
+            plane.addPlane(normal, -glm::dot(normal, glm::dvec3(position(a))));
+            quadrics[a] += plane;
+            quadrics[b] += plane;
+            quadrics[c] += plane;
+        }
+
+        vertexTriangles[a].push_back(t);
+        vertexTriangles[b].push_back(t);
+        vertexTriangles[c].push_back(t);
+    }
+
+    std::vector<bool> collapsed(weldedCount);
+    std::vector<uint32_t> versions(weldedCount);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+    auto pushCollapse = [&](uint32_t from, uint32_t to) {
+        if (locked[from]) {
+            return;
+        }
+        Quadric combined = quadrics[from];
+        combined += quadrics[to];
+        queue.push({ std::max(0.0, combined.evaluate(position(to))), from, to, versions[from], versions[to] });
+    };
+
+    auto corner = [&](uint32_t t, int i) { return welded[triangles[t][i]]; };
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (!removed[t]) {
+            for (int e = 0; e < 3; e++) {
+                pushCollapse(corner(t, e), corner(t, (e + 1) % 3));
+                pushCollapse(corner(t, (e + 1) % 3), corner(t, e));
+            }
+        }
+    }
+
+    auto gatherNeighbours = [&](uint32_t w, std::vector<uint32_t>& neighbours) {
+        neighbours.clear();
+        for (uint32_t t : vertexTriangles[w]) {
+            if (removed[t]) {
+                continue;
+            }
+            for (int i = 0; i < 3; i++) {
+                uint32_t n = corner(t, i);
+                if (n != w && std::find(neighbours.begin(), neighbours.end(), n) == neighbours.end()) {
+                    neighbours.push_back(n);
+                }
+            }
+        }
+    };
+
+    double maxCost = 0.0;
+    std::vector<uint32_t> fromNeighbours;
+    std::vector<uint32_t> toNeighbours;
+
+    while (liveTriangles * 3 > targetIndexCount && !queue.empty()) {
+        Collapse collapse = queue.top();
+        queue.pop();
+
+        uint32_t from = collapse.from;
+        uint32_t to = collapse.to;
+        if (collapsed[from] || collapsed[to] || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) {
+            continue;
+        }
+
+        // link condition, the two one rings may only share the vertices
+        // opposite the collapsed edge or the surface pinches
+        gatherNeighbours(from, fromNeighbours);
+        gatherNeighbours(to, toNeighbours);
+        if (std::find(fromNeighbours.begin(), fromNeighbours.end(), to) == fromNeighbours.end()) {
+            continue;
+        }
+
+        uint32_t sharedTriangles = 0;
+        bool flips = false;
+        for (uint32_t t : vertexTriangles[from]) {
+            if (removed[t]) {
+                continue;
+            }
+
+            glm::vec3 p[3] = { position(corner(t, 0)), position(corner(t, 1)), position(corner(t, 2)) };
+            if (corner(t, 0) == to || corner(t, 1) == to || corner(t, 2) == to) {
+                sharedTriangles++;
+                continue;
+            }
+
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            for (int i = 0; i < 3; i++) {
+                if (corner(t, i) == from) {
+                    p[i] = position(to);
+                }
+            }
+            glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+            if (glm::dot(before, after) <= 0.0f) {
+                flips = true;
+                break;
+            }
+        }
+
+        uint32_t sharedNeighbours = 0;
+        for (uint32_t n : fromNeighbours) {
+            sharedNeighbours += std::find(toNeighbours.begin(), toNeighbours.end(), n) != toNeighbours.end() ? 1 : 0;
+        }
+
+        if (flips || sharedNeighbours != sharedTriangles) {
+            continue;
+        }
+
+        for (uint32_t t : vertexTriangles[from]) {
+            if (removed[t]) {
+                continue;
+            }
+
+            if (corner(t, 0) == to || corner(t, 1) == to || corner(t, 2) == to) {
+                removed[t] = true;
+                liveTriangles--;
+                continue;
+            }
+
+            for (int i = 0; i < 3; i++) {
+                if (corner(t, i) == from) {
+                    triangles[t][i] = representative[to];
+                }
+            }
+            vertexTriangles[to].push_back(t);
+        }
+
+        collapsed[from] = true;
+        quadrics[to] += quadrics[from];
+        versions[to]++;
+        maxCost = std::max(maxCost, collapse.cost);
+
+        gatherNeighbours(to, toNeighbours);
+        for (uint32_t n : toNeighbours) {
+            pushCollapse(n, to);
+            pushCollapse(to, n);
+        }
+    }
+
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(maxCost));
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (!removed[t]) {
+            indices.insert(indices.end(), triangles[t].begin(), triangles[t].end());
+        }
+    }
+
+    return indices;
+}
+
+std::vector<MeshLod> generateLodChain(const MeshData& mesh, uint32_t maxLevels)
+{
+    std::vector<MeshLod> lods;
+    lods.push_back({ mesh.indices, 0.0f });
+
+    while (lods.size() < maxLevels) {
+        const MeshLod& previous = lods.back();
+        size_t target = previous.indices.size() / 6 * 3;
+        if (target < 3 * 8) {
+            break;
+        }
+
+        // always simplified from the source so errors don't compound
+        MeshLod lod;
+        lod.indices = simplifyMesh(mesh, target, &lod.error);
+        if (lod.indices.size() > previous.indices.size() * 9 / 10) {
+            break;
+        }
+
+        lod.error = std::max(lod.error, previous.error);
+        lods.push_back(std::move(lod));
+    }
+
+    return lods;
+}
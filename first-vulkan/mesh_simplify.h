@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+// mirrors MAX_MESH_LODS in shaders/common.glsl
+const uint32_t MAX_MESH_LODS = 8;
+
+struct MeshLod {
+    std::vector<uint32_t> indices;
+    // conservative estimate of the largest distance from the source surface,
+    // in mesh units
+    float error = 0.0f;
+};
+
+// quadric error metric edge collapse. vertices only ever collapse onto one of
+// their neighbours, so the result still indexes the original vertex buffer and
+// every lod of a mesh can share it. vertices on open borders or attribute
+// seams (several vertices at one position) never move
+[[nodiscard]] std::vector<uint32_t> simplifyMesh(const MeshData& mesh, size_t targetIndexCount, float* resultError);
+
+// lod 0 is the mesh itself and every following level aims for half the
+// triangles of the previous one. stops early once simplification stalls
+[[nodiscard]] std::vector<MeshLod> generateLodChain(const MeshData& mesh, uint32_t maxLevels);
@@ -0,0 +1,196 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <limits>
+
+MeshletData buildMeshlets(const MeshData& mesh, const std::vector<uint32_t>& indices, uint32_t maxVertices, uint32_t maxTriangles)
+{
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = mesh.vertices.size();
+
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (int i = 0; i < 3; i++) {
+            vertexTriangles[indices[t * 3 + i]].push_back(t);
+        }
+    }
+
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<bool> emitted(triangleCount);
+    // which meshlet a vertex was last added to and its local index there
+    std::vector<uint32_t> vertexMeshlet(vertexCount, unused);
+    std::vector<uint8_t> localIndex(vertexCount);
+
+    MeshletData data;
+    size_t nextSeed = 0;
+
+    while (true) {
+        while (nextSeed < triangleCount && emitted[nextSeed]) {
+            nextSeed++;
+        }
+        if (nextSeed == triangleCount) {
+            break;
+        }
+
+        uint32_t meshletIndex = static_cast<uint32_t>(data.meshlets.size());
+        Meshlet meshlet {};
+        meshlet.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(data.triangles.size() / 3);
+
+        auto newVertices = [&](size_t t) {
+            uint32_t count = 0;
+            for (int i = 0; i < 3; i++) {
+                count += vertexMeshlet[indices[t * 3 + i]] != meshletIndex ? 1 : 0;
+            }
+            return count;
+        };
+
+        auto addTriangle = [&](size_t t) {
+            for (int i = 0; i < 3; i++) {
+                uint32_t v = indices[t * 3 + i];
+                if (vertexMeshlet[v] != meshletIndex) {
+                    vertexMeshlet[v] = meshletIndex;
+                    localIndex[v] = static_cast<uint8_t>(meshlet.vertexCount++);
+                    data.vertices.push_back(v);
+                }
+                data.triangles.push_back(localIndex[v]);
+            }
+            meshlet.triangleCount++;
+            emitted[t] = true;
+        };
+
+        addTriangle(nextSeed);
+        glm::vec3 centroidSum(0.0f);
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+            centroidSum += mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position;
+        }
+
+        while (meshlet.triangleCount < maxTriangles) {
+            size_t best = triangleCount;
+            uint32_t bestNewVertices = 4;
+            float bestDistance = 0.0f;
+            glm::vec3 centroid = centroidSum / static_cast<float>(meshlet.vertexCount);
+
+            // only triangles touching the meshlet are candidates, ties go to
+            // the one closest to the centroid so the meshlet stays round
+            for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+                for (uint32_t t : vertexTriangles[data.vertices[meshlet.vertexOffset + i]]) {
+                    if (emitted[t]) {
+                        continue;
+                    }
+                    uint32_t count = newVertices(t);
+                    if (count > bestNewVertices) {
+                        continue;
+                    }
+
+                    glm::vec3 triangleCenter = (mesh.vertices[indices[t * 3 + 0]].position + mesh.vertices[indices[t * 3 + 1]].position
+                        + mesh.vertices[indices[t * 3 + 2]].position) / 3.0f;
+                    float distance = glm::dot(triangleCenter - centroid, triangleCenter - centroid);
+                    if (count < bestNewVertices || distance < bestDistance) {
+                        best = t;
+                        bestNewVertices = count;
+                        bestDistance = distance;
+                    }
+                }
+            }
+
+            // disconnected pieces, like the faces of a mesh with hard edges,
+            // still share a meshlet if there is room
+            if (best == triangleCount) {
+                while (nextSeed < triangleCount && emitted[nextSeed]) {
+                    nextSeed++;
+                }
+                if (nextSeed == triangleCount) {
+                    break;
+                }
+                best = nextSeed;
+                bestNewVertices = newVertices(best);
+            }
+
+            if (meshlet.vertexCount + bestNewVertices > maxVertices) {
+                break;
+            }
+
+            uint32_t firstNew = meshlet.vertexCount;
+            addTriangle(best);
+            for (uint32_t i = firstNew; i < meshlet.vertexCount; i++) {
+                centroidSum += mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position;
+            }
+        }
+
+        data.meshlets.push_back(meshlet);
+    }
+
+    return data;
+}
+
+MeshletBounds computeMeshletBounds(const MeshData& mesh, const MeshletData& data, const Meshlet& meshlet)
+{
+    MeshletBounds bounds {};
+
+    auto position = [&](uint32_t local) { return mesh.vertices[data.vertices[meshlet.vertexOffset + local]].position; };
+
+    glm::vec3 minBounds = position(0);
+    glm::vec3 maxBounds = position(0);
+    for (uint32_t i = 1; i < meshlet.vertexCount; i++) {
+        minBounds = glm::min(minBounds, position(i));
+        maxBounds = glm::max(maxBounds, position(i));
+    }
+
+    glm::vec3 center = (minBounds + maxBounds) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        radius = std::max(radius, glm::length(position(i) - center));
+    }
+    bounds.sphere = glm::vec4(center, radius);
+
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> corners;
+    glm::vec3 normalSum(0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        const uint8_t* triangle = &data.triangles[(meshlet.triangleOffset + t) * 3];
+        glm::vec3 a = position(triangle[0]);
+        glm::vec3 normal = glm::cross(position(triangle[1]) - a, position(triangle[2]) - a);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            corners.push_back(a);
+            normalSum += normal / length;
+        }
+    }
+
+    bounds.coneApex = center;
+    bounds.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    bounds.coneCutoff = 1.0f;
+
+    float axisLength = glm::length(normalSum);
+    if (normals.empty() || axisLength == 0.0f) {
+        return bounds;
+    }
+    glm::vec3 axis = normalSum / axisLength;
+
+    float minDot = 1.0f;
+    for (const auto& normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+
+    // past roughly 84 degrees the cone would hardly ever cull anything
+    if (minDot <= 0.1f) {
+        return bounds;
+    }
+
+    // pull the apex back until every triangle plane is in front of it
+    float maxT = 0.0f;
+    for (size_t i = 0; i < normals.size(); i++) {
+        float t = glm::dot(center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+        maxT = std::max(maxT, t);
+    }
+
+    bounds.coneApex = center - axis * maxT;
+    bounds.coneAxis = axis;
+    bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    return bounds;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+// 64 vertices and 124 triangles fit mesh shader output limits on every vendor
+// and keep the local triangle list addressable with 8 bit indices
+const uint32_t MAX_MESHLET_VERTICES = 64;
+const uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+struct Meshlet {
+    // into MeshletData::vertices and MeshletData::triangles
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    // meshlet local vertex to mesh vertex
+    std::vector<uint32_t> vertices;
+    // 3 meshlet local vertex indices per triangle
+    std::vector<uint8_t> triangles;
+};
+
+struct MeshletBounds {
+    glm::vec4 sphere;
+    // every triangle faces away from a viewer at v when
+    // dot(normalize(coneApex - v), coneAxis) >= coneCutoff. a cutoff of 1
+    // means the triangles face too many ways for the cone to ever cull
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// grows each meshlet greedily from a seed triangle, always taking the
+// neighbouring triangle that adds the fewest new vertices, so clusters end up
+// compact which keeps their bounds and normal cones tight
+[[nodiscard]] MeshletData buildMeshlets(const MeshData& mesh, const std::vector<uint32_t>& indices,
+    uint32_t maxVertices = MAX_MESHLET_VERTICES, uint32_t maxTriangles = MAX_MESHLET_TRIANGLES);
+
+[[nodiscard]] MeshletBounds computeMeshletBounds(const MeshData& mesh, const MeshletData& data, const Meshlet& meshlet);
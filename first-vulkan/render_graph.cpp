@@ -0,0 +1,424 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+// VK_IMAGE_LAYOUT_UNDEFINED, contents may be discarded
+static const uint32_t LAYOUT_UNDEFINED = 0;
+
+// what has happened to a resource so far in the frame
+struct ResourceState {
+    // stages and access of the last write, or of the last layout transition
+    uint64_t writeStages = 0;
+    uint64_t writeAccess = 0;
+    // stages that read since then
+    uint64_t readStages = 0;
+    // the write has been made visible to these already
+    uint64_t visibleStages = 0;
+    uint64_t visibleAccess = 0;
+    uint32_t layout = LAYOUT_UNDEFINED;
+    bool used = false;
+};
+
+void resetRenderGraph(RenderGraph& graph)
+{
+    graph.resources.clear();
+    graph.passes.clear();
+}
+
+uint32_t addGraphResource(RenderGraph& graph, const GraphResourceDesc& desc)
+{
+    graph.resources.push_back(desc);
+    return static_cast<uint32_t>(graph.resources.size() - 1);
+}
+
+uint32_t addGraphPass(RenderGraph& graph, uint32_t tag, bool sideEffects)
+{
+    GraphPass pass {};
+    pass.tag = tag;
+    pass.sideEffects = sideEffects;
+    graph.passes.push_back(pass);
+    return static_cast<uint32_t>(graph.passes.size() - 1);
+}
+
+static void addAccess(RenderGraph& graph, uint32_t pass, uint32_t resource, uint64_t stages, uint64_t access, uint32_t layout, bool read, bool write)
+{
+    // a pass touching a resource twice, say as an attachment and through a
+    // descriptor, is one access covering both
+    for (auto& existing : graph.passes[pass].accesses) {
+        if (existing.resource != resource) {
+            continue;
+        }
+        if (existing.layout != layout) {
+            throw std::runtime_error("render graph pass uses an image in two layouts!");
+        }
+        existing.stages |= stages;
+        existing.access |= access;
+        existing.read = existing.read || read;
+        existing.write = existing.write || write;
+        return;
+    }
+
+    graph.passes[pass].accesses.push_back({ resource, stages, access, layout, read, write });
+}
+
+void addGraphRead(RenderGraph& graph, uint32_t pass, uint32_t resource, uint64_t stages, uint64_t access, uint32_t layout)
+{
+    addAccess(graph, pass, resource, stages, access, layout, true, false);
+}
+
+void addGraphWrite(RenderGraph& graph, uint32_t pass, uint32_t resource, uint64_t stages, uint64_t access, uint32_t layout)
+{
+    addAccess(graph, pass, resource, stages, access, layout, false, true);
+}
+
+void addGraphReadWrite(RenderGraph& graph, uint32_t pass, uint32_t resource, uint64_t stages, uint64_t access, uint32_t layout)
+{
+    addAccess(graph, pass, resource, stages, access, layout, true, true);
+}
+
+static void hashValue(uint64_t& hash, uint64_t value)
+{
+    // fnv-1a over the bytes of value
+    for (int i = 0; i < 8; i++) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 0x100000001b3ull;
+    }
+}
+
+static uint64_t hashDeclarations(const RenderGraph& graph)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (const auto& desc : graph.resources) {
+        hashValue(hash, desc.image | desc.transient << 1 | desc.external << 2);
+        hashValue(hash, desc.layout);
+        hashValue(hash, desc.externalStages);
+        hashValue(hash, desc.size);
+        hashValue(hash, desc.alignment);
+        hashValue(hash, desc.memoryTypeBits);
+    }
+
+    for (const auto& pass : graph.passes) {
+        hashValue(hash, pass.tag);
+        hashValue(hash, pass.sideEffects);
+        hashValue(hash, pass.accesses.size());
+        for (const auto& access : pass.accesses) {
+            hashValue(hash, access.resource);
+            hashValue(hash, access.stages);
+            hashValue(hash, access.access);
+            hashValue(hash, access.layout);
+            hashValue(hash, access.read | access.write << 1);
+        }
+    }
+
+    return hash;
+}
+
+// a pass lives if it has side effects, writes something that outlives the
+// frame or writes something a living pass reads. walking backwards sees every
+// reader before the writers it keeps alive
+static std::vector<bool> findLivePasses(const RenderGraph& graph)
+{
+    std::vector<bool> live(graph.passes.size(), false);
+    // some later living pass reads the resource before anything overwrites it
+    std::vector<bool> needed(graph.resources.size(), false);
+
+    for (size_t i = graph.passes.size(); i-- > 0;) {
+        const GraphPass& pass = graph.passes[i];
+
+        live[i] = pass.sideEffects;
+        for (const auto& access : pass.accesses) {
+            const GraphResourceDesc& desc = graph.resources[access.resource];
+            if (access.write && (needed[access.resource] || desc.external || !desc.transient)) {
+                live[i] = true;
+            }
+        }
+
+        if (!live[i]) {
+            continue;
+        }
+
+        for (const auto& access : pass.accesses) {
+            if (access.write) {
+                needed[access.resource] = access.read;
+            } else if (access.read) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+
+    return live;
+}
+
+// places transient resources in one block, largest first, each at the lowest
+// offset that doesn't collide with a placed resource whose lifetime overlaps
+// its own
+static void placeTransientResources(const RenderGraph& graph, const std::vector<uint32_t>& firstUse, const std::vector<uint32_t>& lastUse, CompiledGraph& compiled)
+{
+    compiled.memoryOffsets.assign(graph.resources.size(), 0);
+    compiled.memorySize = 0;
+    compiled.memoryTypeBits = ~0u;
+
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < graph.resources.size(); i++) {
+        if (graph.resources[i].transient && graph.resources[i].size > 0 && firstUse[i] <= lastUse[i]) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return graph.resources[a].size > graph.resources[b].size;
+    });
+
+    std::vector<uint32_t> placed;
+    for (uint32_t resource : order) {
+        const GraphResourceDesc& desc = graph.resources[resource];
+
+        std::vector<std::pair<uint64_t, uint64_t>> taken;
+        for (uint32_t other : placed) {
+            if (firstUse[other] <= lastUse[resource] && firstUse[resource] <= lastUse[other]) {
+                taken.push_back({ compiled.memoryOffsets[other], compiled.memoryOffsets[other] + graph.resources[other].size });
+            }
+        }
+        std::sort(taken.begin(), taken.end());
+
+        uint64_t alignment = std::max<uint64_t>(desc.alignment, 1);
+        uint64_t offset = 0;
+        for (const auto& range : taken) {
+            if (offset + desc.size <= range.first) {
+                break;
+            }
+            offset = std::max(offset, (range.second + alignment - 1) / alignment * alignment);
+        }
+
+        compiled.memoryOffsets[resource] = offset;
+        compiled.memorySize = std::max(compiled.memorySize, offset + desc.size);
+        compiled.memoryTypeBits &= desc.memoryTypeBits;
+        placed.push_back(resource);
+    }
+
+    if (compiled.memoryTypeBits == 0) {
+        throw std::runtime_error("transient render graph resources share no memory type!");
+    }
+}
+
+[[nodiscard]] static bool sharesMemory(const RenderGraph& graph, const CompiledGraph& compiled, uint32_t a, uint32_t b)
+{
+    if (a == b) {
+        return true;
+    }
+    const GraphResourceDesc& descA = graph.resources[a];
+    const GraphResourceDesc& descB = graph.resources[b];
+    if (!descA.transient || !descB.transient || descA.size == 0 || descB.size == 0) {
+        return false;
+    }
+    uint64_t offsetA = compiled.memoryOffsets[a];
+    uint64_t offsetB = compiled.memoryOffsets[b];
+    return offsetA < offsetB + descB.size && offsetB < offsetA + descA.size;
+}
+
+// the state each resource enters the frame in, which is where the previous
+// run of the same graph left it. transient resources also have to wait for
+// everything that used memory they alias, in this frame or the last
+static std::vector<ResourceState> findInitialStates(const RenderGraph& graph, const CompiledGraph& compiled)
+{
+    size_t resourceCount = graph.resources.size();
+    std::vector<ResourceState> lastFrame(resourceCount);
+    std::vector<uint64_t> usedStages(resourceCount, 0);
+    std::vector<uint64_t> writtenAccess(resourceCount, 0);
+
+    for (uint32_t passIndex : compiled.passes) {
+        for (const auto& access : graph.passes[passIndex].accesses) {
+            ResourceState& state = lastFrame[access.resource];
+            if (access.write || (state.used && access.layout != state.layout)) {
+                state.writeStages = access.stages;
+                state.writeAccess = access.write ? access.access : 0;
+                state.readStages = 0;
+            } else {
+                state.readStages |= access.stages;
+            }
+            state.layout = access.layout;
+            state.used = true;
+
+            usedStages[access.resource] |= access.stages;
+            if (access.write) {
+                writtenAccess[access.resource] |= access.access;
+            }
+        }
+    }
+
+    std::vector<ResourceState> states(resourceCount);
+    for (uint32_t i = 0; i < resourceCount; i++) {
+        const GraphResourceDesc& desc = graph.resources[i];
+        ResourceState& state = states[i];
+
+        if (desc.external) {
+            state.readStages = desc.externalStages;
+            state.layout = desc.transient ? LAYOUT_UNDEFINED : desc.layout;
+            continue;
+        }
+
+        if (!desc.transient) {
+            if (desc.image && lastFrame[i].used && lastFrame[i].layout != desc.layout) {
+                throw std::runtime_error("render graph leaves an image in another layout than it starts the frame in!");
+            }
+            state = lastFrame[i];
+            state.used = false;
+            state.layout = desc.layout;
+            continue;
+        }
+
+        for (uint32_t other = 0; other < resourceCount; other++) {
+            if (sharesMemory(graph, compiled, i, other)) {
+                state.writeStages |= usedStages[other];
+                state.writeAccess |= writtenAccess[other];
+            }
+        }
+        state.layout = LAYOUT_UNDEFINED;
+    }
+
+    return states;
+}
+
+// the dependency access needs on whatever came before it. false if the
+// resource is already in the right layout and visible to it
+[[nodiscard]] static bool findDependency(const GraphResourceDesc& desc, const ResourceState& state, const GraphAccess& access, GraphBarrier& barrier)
+{
+    bool layoutChange = desc.image && access.layout != state.layout;
+
+    barrier = {};
+    barrier.resource = access.resource;
+    barrier.oldLayout = state.layout;
+    barrier.newLayout = access.layout;
+
+    if (access.write || layoutChange) {
+        // write after read only has to wait, write after write also needs the
+        // earlier write made available
+        barrier.srcStages = state.writeStages | state.readStages;
+        barrier.srcAccess = state.writeAccess;
+    } else if (state.writeStages != 0 && ((access.stages & ~state.visibleStages) != 0 || (access.access & ~state.visibleAccess) != 0)) {
+        barrier.srcStages = state.writeStages;
+        barrier.srcAccess = state.writeAccess;
+    }
+
+    if (barrier.srcStages == 0 && !layoutChange) {
+        return false;
+    }
+
+    barrier.dstStages = access.stages;
+    barrier.dstAccess = access.access;
+    return true;
+}
+
+static void applyAccess(ResourceState& state, const GraphAccess& access, bool barrierRecorded, bool layoutChange)
+{
+    if (access.write) {
+        state.writeStages = access.stages;
+        state.writeAccess = access.access;
+        state.readStages = 0;
+        state.visibleStages = 0;
+        state.visibleAccess = 0;
+    } else if (layoutChange) {
+        // the transition counts as a write at the stages it was made visible
+        // to, later readers elsewhere only have to wait for those
+        state.writeStages = access.stages;
+        state.writeAccess = 0;
+        state.readStages = access.stages;
+        state.visibleStages = access.stages;
+        state.visibleAccess = access.access;
+    } else {
+        state.readStages |= access.stages;
+        if (barrierRecorded) {
+            state.visibleStages |= access.stages;
+            state.visibleAccess |= access.access;
+        }
+    }
+    state.layout = access.layout;
+    state.used = true;
+}
+
+static void addToBatch(const GraphResourceDesc& desc, const GraphBarrier& barrier, GraphBarrierBatch& batch)
+{
+    if (desc.image) {
+        batch.imageBarriers.push_back(barrier);
+        return;
+    }
+    batch.srcStages |= barrier.srcStages;
+    batch.srcAccess |= barrier.srcAccess;
+    batch.dstStages |= barrier.dstStages;
+    batch.dstAccess |= barrier.dstAccess;
+}
+
+const CompiledGraph& compileRenderGraph(RenderGraph& graph)
+{
+    uint64_t hash = hashDeclarations(graph);
+    if (graph.compiledValid && graph.compiled.topologyHash == hash) {
+        return graph.compiled;
+    }
+
+    CompiledGraph compiled;
+    compiled.topologyHash = hash;
+
+    std::vector<bool> live = findLivePasses(graph);
+    for (uint32_t i = 0; i < graph.passes.size(); i++) {
+        if (live[i]) {
+            compiled.passes.push_back(i);
+        }
+    }
+
+    // lifetimes in positions of the compiled pass list
+    std::vector<uint32_t> firstUse(graph.resources.size(), UINT32_MAX);
+    std::vector<uint32_t> lastUse(graph.resources.size(), 0);
+    for (uint32_t position = 0; position < compiled.passes.size(); position++) {
+        for (const auto& access : graph.passes[compiled.passes[position]].accesses) {
+            firstUse[access.resource] = std::min(firstUse[access.resource], position);
+            lastUse[access.resource] = std::max(lastUse[access.resource], position);
+        }
+    }
+    placeTransientResources(graph, firstUse, lastUse, compiled);
+
+    std::vector<ResourceState> states = findInitialStates(graph, compiled);
+
+    for (uint32_t passIndex : compiled.passes) {
+        GraphBarrierBatch batch;
+        for (const auto& access : graph.passes[passIndex].accesses) {
+            const GraphResourceDesc& desc = graph.resources[access.resource];
+            ResourceState& state = states[access.resource];
+
+            bool layoutChange = desc.image && access.layout != state.layout;
+            GraphBarrier barrier;
+            bool barrierRecorded = findDependency(desc, state, access, barrier);
+            if (barrierRecorded) {
+                addToBatch(desc, barrier, batch);
+            }
+            applyAccess(state, access, barrierRecorded, layoutChange);
+        }
+        compiled.batches.push_back(batch);
+    }
+
+    // external images go back to where whoever comes after the frame expects
+    // them, the presentation engine waits on a semaphore so nothing has to
+    // wait here
+    for (uint32_t i = 0; i < graph.resources.size(); i++) {
+        const GraphResourceDesc& desc = graph.resources[i];
+        const ResourceState& state = states[i];
+        if (!desc.image || !desc.external || !state.used || state.layout == desc.layout) {
+            continue;
+        }
+
+        GraphBarrier barrier {};
+        barrier.resource = i;
+        barrier.srcStages = state.writeStages | state.readStages;
+        barrier.srcAccess = state.writeAccess;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = desc.layout;
+        compiled.finalBatch.imageBarriers.push_back(barrier);
+    }
+
+    graph.culledPassCount = static_cast<uint32_t>(graph.passes.size() - compiled.passes.size());
+    graph.compiled = std::move(compiled);
+    graph.compiledValid = true;
+    graph.compileCount++;
+    return graph.compiled;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// orders the gpu work of a frame from what each pass reads and writes. the
+// graph knows nothing about vulkan handles, stage and access masks are
+// VkPipelineStageFlags2 and VkAccessFlags2 values and layouts VkImageLayout
+// values, the caller maps resources back to its images and buffers when it
+// records the barriers
+struct GraphResourceDesc {
+    bool image = false;
+    // contents don't outlive the frame, the first use discards them
+    bool transient = false;
+    // read or presented after the frame, so passes writing it are never culled
+    bool external = false;
+    // layout between frames, transient images start every frame undefined
+    uint32_t layout = 0;
+    // what waited on the resource before the frame, for external ones, which
+    // the graph can't see the previous use of. the swap chain image is
+    // waited for by the acquire semaphore at these stages
+    uint64_t externalStages = 0;
+    // transient resources with a size get an offset into a memory block
+    // shared with the others whose passes don't overlap
+    uint64_t size = 0;
+    uint64_t alignment = 1;
+    uint32_t memoryTypeBits = ~0u;
+};
+
+struct GraphAccess {
+    uint32_t resource;
+    uint64_t stages;
+    uint64_t access;
+    // the pass expects the image in this layout and leaves it there
+    uint32_t layout;
+    // a write without a read replaces the contents, so whatever wrote them
+    // before may be culled
+    bool read;
+    bool write;
+};
+
+struct GraphPass {
+    // what the caller records for the pass, the graph only passes it along
+    uint32_t tag;
+    // kept even when nothing reads what it writes
+    bool sideEffects;
+    std::vector<GraphAccess> accesses;
+};
+
+struct GraphBarrier {
+    uint32_t resource;
+    uint64_t srcStages;
+    uint64_t srcAccess;
+    uint64_t dstStages;
+    uint64_t dstAccess;
+    uint32_t oldLayout;
+    uint32_t newLayout;
+};
+
+// everything recorded before one pass. buffer dependencies share one global
+// memory barrier, only images need one barrier each for their layouts
+struct GraphBarrierBatch {
+    uint64_t srcStages = 0;
+    uint64_t srcAccess = 0;
+    uint64_t dstStages = 0;
+    uint64_t dstAccess = 0;
+    std::vector<GraphBarrier> imageBarriers;
+};
+
+struct CompiledGraph {
+    uint64_t topologyHash = 0;
+    // passes that survived culling, in declaration order
+    std::vector<uint32_t> passes;
+    // one batch before each of them
+    std::vector<GraphBarrierBatch> batches;
+    // brings images back to their layout between frames
+    GraphBarrierBatch finalBatch;
+    // per resource, only meaningful for transient ones with a size
+    std::vector<uint64_t> memoryOffsets;
+    uint64_t memorySize = 0;
+    uint32_t memoryTypeBits = ~0u;
+};
+
+// passes and resources are declared again every frame, the compiled result is
+// kept as long as the declarations hash the same
+struct RenderGraph {
+    std::vector<GraphResourceDesc> resources;
+    std::vector<GraphPass> passes;
+    CompiledGraph compiled;
+    bool compiledValid = false;
+    uint32_t compileCount = 0;
+    uint32_t culledPassCount = 0;
+};
+
+// drops the declarations, keeps the compiled graph for the next compile
+void resetRenderGraph(RenderGraph& graph);
+
+uint32_t addGraphResource(RenderGraph& graph, const GraphResourceDesc& desc);
+// returns the index of the pass
+uint32_t addGraphPass(RenderGraph& graph, uint32_t tag, bool sideEffects);
+void addGraphRead(RenderGraph& graph, uint32_t pass, uint32_t resource, uint64_t stages, uint64_t access, uint32_t layout);
+void addGraphWrite(RenderGraph& graph, uint32_t pass, uint32_t resource, uint64_t stages, uint64_t access, uint32_t layout);
+void addGraphReadWrite(RenderGraph& graph, uint32_t pass, uint32_t resource, uint64_t stages, uint64_t access, uint32_t layout);
+
+[[nodiscard]] const CompiledGraph& compileRenderGraph(RenderGraph& graph);
@@ -0,0 +1,30 @@
+// the bindless resource table, see createBindlessTable in first-vulkan.cpp.
+// textures are addressed by their slot in the array, storage buffers are
+// declared per shader at binding 1 since their block type differs. shaders
+// including this need GL_EXT_nonuniform_qualifier
+
+layout(set = 0, binding = 0) uniform texture2D textures[];
+// the same array for the slots that hold layered images
+layout(set = 0, binding = 0) uniform texture2DArray arrayTextures[];
+layout(set = 0, binding = 2) uniform sampler linearSampler;
+// compares with LESS_OR_EQUAL and filters the 2x2 results
+layout(set = 0, binding = 3) uniform samplerShadow shadowSampler;
+
+// set when the textures are bc5, which only stores x and y of a unit normal
+layout(constant_id = 0) const bool TWO_CHANNEL_TEXTURES = false;
+
+vec4 sampleTexture(uint textureIndex, vec2 uv) {
+	vec4 texel = texture(sampler2D(textures[nonuniformEXT(textureIndex)], linearSampler), uv);
+	if (TWO_CHANNEL_TEXTURES) {
+		// blue reads 0, rebuild z and keep the [0, 1] encoding of the others
+		vec2 xy = texel.xy * 2.0 - 1.0;
+		float z = sqrt(max(0.0, 1.0 - dot(xy, xy)));
+		texel = vec4(texel.xy, z * 0.5 + 0.5, 1.0);
+	}
+	return texel;
+}
+
+// the fraction of the texels around uv in layer that depth is in front of
+float sampleShadow(uint textureIndex, vec2 uv, float layer, float depth) {
+	return texture(sampler2DArrayShadow(arrayTextures[nonuniformEXT(textureIndex)], shadowSampler), vec4(uv, layer, depth));
+}
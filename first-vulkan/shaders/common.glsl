@@ -0,0 +1,177 @@
+// shared between the culling passes, the light binning and the mesh shaders,
+// mirrors the structs in first-vulkan.cpp, asset_cache.h, light_clusters.h and
+// shadow_cascades.h
+
+struct ObjectData {
+	mat4 model;
+	vec4 boundingSphere;
+	vec4 color;
+	uint meshIndex;
+	// into the texture table, which holds its bindless slot
+	uint textureIndex;
+	uint padding0;
+	uint padding1;
+};
+
+#define MAX_MESH_LODS 8
+
+struct MeshLod {
+	uint firstIndex;
+	uint indexCount;
+	// relative to the bounding sphere radius of the mesh
+	float error;
+	uint padding;
+};
+
+struct MeshInfo {
+	vec4 boundingSphere;
+	// packed positions decode to positionOffset + position * positionScale
+	vec4 positionOffset;
+	vec4 positionScale;
+	int vertexOffset;
+	uint lodCount;
+	// meshlets cover lod 0 only
+	uint firstMeshlet;
+	uint meshletCount;
+	MeshLod lods[MAX_MESH_LODS];
+};
+
+struct MeshletInfo {
+	vec4 boundingSphere;
+	vec4 coneApex;
+	// xyz is the axis, w the cutoff. all triangles face away from a viewer at
+	// v when dot(normalize(coneApex - v), axis) >= cutoff
+	vec4 coneAxisCutoff;
+	uint firstIndex;
+	uint indexCount;
+	uint padding0;
+	uint padding1;
+};
+
+struct DrawIndexedIndirectCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+// point lights have a cone that covers everything, see LightData in
+// light_clusters.h
+struct LightData {
+	// xyz is the position, w the range
+	vec4 positionRange;
+	// rgb is the color times intensity, w the cosine of the inner cone angle
+	vec4 colorCosInner;
+	// xyz is the spot direction, w the cosine of the outer cone angle
+	vec4 directionCosOuter;
+};
+
+// same as in light_clusters.h
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+// cluster buffer slot of the mesh shaders when the lights aren't binned, the
+// fragment shader loops over all of them then
+#define NO_CLUSTERS 0xffffffffu
+
+// same as SHADOW_CASCADE_COUNT in shadow_cascades.h
+#define MAX_SHADOW_CASCADES 4
+
+// shadow map slot of the light buffer when there are no shadows
+#define NO_SHADOWS 0xffffffffu
+
+// the start of every light buffer, the lights follow it. mirrors
+// LightBufferHeader in first-vulkan.cpp
+struct LightBufferHeader {
+	uint lightCount;
+	// bindless texture slot of the cascaded shadow map, one layer per cascade
+	uint shadowMap;
+	uint padding0;
+	uint padding1;
+	// xyz points toward the sun
+	vec4 sunDirection;
+	// view depth each cascade ends at
+	vec4 cascadeSplits;
+	// world space size of a texel of each cascade
+	vec4 cascadeTexelSizes;
+	mat4 cascadeViewProj[MAX_SHADOW_CASCADES];
+};
+
+// phases of the culling passes, mirrors CullPhase in first-vulkan.cpp
+#define CULL_PHASE_ALL 0
+#define CULL_PHASE_EARLY 1
+#define CULL_PHASE_LATE 2
+
+// same as extractFrustumPlanes in culling.cpp
+void extractFrustumPlanes(mat4 viewProj, out vec4 planes[6]) {
+	mat4 rows = transpose(viewProj);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; i++) {
+		planes[i] /= length(planes[i].xyz);
+	}
+}
+
+// planes are normalized and face inwards, see extractFrustumPlanes
+bool isSphereInFrustum(vec4 planes[6], vec4 sphere) {
+	for (int i = 0; i < 6; i++) {
+		if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// projects the sphere onto the screen and compares its nearest depth with the
+// farthest depth the pyramid has under it. projection00 and projection11 are
+// the x and y scale of the projection before the y flip, spheres touching the
+// near plane are never occluded
+bool isSphereOccluded(sampler2D depthPyramid, mat4 viewProj, float projection00, float projection11, float nearPlane, vec4 sphere) {
+	vec4 clip = viewProj * vec4(sphere.xyz, 1.0);
+	// view space with y up and z forward, the projection has no skew so x and
+	// y can be recovered from clip space
+	vec3 c = vec3(clip.x / projection00, -clip.y / projection11, clip.w);
+	float r = sphere.w;
+	if (c.z < r + nearPlane) {
+		return false;
+	}
+
+	// tangent lines from the eye to the sphere in the xz and yz planes
+	vec3 cr = c * r;
+	float czr2 = c.z * c.z - r * r;
+	float vx = sqrt(c.x * c.x + czr2);
+	float minX = (vx * c.x - cr.z) / (vx * c.z + cr.x);
+	float maxX = (vx * c.x + cr.z) / (vx * c.z - cr.x);
+	float vy = sqrt(c.y * c.y + czr2);
+	float minY = (vy * c.y - cr.z) / (vy * c.z + cr.y);
+	float maxY = (vy * c.y + cr.z) / (vy * c.z - cr.y);
+
+	// to uv space, where y points down
+	vec4 rect = vec4(minX * projection00, maxY * projection11, maxX * projection00, minY * projection11) * vec4(0.5, -0.5, 0.5, -0.5) + 0.5;
+	rect = clamp(rect, 0.0, 1.0);
+
+	// the level where the rectangle covers at most 2x2 texels
+	vec2 extent = (rect.zw - rect.xy) * vec2(textureSize(depthPyramid, 0));
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, textureQueryLevels(depthPyramid) - 1);
+	ivec2 levelSize = textureSize(depthPyramid, level);
+	ivec2 minTexel = clamp(ivec2(rect.xy * vec2(levelSize)), ivec2(0), levelSize - 1);
+	ivec2 maxTexel = clamp(ivec2(rect.zw * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+	float farthest = max(
+		max(texelFetch(depthPyramid, minTexel, level).x, texelFetch(depthPyramid, ivec2(maxTexel.x, minTexel.y), level).x),
+		max(texelFetch(depthPyramid, ivec2(minTexel.x, maxTexel.y), level).x, texelFetch(depthPyramid, maxTexel, level).x));
+
+	// the w row of viewProj is the camera's forward axis, its nearest point
+	// lies one radius along it
+	vec3 forward = vec3(viewProj[0][3], viewProj[1][3], viewProj[2][3]);
+	vec4 nearestClip = viewProj * vec4(sphere.xyz - forward * r, 1.0);
+	return nearestClip.z / nearestClip.w > farthest;
+}
@@ -1,3 +1,16 @@
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.vert -o vert.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe mesh.vert -o mesh_vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe mesh.frag -o mesh_frag.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe mesh_gbuffer.frag -o mesh_gbuffer_frag.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe fullscreen.vert -o fullscreen_vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe deferred_lighting.frag -o deferred_lighting_frag.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe cull.comp -o cull_comp.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe cluster_cull.comp -o cluster_cull_comp.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe mesh_packed.vert -o mesh_packed_vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe depth_reduce.comp -o depth_reduce_comp.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe downsample.comp -o downsample_comp.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe light_cluster.comp -o light_cluster_comp.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shadow.vert -o shadow_vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shadow_packed.vert -o shadow_packed_vert.spv
 pause
\ No newline at end of file
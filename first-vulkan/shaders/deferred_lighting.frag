@@ -0,0 +1,49 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "bindless.glsl"
+#include "common.glsl"
+#include "lighting.glsl"
+
+// the lighting subpass of the deferred path. the g-buffer is read back at
+// this pixel only, so it can stay in tile memory
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput albedoInput;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput normalInput;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput depthInput;
+
+layout(push_constant) uniform PushConstants {
+	mat4 inverseViewProj;
+	// w is the cluster slice scale
+	vec4 cameraPosition;
+	// w is the cluster slice bias
+	vec4 cameraForward;
+	// pixels per cluster tile
+	vec2 tileSize;
+	// the rendered part of the framebuffer
+	vec2 renderSize;
+	// bindless slots of the lights and of the clusters they are binned into
+	uint lightBuffer;
+	uint clusterBuffer;
+	uint lightIndexBuffer;
+} pc;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	float depth = subpassLoad(depthInput).x;
+	// nothing was drawn here, keep the clear color of the forward path
+	if (depth >= 1.0) {
+		outColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	vec2 ndc = gl_FragCoord.xy / pc.renderSize * 2.0 - 1.0;
+	vec4 position = pc.inverseViewProj * vec4(ndc, depth, 1.0);
+	vec3 albedo = subpassLoad(albedoInput).rgb;
+	vec3 normal = normalize(subpassLoad(normalInput).xyz * 2.0 - 1.0);
+
+	vec3 color = shadeSurface(position.xyz / position.w, normal, albedo, gl_FragCoord.xy, pc.cameraPosition, pc.cameraForward, pc.tileSize,
+		pc.lightBuffer, pc.clusterBuffer, pc.lightIndexBuffer);
+	outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,98 @@
+// surface shading shared by the forward mesh shader and the deferred lighting
+// pass. shaders including this need bindless.glsl, common.glsl and
+// GL_EXT_nonuniform_qualifier
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffers {
+	LightBufferHeader header;
+	LightData lights[];
+} lightBuffers[];
+
+// lights per cluster, written by light_cluster.comp
+layout(std430, set = 0, binding = 1) readonly buffer ClusterBuffers {
+	uint lightCounts[];
+} clusterBuffers[];
+
+// MAX_LIGHTS_PER_CLUSTER entries per cluster
+layout(std430, set = 0, binding = 1) readonly buffer LightIndexBuffers {
+	uint lightIndices[];
+} lightIndexBuffers[];
+
+// 1 where the sun reaches position, 0 where something is in the way. depth
+// is the view depth, which picks the cascade
+float shadeSunShadow(uint lightBuffer, vec3 position, vec3 normal, float depth) {
+	uint shadowMap = lightBuffers[lightBuffer].header.shadowMap;
+	if (shadowMap == NO_SHADOWS) {
+		return 1.0;
+	}
+
+	vec4 splits = lightBuffers[lightBuffer].header.cascadeSplits;
+	uint cascade = 0;
+	while (cascade < MAX_SHADOW_CASCADES && depth > splits[cascade]) {
+		cascade++;
+	}
+	if (cascade == MAX_SHADOW_CASCADES) {
+		return 1.0;
+	}
+
+	// pushed off the surface by a texel and a half, so it doesn't shadow
+	// itself where the shadow map is coarser than the surface
+	float texelSize = lightBuffers[lightBuffer].header.cascadeTexelSizes[cascade];
+	vec3 offsetPosition = position + normal * (texelSize * 1.5);
+	vec4 shadowPosition = lightBuffers[lightBuffer].header.cascadeViewProj[cascade] * vec4(offsetPosition, 1.0);
+
+	return sampleShadow(shadowMap, shadowPosition.xy * 0.5 + 0.5, float(cascade), shadowPosition.z);
+}
+
+vec3 shadeLight(LightData light, vec3 position, vec3 normal, vec3 albedo) {
+	vec3 toLight = light.positionRange.xyz - position;
+	float distanceSquared = dot(toLight, toLight);
+	float rangeSquared = light.positionRange.w * light.positionRange.w;
+	if (distanceSquared >= rangeSquared) {
+		return vec3(0.0);
+	}
+
+	// inverse square falloff, windowed so it reaches zero at the range
+	vec3 l = toLight * inversesqrt(distanceSquared);
+	float ratio = distanceSquared / rangeSquared;
+	float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+	float attenuation = window * window / (distanceSquared + 1.0);
+	float cone = smoothstep(light.directionCosOuter.w, light.colorCosInner.w, dot(-l, light.directionCosOuter.xyz));
+
+	return albedo * light.colorCosInner.rgb * (max(dot(normal, l), 0.0) * attenuation * cone);
+}
+
+// the sun plus the lights of the cluster fragCoord and position fall into,
+// or every light when clusterBuffer is NO_CLUSTERS. w of cameraPosition and
+// cameraForward are the slice scale and bias
+vec3 shadeSurface(vec3 position, vec3 normal, vec3 albedo, vec2 fragCoord, vec4 cameraPosition, vec4 cameraForward, vec2 tileSize,
+	uint lightBuffer, uint clusterBuffer, uint lightIndexBuffer) {
+	float depth = dot(position - cameraPosition.xyz, cameraForward.xyz);
+
+	float diffuse = max(dot(normal, lightBuffers[lightBuffer].header.sunDirection.xyz), 0.0);
+	if (diffuse > 0.0) {
+		diffuse *= shadeSunShadow(lightBuffer, position, normal, depth);
+	}
+	vec3 color = albedo * (0.2 + 0.8 * diffuse);
+
+	if (clusterBuffer == NO_CLUSTERS) {
+		uint lightCount = lightBuffers[lightBuffer].header.lightCount;
+		for (uint i = 0; i < lightCount; i++) {
+			color += shadeLight(lightBuffers[lightBuffer].lights[i], position, normal, albedo);
+		}
+		return color;
+	}
+
+	// the same slicing light_cluster.comp bins with
+	float slice = log(max(depth, 1e-4)) * cameraPosition.w - cameraForward.w;
+	uvec3 clusterId = uvec3(min(uvec2(fragCoord / tileSize), uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1)),
+		uint(clamp(slice, 0.0, float(CLUSTER_GRID_Z - 1))));
+	uint cluster = (clusterId.z * CLUSTER_GRID_Y + clusterId.y) * CLUSTER_GRID_X + clusterId.x;
+
+	uint lightCount = clusterBuffers[clusterBuffer].lightCounts[cluster];
+	uint first = cluster * MAX_LIGHTS_PER_CLUSTER;
+	for (uint i = 0; i < lightCount; i++) {
+		uint light = lightIndexBuffers[lightIndexBuffer].lightIndices[first + i];
+		color += shadeLight(lightBuffers[lightBuffer].lights[light], position, normal, albedo);
+	}
+	return color;
+}
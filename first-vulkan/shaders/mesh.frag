@@ -0,0 +1,38 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "bindless.glsl"
+#include "common.glsl"
+#include "lighting.glsl"
+
+// same as in mesh.vert
+layout(push_constant) uniform PushConstants {
+	mat4 viewProj;
+	// w is the cluster slice scale
+	vec4 cameraPosition;
+	// w is the cluster slice bias
+	vec4 cameraForward;
+	uint objectBuffer;
+	uint meshBuffer;
+	uint textureTable;
+	uint lightBuffer;
+	uint clusterBuffer;
+	uint lightIndexBuffer;
+	vec2 tileSize;
+} pc;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec2 fragUV;
+layout(location = 3) flat in uint fragTextureIndex;
+layout(location = 4) in vec3 fragWorldPosition;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	vec3 albedo = fragColor * sampleTexture(fragTextureIndex, fragUV).rgb;
+	vec3 color = shadeSurface(fragWorldPosition, normalize(fragNormal), albedo, gl_FragCoord.xy, pc.cameraPosition, pc.cameraForward, pc.tileSize,
+		pc.lightBuffer, pc.clusterBuffer, pc.lightIndexBuffer);
+	outColor = vec4(color, 1.0);
+}
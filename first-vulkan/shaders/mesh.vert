@@ -0,0 +1,60 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "common.glsl"
+
+// shared with mesh.frag, which needs everything after the scene buffers
+layout(push_constant) uniform PushConstants {
+	mat4 viewProj;
+	// w is the cluster slice scale
+	vec4 cameraPosition;
+	// w is the cluster slice bias
+	vec4 cameraForward;
+	// bindless slots of the scene buffers
+	uint objectBuffer;
+	uint meshBuffer;
+	uint textureTable;
+	// bindless slots of the lights and of the clusters they are binned into
+	uint lightBuffer;
+	uint clusterBuffer;
+	uint lightIndexBuffer;
+	// pixels per cluster tile
+	vec2 tileSize;
+} pc;
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffers {
+	ObjectData objects[];
+} objectBuffers[];
+
+// object texture index to bindless texture slot
+layout(std430, set = 0, binding = 1) readonly buffer TextureTables {
+	uint slots[];
+} textureTables[];
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out uint fragTextureIndex;
+layout(location = 4) out vec3 fragWorldPosition;
+
+// the depth pre-pass and the shading pass must produce bit identical depth
+// for the EQUAL test
+invariant gl_Position;
+
+void main() {
+	ObjectData object = objectBuffers[pc.objectBuffer].objects[gl_InstanceIndex];
+
+	vec4 worldPosition = object.model * vec4(inPosition, 1.0);
+
+	gl_Position = pc.viewProj * worldPosition;
+	fragColor = object.color.rgb;
+	fragNormal = mat3(object.model) * inNormal;
+	fragUV = inUV;
+	fragWorldPosition = worldPosition.xyz;
+	fragTextureIndex = textureTables[pc.textureTable].slots[object.textureIndex];
+}
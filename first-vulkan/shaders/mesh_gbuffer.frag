@@ -0,0 +1,23 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "bindless.glsl"
+
+// the geometry subpass of the deferred path, lighting is left to
+// deferred_lighting.frag. the position is rebuilt from depth there
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec2 fragUV;
+layout(location = 3) flat in uint fragTextureIndex;
+layout(location = 4) in vec3 fragWorldPosition;
+
+layout(location = 0) out vec4 outAlbedo;
+// unorm, so the normal is biased into [0, 1]
+layout(location = 1) out vec4 outNormal;
+
+void main() {
+	outAlbedo = vec4(fragColor * sampleTexture(fragTextureIndex, fragUV).rgb, 1.0);
+	outNormal = vec4(normalize(fragNormal) * 0.5 + 0.5, 0.0);
+}
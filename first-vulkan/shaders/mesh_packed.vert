@@ -0,0 +1,73 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "common.glsl"
+
+// shared with mesh.frag, which needs everything after the scene buffers
+layout(push_constant) uniform PushConstants {
+	mat4 viewProj;
+	// w is the cluster slice scale
+	vec4 cameraPosition;
+	// w is the cluster slice bias
+	vec4 cameraForward;
+	// bindless slots of the scene buffers
+	uint objectBuffer;
+	uint meshBuffer;
+	uint textureTable;
+	// bindless slots of the lights and of the clusters they are binned into
+	uint lightBuffer;
+	uint clusterBuffer;
+	uint lightIndexBuffer;
+	// pixels per cluster tile
+	vec2 tileSize;
+} pc;
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffers {
+	ObjectData objects[];
+} objectBuffers[];
+
+// object texture index to bindless texture slot
+layout(std430, set = 0, binding = 1) readonly buffer TextureTables {
+	uint slots[];
+} textureTables[];
+
+layout(std430, set = 0, binding = 1) readonly buffer MeshBuffers {
+	MeshInfo meshes[];
+} meshBuffers[];
+
+// unorm16 position, octahedral snorm16 normal, half float uv
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out uint fragTextureIndex;
+layout(location = 4) out vec3 fragWorldPosition;
+
+invariant gl_Position;
+
+vec3 decodeOctahedral(vec2 encoded) {
+	vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
+
+void main() {
+	ObjectData object = objectBuffers[pc.objectBuffer].objects[gl_InstanceIndex];
+	MeshInfo mesh = meshBuffers[pc.meshBuffer].meshes[object.meshIndex];
+
+	vec3 position = mesh.positionOffset.xyz + inPosition.xyz * mesh.positionScale.xyz;
+
+	vec4 worldPosition = object.model * vec4(position, 1.0);
+
+	gl_Position = pc.viewProj * worldPosition;
+	fragColor = object.color.rgb;
+	fragNormal = mat3(object.model) * decodeOctahedral(inNormal);
+	fragUV = inUV;
+	fragWorldPosition = worldPosition.xyz;
+	fragTextureIndex = textureTables[pc.textureTable].slots[object.textureIndex];
+}
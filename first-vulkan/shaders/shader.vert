@@ -1,11 +1,20 @@
 #version 450
 
+layout(push_constant) uniform PushConstants {
+	mat4 viewProj;
+} pc;
+
+layout(location = 0) in mat4 instanceModel;
+layout(location = 4) in vec4 instanceColor;
+
 layout(location = 0) out vec3 fragColor;
 
+invariant gl_Position;
+
 vec2 positions[3] = vec2[](
-	vec2(0.0, -0.5),
-	vec2(0.5, 0.5),
-	vec2(-0.5, 0.5)
+	vec2(0.0, 0.5),
+	vec2(-0.5, -0.5),
+	vec2(0.5, -0.5)
 );
 
 vec3 colors[3] = vec3[](
@@ -16,6 +25,6 @@ vec3 colors[3] = vec3[](
 
 
 void main(){
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	fragColor = colors[gl_VertexIndex];
+	gl_Position = pc.viewProj * instanceModel * vec4(positions[gl_VertexIndex], 0.0, 1.0);
+	fragColor = colors[gl_VertexIndex] * instanceColor.rgb;
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "common.glsl"
+
+// depth only, into one cascade of the shadow map
+layout(push_constant) uniform PushConstants {
+	mat4 viewProj;
+	uint objectBuffer;
+	uint meshBuffer;
+} pc;
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffers {
+	ObjectData objects[];
+} objectBuffers[];
+
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+	ObjectData object = objectBuffers[pc.objectBuffer].objects[gl_InstanceIndex];
+	gl_Position = pc.viewProj * object.model * vec4(inPosition, 1.0);
+}
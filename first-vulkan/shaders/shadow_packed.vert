@@ -0,0 +1,31 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "common.glsl"
+
+// same as in shadow.vert
+layout(push_constant) uniform PushConstants {
+	mat4 viewProj;
+	uint objectBuffer;
+	uint meshBuffer;
+} pc;
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffers {
+	ObjectData objects[];
+} objectBuffers[];
+
+layout(std430, set = 0, binding = 1) readonly buffer MeshBuffers {
+	MeshInfo meshes[];
+} meshBuffers[];
+
+// unorm16 position, the rest of the vertex isn't needed
+layout(location = 0) in vec4 inPosition;
+
+void main() {
+	ObjectData object = objectBuffers[pc.objectBuffer].objects[gl_InstanceIndex];
+	MeshInfo mesh = meshBuffers[pc.meshBuffer].meshes[object.meshIndex];
+
+	vec3 position = mesh.positionOffset.xyz + inPosition.xyz * mesh.positionScale.xyz;
+	gl_Position = pc.viewProj * object.model * vec4(position, 1.0);
+}
@@ -0,0 +1,87 @@
+#include "shadow_cascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+std::array<float, SHADOW_CASCADE_COUNT> computeCascadeSplits(float nearPlane, float farPlane)
+{
+    // an even split wastes the near cascades on a few meters, a logarithmic
+    // one leaves the far ones with too little resolution
+    const float lambda = 0.75f;
+
+    std::array<float, SHADOW_CASCADE_COUNT> splits {};
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        float t = static_cast<float>(i + 1) / SHADOW_CASCADE_COUNT;
+        float logarithmic = nearPlane * std::pow(farPlane / nearPlane, t);
+        float even = nearPlane + (farPlane - nearPlane) * t;
+        splits[i] = lambda * logarithmic + (1.0f - lambda) * even;
+    }
+    return splits;
+}
+
+glm::vec4 getFrustumSliceSphere(const glm::vec3& eye, const glm::vec3& forward, float tanHalfFov, float aspect, float nearDepth, float farDepth)
+{
+    // squared distance of a corner from the view axis per unit of depth
+    float k2 = tanHalfFov * tanHalfFov * (1.0f + aspect * aspect);
+
+    // equally far from the near and the far corners, unless that lies past
+    // the far plane, where the far corners alone decide
+    float center = std::min((nearDepth + farDepth) * (1.0f + k2) * 0.5f, farDepth);
+    float nearDistance = std::sqrt((center - nearDepth) * (center - nearDepth) + nearDepth * nearDepth * k2);
+    float farDistance = std::sqrt((farDepth - center) * (farDepth - center) + farDepth * farDepth * k2);
+
+    return glm::vec4(eye + forward * center, std::max(nearDistance, farDistance));
+}
+
+ShadowCascade makeShadowCascade(const glm::vec3& sunDirection, const glm::vec4& sliceSphere, const glm::vec4& sceneSphere, uint32_t resolution)
+{
+    glm::vec3 up = std::abs(sunDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+    ShadowCascade cascade {};
+    cascade.lightView = glm::lookAt(glm::vec3(0.0f), -sunDirection, up);
+    cascade.sunDirection = sunDirection;
+    cascade.valid = true;
+
+    float radius = sliceSphere.w * (1.0f + SHADOW_CACHE_MARGIN);
+    cascade.texelSize = 2.0f * radius / resolution;
+
+    glm::vec3 center = glm::vec3(cascade.lightView * glm::vec4(glm::vec3(sliceSphere), 1.0f));
+    center.x = std::floor(center.x / cascade.texelSize) * cascade.texelSize;
+    center.y = std::floor(center.y / cascade.texelSize) * cascade.texelSize;
+
+    // larger z is closer to the sun, casters between it and the slice have
+    // to make it into the depth range
+    float sceneCenterZ = (cascade.lightView * glm::vec4(glm::vec3(sceneSphere), 1.0f)).z;
+    cascade.boxMin = center - radius;
+    cascade.boxMax = center + radius;
+    cascade.boxMax.z = std::max(cascade.boxMax.z, sceneCenterZ + sceneSphere.w);
+
+    // zero to one depth whatever GLM_FORCE_DEPTH_ZERO_TO_ONE says, like the
+    // projection of the camera
+    glm::mat4 projection = glm::orthoRH_ZO(cascade.boxMin.x, cascade.boxMax.x, cascade.boxMin.y, cascade.boxMax.y, -cascade.boxMax.z, -cascade.boxMin.z);
+    cascade.viewProj = projection * cascade.lightView;
+    return cascade;
+}
+
+bool isShadowCascadeCurrent(const ShadowCascade& cascade, const glm::vec3& sunDirection, const glm::vec4& sliceSphere)
+{
+    if (!cascade.valid || glm::dot(cascade.sunDirection, sunDirection) < SHADOW_CACHE_SUN_COS) {
+        return false;
+    }
+
+    glm::vec3 center = glm::vec3(cascade.lightView * glm::vec4(glm::vec3(sliceSphere), 1.0f));
+    glm::vec3 minimum = center - sliceSphere.w;
+    glm::vec3 maximum = center + sliceSphere.w;
+    return minimum.x >= cascade.boxMin.x && minimum.y >= cascade.boxMin.y && minimum.z >= cascade.boxMin.z && maximum.x <= cascade.boxMax.x
+        && maximum.y <= cascade.boxMax.y && maximum.z <= cascade.boxMax.z;
+}
+
+glm::vec3 getSunDirection(float angle)
+{
+    glm::vec3 direction = glm::normalize(glm::vec3(0.4f, 1.0f, 0.3f));
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    return glm::vec3(c * direction.x + s * direction.z, direction.y, c * direction.z - s * direction.x);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// the view frustum is split in depth into this many slices, each with its
+// own layer of the shadow map. mirrors MAX_SHADOW_CASCADES in
+// shaders/common.glsl
+const uint32_t SHADOW_CASCADE_COUNT = 4;
+
+// a cascade covers a sphere this much larger than the slice it is made for,
+// so the camera can move by the difference before the static casters cached
+// in it have to be drawn again
+const float SHADOW_CACHE_MARGIN = 0.25f;
+
+// cosine of how far the sun may turn before the cached casters are drawn
+// again, about a third of a degree
+const float SHADOW_CACHE_SUN_COS = 0.99998f;
+
+// a cascade as its static casters were last drawn. orthographic, looking
+// down -sunDirection
+struct ShadowCascade {
+    glm::mat4 viewProj {};
+    // rotation only, light space looks down -z
+    glm::mat4 lightView {};
+    // the light space box the cascade covers, the slice of the view frustum
+    // has to stay inside it
+    glm::vec3 boxMin {};
+    glm::vec3 boxMax {};
+    glm::vec3 sunDirection {};
+    // world space size of one shadow map texel
+    float texelSize = 0.0f;
+    bool valid = false;
+};
+
+// view depths the cascades end at, halfway between an even and a
+// logarithmic split of [nearPlane, farPlane] leaning logarithmic
+[[nodiscard]] std::array<float, SHADOW_CASCADE_COUNT> computeCascadeSplits(float nearPlane, float farPlane);
+
+// smallest sphere around the part of a symmetric view frustum between two
+// view depths. its radius doesn't change as the camera turns, so neither
+// does the size of a cascade fit around it
+[[nodiscard]] glm::vec4 getFrustumSliceSphere(const glm::vec3& eye, const glm::vec3& forward, float tanHalfFov, float aspect, float nearDepth,
+    float farDepth);
+
+// covers sliceSphere grown by SHADOW_CACHE_MARGIN, with its center snapped to
+// whole texels so shadows don't crawl as the camera moves. the depth range
+// reaches back to everything in sceneSphere that could cast into the slice
+[[nodiscard]] ShadowCascade makeShadowCascade(const glm::vec3& sunDirection, const glm::vec4& sliceSphere, const glm::vec4& sceneSphere, uint32_t resolution);
+
+// true while sliceSphere still fits inside the cascade and the sun hasn't
+// turned further than SHADOW_CACHE_SUN_COS since it was made
+[[nodiscard]] bool isShadowCascadeCurrent(const ShadowCascade& cascade, const glm::vec3& sunDirection, const glm::vec4& sliceSphere);
+
+// points toward the sun, which turns around the vertical axis by angle
+[[nodiscard]] glm::vec3 getSunDirection(float angle);
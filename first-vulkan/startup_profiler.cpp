@@ -0,0 +1,20 @@
+#include "startup_profiler.h"
+
+void beginStartupProfile(StartupProfiler& profiler)
+{
+    profiler.start = std::chrono::steady_clock::now();
+    profiler.last = profiler.start;
+    profiler.phases.clear();
+}
+
+void markStartupPhase(StartupProfiler& profiler, const std::string& name)
+{
+    auto now = std::chrono::steady_clock::now();
+    profiler.phases.push_back({ name, std::chrono::duration<double, std::milli>(now - profiler.last).count() });
+    profiler.last = now;
+}
+
+double getStartupMilliseconds(const StartupProfiler& profiler)
+{
+    return std::chrono::duration<double, std::milli>(profiler.last - profiler.start).count();
+}
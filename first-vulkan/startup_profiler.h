@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct StartupPhase {
+    std::string name;
+    double milliseconds;
+};
+
+// wall clock time of each step of init, in the order they ran
+struct StartupProfiler {
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point last;
+    std::vector<StartupPhase> phases;
+};
+
+void beginStartupProfile(StartupProfiler& profiler);
+
+// ends the phase that began at the previous mark, or at the beginning
+void markStartupPhase(StartupProfiler& profiler, const std::string& name);
+
+[[nodiscard]] double getStartupMilliseconds(const StartupProfiler& profiler);
@@ -0,0 +1,683 @@
+#include "texture_compress.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COMPRESSION_SSE2
+#endif
+
+struct CompressionSettings {
+    uint32_t powerIterations;
+    // least squares endpoint fits after the first index search
+    uint32_t refinementPasses;
+    // also tries the 6 value alpha mode and nudged alpha endpoints
+    bool searchAlphaModes;
+};
+
+[[nodiscard]] static CompressionSettings getCompressionSettings(CompressionQuality quality)
+{
+    switch (quality) {
+    case CompressionQuality::Fast:
+        return { 1, 0, false };
+    case CompressionQuality::Best:
+        return { 8, 3, true };
+    default:
+        return { 4, 1, true };
+    }
+}
+
+// the 16 pixels of a block as structure of arrays, so four pixels of one
+// channel fill an sse register
+struct BlockPixels {
+    alignas(16) float channels[4][16];
+};
+
+// a palette entry per possible index, channels a format does not store have
+// a weight of 0
+struct BlockPalette {
+    float colors[16][4];
+    uint32_t size;
+};
+
+const char* getTextureFormatName(TextureFormat format)
+{
+    switch (format) {
+    case TextureFormat::Bc1:
+        return "bc1";
+    case TextureFormat::Bc3:
+        return "bc3";
+    case TextureFormat::Bc5:
+        return "bc5";
+    case TextureFormat::Bc7:
+        return "bc7";
+    default:
+        return "rgba8";
+    }
+}
+
+const char* getCompressionQualityName(CompressionQuality quality)
+{
+    switch (quality) {
+    case CompressionQuality::Fast:
+        return "fast";
+    case CompressionQuality::Best:
+        return "best";
+    default:
+        return "default";
+    }
+}
+
+uint32_t getTextureBlockSize(TextureFormat format)
+{
+    return format == TextureFormat::Rgba8 ? 1 : 4;
+}
+
+uint32_t getTextureBlockBytes(TextureFormat format)
+{
+    switch (format) {
+    case TextureFormat::Rgba8:
+        return 4;
+    case TextureFormat::Bc1:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+uint64_t getTextureMipBytes(TextureFormat format, uint32_t width, uint32_t height)
+{
+    uint32_t blockSize = getTextureBlockSize(format);
+    uint64_t blocksX = (width + blockSize - 1) / blockSize;
+    uint64_t blocksY = (height + blockSize - 1) / blockSize;
+    return blocksX * blocksY * getTextureBlockBytes(format);
+}
+
+[[nodiscard]] static uint32_t getStoredChannelCount(TextureFormat format)
+{
+    switch (format) {
+    case TextureFormat::Bc1:
+        return 3;
+    case TextureFormat::Bc5:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+// blocks hanging over the image edge repeat the last row and column, which
+// keeps them from pulling the endpoints towards colors that are not there
+static void loadBlock(const uint32_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, BlockPixels& block)
+{
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t py = std::min(blockY * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t px = std::min(blockX * 4 + x, width - 1);
+            uint32_t color = pixels[py * width + px];
+            for (uint32_t c = 0; c < 4; c++) {
+                block.channels[c][y * 4 + x] = static_cast<float>((color >> (c * 8)) & 0xff);
+            }
+        }
+    }
+}
+
+// picks the closest palette entry for every pixel and returns the summed
+// weighted squared error
+static float selectIndices(const BlockPixels& block, const BlockPalette& palette, const float weights[4], uint8_t indices[16])
+{
+    float error = 0.0f;
+
+#if defined(COMPRESSION_SSE2)
+    for (uint32_t group = 0; group < 16; group += 4) {
+        __m128 channels[4];
+        for (uint32_t c = 0; c < 4; c++) {
+            channels[c] = _mm_load_ps(&block.channels[c][group]);
+        }
+
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (uint32_t entry = 0; entry < palette.size; entry++) {
+            __m128 distance = _mm_setzero_ps();
+            for (uint32_t c = 0; c < 4; c++) {
+                if (weights[c] == 0.0f) {
+                    continue;
+                }
+                __m128 difference = _mm_sub_ps(channels[c], _mm_set1_ps(palette.colors[entry][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(difference, difference), _mm_set1_ps(weights[c])));
+            }
+
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            best = _mm_min_ps(distance, best);
+            bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(static_cast<int>(entry))));
+        }
+
+        alignas(16) int32_t lanes[4];
+        alignas(16) float distances[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+        _mm_store_ps(distances, best);
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            indices[group + lane] = static_cast<uint8_t>(lanes[lane]);
+            error += distances[lane];
+        }
+    }
+#else
+    for (uint32_t i = 0; i < 16; i++) {
+        float best = FLT_MAX;
+        for (uint32_t entry = 0; entry < palette.size; entry++) {
+            float distance = 0.0f;
+            for (uint32_t c = 0; c < 4; c++) {
+                float difference = block.channels[c][i] - palette.colors[entry][c];
+                distance += difference * difference * weights[c];
+            }
+            if (distance < best) {
+                best = distance;
+                indices[i] = static_cast<uint8_t>(entry);
+            }
+        }
+        error += best;
+    }
+#endif
+
+    return error;
+}
+
+// the ends of the block's extent along its principal axis, found with a few
+// rounds of power iteration on the covariance of the first channelCount
+// channels
+static void findEndpoints(const BlockPixels& block, uint32_t channelCount, uint32_t iterations, float low[4], float high[4])
+{
+    float mean[4] = {};
+    float minimum[4];
+    float maximum[4];
+    for (uint32_t c = 0; c < channelCount; c++) {
+        minimum[c] = FLT_MAX;
+        maximum[c] = -FLT_MAX;
+        for (uint32_t i = 0; i < 16; i++) {
+            mean[c] += block.channels[c][i];
+            minimum[c] = std::min(minimum[c], block.channels[c][i]);
+            maximum[c] = std::max(maximum[c], block.channels[c][i]);
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t a = 0; a < channelCount; a++) {
+            for (uint32_t b = a; b < channelCount; b++) {
+                covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+            }
+        }
+    }
+    for (uint32_t a = 0; a < channelCount; a++) {
+        for (uint32_t b = 0; b < a; b++) {
+            covariance[a][b] = covariance[b][a];
+        }
+    }
+
+    // the bounding box diagonal is a good first guess, the iterations mostly
+    // fix up its sign per channel
+    float axis[4] = {};
+    for (uint32_t c = 0; c < channelCount; c++) {
+        axis[c] = maximum[c] - minimum[c];
+    }
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (uint32_t a = 0; a < channelCount; a++) {
+            for (uint32_t b = 0; b < channelCount; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length = std::max(length, std::abs(next[a]));
+        }
+        if (length == 0.0f) {
+            break;
+        }
+        for (uint32_t c = 0; c < channelCount; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float lengthSquared = 0.0f;
+    for (uint32_t c = 0; c < channelCount; c++) {
+        lengthSquared += axis[c] * axis[c];
+    }
+
+    float lowT = 0.0f;
+    float highT = 0.0f;
+    if (lengthSquared > 0.0f) {
+        lowT = FLT_MAX;
+        highT = -FLT_MAX;
+        for (uint32_t i = 0; i < 16; i++) {
+            float t = 0.0f;
+            for (uint32_t c = 0; c < channelCount; c++) {
+                t += (block.channels[c][i] - mean[c]) * axis[c];
+            }
+            lowT = std::min(lowT, t);
+            highT = std::max(highT, t);
+        }
+        lowT /= lengthSquared;
+        highT /= lengthSquared;
+    }
+
+    for (uint32_t c = 0; c < 4; c++) {
+        if (c < channelCount) {
+            low[c] = std::clamp(mean[c] + axis[c] * lowT, 0.0f, 255.0f);
+            high[c] = std::clamp(mean[c] + axis[c] * highT, 0.0f, 255.0f);
+        } else {
+            low[c] = 255.0f;
+            high[c] = 255.0f;
+        }
+    }
+}
+
+// least squares endpoints for pixels that each sit t of the way from low to
+// high. leaves the endpoints alone when every pixel uses the same t
+static void fitEndpoints(const BlockPixels& block, uint32_t channelCount, const float t[16], float low[4], float high[4])
+{
+    float lowLow = 0.0f;
+    float highHigh = 0.0f;
+    float lowHigh = 0.0f;
+    float lowColor[4] = {};
+    float highColor[4] = {};
+    for (uint32_t i = 0; i < 16; i++) {
+        float s = 1.0f - t[i];
+        lowLow += s * s;
+        highHigh += t[i] * t[i];
+        lowHigh += s * t[i];
+        for (uint32_t c = 0; c < channelCount; c++) {
+            lowColor[c] += s * block.channels[c][i];
+            highColor[c] += t[i] * block.channels[c][i];
+        }
+    }
+
+    float determinant = lowLow * highHigh - lowHigh * lowHigh;
+    if (std::abs(determinant) < 1e-6f) {
+        return;
+    }
+
+    for (uint32_t c = 0; c < channelCount; c++) {
+        low[c] = std::clamp((lowColor[c] * highHigh - highColor[c] * lowHigh) / determinant, 0.0f, 255.0f);
+        high[c] = std::clamp((highColor[c] * lowLow - lowColor[c] * lowHigh) / determinant, 0.0f, 255.0f);
+    }
+}
+
+// writes fields of a block least significant bit first
+struct BlockBitWriter {
+    uint8_t* data;
+    uint32_t position = 0;
+
+    void write(uint32_t value, uint32_t bitCount)
+    {
+        for (uint32_t bit = 0; bit < bitCount; bit++, position++) {
+            data[position / 8] |= static_cast<uint8_t>(((value >> bit) & 1) << (position % 8));
+        }
+    }
+};
+
+[[nodiscard]] static uint16_t packRgb565(const float color[4])
+{
+    uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+    uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+    uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+// bit replication, the way the hardware expands it
+static void unpackRgb565(uint16_t packed, int32_t color[3])
+{
+    int32_t r = (packed >> 11) & 31;
+    int32_t g = (packed >> 5) & 63;
+    int32_t b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+static float encodeBc1Block(const BlockPixels& block, const CompressionSettings& settings, uint8_t* output)
+{
+    const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    const float steps[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float low[4];
+    float high[4];
+    findEndpoints(block, 3, settings.powerIterations, low, high);
+
+    float bestError = FLT_MAX;
+    uint16_t bestEndpoints[2] = {};
+    uint8_t bestIndices[16] = {};
+
+    for (uint32_t pass = 0; pass <= settings.refinementPasses; pass++) {
+        uint16_t color0 = packRgb565(high);
+        uint16_t color1 = packRgb565(low);
+        // color0 > color1 selects the four color mode, equal endpoints fall
+        // into the three color one but only ever use index 0
+        bool swapped = color0 < color1;
+        if (swapped) {
+            std::swap(color0, color1);
+        }
+
+        int32_t expanded0[3];
+        int32_t expanded1[3];
+        unpackRgb565(color0, expanded0);
+        unpackRgb565(color1, expanded1);
+
+        BlockPalette palette {};
+        palette.size = color0 == color1 ? 1 : 4;
+        for (uint32_t c = 0; c < 3; c++) {
+            palette.colors[0][c] = static_cast<float>(expanded0[c]);
+            palette.colors[1][c] = static_cast<float>(expanded1[c]);
+            palette.colors[2][c] = static_cast<float>((2 * expanded0[c] + expanded1[c]) / 3);
+            palette.colors[3][c] = static_cast<float>((expanded0[c] + 2 * expanded1[c]) / 3);
+        }
+
+        uint8_t indices[16];
+        float error = selectIndices(block, palette, weights, indices);
+        if (error < bestError) {
+            bestError = error;
+            bestEndpoints[0] = color0;
+            bestEndpoints[1] = color1;
+            std::memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (error == 0.0f || palette.size == 1) {
+            break;
+        }
+
+        // steps run from color0 to color1, t from low to high
+        float t[16];
+        for (uint32_t i = 0; i < 16; i++) {
+            t[i] = swapped ? steps[indices[i]] : 1.0f - steps[indices[i]];
+        }
+        fitEndpoints(block, 3, t, low, high);
+    }
+
+    std::memset(output, 0, 8);
+    BlockBitWriter writer { output };
+    writer.write(bestEndpoints[0], 16);
+    writer.write(bestEndpoints[1], 16);
+    for (uint32_t i = 0; i < 16; i++) {
+        writer.write(bestIndices[i], 2);
+    }
+
+    return bestError;
+}
+
+// one channel with 8 interpolated values between its endpoints when
+// endpoint0 > endpoint1, or 6 plus exact 0 and 255 otherwise
+static void makeBc4Palette(uint32_t channel, uint32_t endpoint0, uint32_t endpoint1, BlockPalette& palette)
+{
+    palette = {};
+    palette.size = 8;
+
+    float* values[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        values[i] = &palette.colors[i][channel];
+    }
+
+    *values[0] = static_cast<float>(endpoint0);
+    *values[1] = static_cast<float>(endpoint1);
+    if (endpoint0 > endpoint1) {
+        for (uint32_t i = 1; i < 7; i++) {
+            *values[i + 1] = static_cast<float>(((7 - i) * endpoint0 + i * endpoint1) / 7);
+        }
+    } else {
+        for (uint32_t i = 1; i < 5; i++) {
+            *values[i + 1] = static_cast<float>(((5 - i) * endpoint0 + i * endpoint1) / 5);
+        }
+        *values[6] = 0.0f;
+        *values[7] = 255.0f;
+    }
+}
+
+static float encodeBc4Block(const BlockPixels& block, uint32_t channel, const CompressionSettings& settings, uint8_t* output)
+{
+    float weights[4] = {};
+    weights[channel] = 1.0f;
+
+    // the 6 value mode spends its interpolated values on the range between
+    // 0 and 255, which the explicit entries already cover
+    uint32_t minimum = 255;
+    uint32_t maximum = 0;
+    uint32_t innerMinimum = 255;
+    uint32_t innerMaximum = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t value = static_cast<uint32_t>(block.channels[channel][i]);
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        if (value != 0 && value != 255) {
+            innerMinimum = std::min(innerMinimum, value);
+            innerMaximum = std::max(innerMaximum, value);
+        }
+    }
+
+    float bestError = FLT_MAX;
+    uint32_t bestEndpoints[2] = {};
+    uint8_t bestIndices[16] = {};
+
+    auto tryEndpoints = [&](uint32_t endpoint0, uint32_t endpoint1) {
+        BlockPalette palette;
+        makeBc4Palette(channel, endpoint0, endpoint1, palette);
+
+        uint8_t indices[16];
+        float error = selectIndices(block, palette, weights, indices);
+        if (error < bestError) {
+            bestError = error;
+            bestEndpoints[0] = endpoint0;
+            bestEndpoints[1] = endpoint1;
+            std::memcpy(bestIndices, indices, sizeof(indices));
+        }
+    };
+
+    if (minimum == maximum) {
+        tryEndpoints(maximum, minimum);
+    } else {
+        tryEndpoints(maximum, minimum);
+
+        if (settings.searchAlphaModes) {
+            if (innerMinimum <= innerMaximum) {
+                tryEndpoints(innerMinimum, innerMaximum);
+            }
+
+            // pulling the endpoints in a little can land the interpolated
+            // values closer to where the pixels actually are
+            uint32_t range = settings.refinementPasses + 1;
+            for (uint32_t inset0 = 0; inset0 <= range; inset0++) {
+                for (uint32_t inset1 = 0; inset1 <= range; inset1++) {
+                    if (maximum - inset0 > minimum + inset1) {
+                        tryEndpoints(maximum - inset0, minimum + inset1);
+                    }
+                }
+            }
+        }
+    }
+
+    std::memset(output, 0, 8);
+    BlockBitWriter writer { output };
+    writer.write(bestEndpoints[0], 8);
+    writer.write(bestEndpoints[1], 8);
+    for (uint32_t i = 0; i < 16; i++) {
+        writer.write(bestIndices[i], 3);
+    }
+
+    return bestError;
+}
+
+const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 7 bit endpoint plus a p-bit shared by all its channels, picks the p-bit
+// that lands closer to color
+static void quantizeBc7Endpoint(const float color[4], uint32_t quantized[4], uint32_t& pBit)
+{
+    float bestError = FLT_MAX;
+    for (uint32_t p = 0; p < 2; p++) {
+        uint32_t candidate[4];
+        float error = 0.0f;
+        for (uint32_t c = 0; c < 4; c++) {
+            candidate[c] = static_cast<uint32_t>(std::clamp(std::lround((color[c] - p) / 2.0f), 0l, 127l));
+            float difference = static_cast<float>(candidate[c] << 1 | p) - color[c];
+            error += difference * difference;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            std::memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+static float encodeBc7Block(const BlockPixels& block, const CompressionSettings& settings, uint8_t* output)
+{
+    const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    float low[4];
+    float high[4];
+    findEndpoints(block, 4, settings.powerIterations, low, high);
+
+    float bestError = FLT_MAX;
+    uint32_t bestEndpoints[2][4] = {};
+    uint32_t bestPBits[2] = {};
+    uint8_t bestIndices[16] = {};
+
+    for (uint32_t pass = 0; pass <= settings.refinementPasses; pass++) {
+        uint32_t endpoints[2][4];
+        uint32_t pBits[2];
+        quantizeBc7Endpoint(low, endpoints[0], pBits[0]);
+        quantizeBc7Endpoint(high, endpoints[1], pBits[1]);
+
+        BlockPalette palette {};
+        palette.size = 16;
+        for (uint32_t i = 0; i < 16; i++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t value0 = endpoints[0][c] << 1 | pBits[0];
+                uint32_t value1 = endpoints[1][c] << 1 | pBits[1];
+                palette.colors[i][c] = static_cast<float>(((64 - BC7_WEIGHTS[i]) * value0 + BC7_WEIGHTS[i] * value1 + 32) >> 6);
+            }
+        }
+
+        uint8_t indices[16];
+        float error = selectIndices(block, palette, weights, indices);
+        if (error < bestError) {
+            bestError = error;
+            std::memcpy(bestEndpoints, endpoints, sizeof(endpoints));
+            std::memcpy(bestPBits, pBits, sizeof(pBits));
+            std::memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (error == 0.0f) {
+            break;
+        }
+
+        float t[16];
+        for (uint32_t i = 0; i < 16; i++) {
+            t[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+        }
+        fitEndpoints(block, 4, t, low, high);
+    }
+
+    // the first index is stored without its top bit, so it has to be in the
+    // lower half, which swapping the endpoints guarantees
+    if (bestIndices[0] >= 8) {
+        std::swap(bestEndpoints[0], bestEndpoints[1]);
+        std::swap(bestPBits[0], bestPBits[1]);
+        for (auto& index : bestIndices) {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    std::memset(output, 0, 16);
+    BlockBitWriter writer { output };
+    writer.write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        writer.write(bestEndpoints[0][c], 7);
+        writer.write(bestEndpoints[1][c], 7);
+    }
+    writer.write(bestPBits[0], 1);
+    writer.write(bestPBits[1], 1);
+    writer.write(bestIndices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) {
+        writer.write(bestIndices[i], 4);
+    }
+
+    return bestError;
+}
+
+static float encodeBlock(const BlockPixels& block, TextureFormat format, const CompressionSettings& settings, uint8_t* output)
+{
+    switch (format) {
+    case TextureFormat::Bc1:
+        return encodeBc1Block(block, settings, output);
+    case TextureFormat::Bc3:
+        return encodeBc4Block(block, 3, settings, output) + encodeBc1Block(block, settings, output + 8);
+    case TextureFormat::Bc5:
+        return encodeBc4Block(block, 0, settings, output) + encodeBc4Block(block, 1, settings, output + 8);
+    default:
+        return encodeBc7Block(block, settings, output);
+    }
+}
+
+double compressTexture(const uint32_t* pixels, uint32_t width, uint32_t height, TextureFormat format, CompressionQuality quality, uint8_t* output, uint32_t threadCount)
+{
+    if (format == TextureFormat::Rgba8) {
+        std::memcpy(output, pixels, static_cast<size_t>(width) * height * sizeof(uint32_t));
+        return 0.0;
+    }
+
+    CompressionSettings settings = getCompressionSettings(quality);
+    uint32_t blockBytes = getTextureBlockBytes(format);
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    if (blocksX == 0 || blocksY == 0) {
+        return 0.0;
+    }
+
+    // every thread takes a contiguous range of block rows, small mips end up
+    // on fewer threads than asked for
+    threadCount = std::clamp(threadCount, 1u, blocksY);
+    uint32_t rowsPerThread = (blocksY + threadCount - 1) / threadCount;
+    std::vector<double> errors(threadCount, 0.0);
+
+    auto compressRows = [&](uint32_t thread) {
+        uint32_t begin = std::min(blocksY, thread * rowsPerThread);
+        uint32_t end = std::min(blocksY, begin + rowsPerThread);
+        double error = 0.0;
+
+        BlockPixels block;
+        for (uint32_t blockY = begin; blockY < end; blockY++) {
+            for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+                loadBlock(pixels, width, height, blockX, blockY, block);
+                error += encodeBlock(block, format, settings, output + (static_cast<size_t>(blockY) * blocksX + blockX) * blockBytes);
+            }
+        }
+        errors[thread] = error;
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (uint32_t thread = 1; thread < threadCount; thread++) {
+        workers.emplace_back(compressRows, thread);
+    }
+
+    compressRows(0);
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    double totalError = 0.0;
+    for (double error : errors) {
+        totalError += error;
+    }
+    return totalError / (static_cast<double>(blocksX) * blocksY * 16 * getStoredChannelCount(format));
+}
+
+const char* getCompressionKernelName()
+{
+#if defined(COMPRESSION_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
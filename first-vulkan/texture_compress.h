@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+enum class TextureFormat : uint32_t {
+    // uncompressed, 4 bytes per pixel
+    Rgba8 = 0,
+    // opaque rgb in 8 bytes per 4x4 block
+    Bc1 = 1,
+    // bc1 color plus a separately coded alpha, 16 bytes per block
+    Bc3 = 2,
+    // two independent channels, 16 bytes per block. meant for normal maps, a
+    // color texture loses its blue channel
+    Bc5 = 3,
+    // rgba in 16 bytes per block, only mode 6 is used: one subset with 7 bit
+    // endpoints, a p-bit each and 16 interpolation steps
+    Bc7 = 4,
+};
+
+// trades encoding time for quality. fast takes the block extremes along a
+// rough principal axis, the others refine the axis further, fit the
+// endpoints to the chosen indices with least squares and try the alternative
+// bc3/bc5 alpha mode
+enum class CompressionQuality : uint32_t {
+    Fast = 0,
+    Default = 1,
+    Best = 2,
+};
+
+[[nodiscard]] const char* getTextureFormatName(TextureFormat format);
+[[nodiscard]] const char* getCompressionQualityName(CompressionQuality quality);
+
+// width and height of a block in pixels, 1 for rgba8
+[[nodiscard]] uint32_t getTextureBlockSize(TextureFormat format);
+[[nodiscard]] uint32_t getTextureBlockBytes(TextureFormat format);
+[[nodiscard]] uint64_t getTextureMipBytes(TextureFormat format, uint32_t width, uint32_t height);
+
+// encodes rgba8 pixels, red in the lowest byte, into getTextureMipBytes bytes
+// of output. block rows are split across threadCount threads. returns the
+// mean squared error per pixel and stored channel, in 8 bit units
+double compressTexture(const uint32_t* pixels, uint32_t width, uint32_t height, TextureFormat format, CompressionQuality quality, uint8_t* output, uint32_t threadCount);
+
+// name of the instruction set the index search was compiled for
+[[nodiscard]] const char* getCompressionKernelName();
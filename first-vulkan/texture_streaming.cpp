@@ -0,0 +1,184 @@
+#include "texture_streaming.h"
+
+#include <algorithm>
+
+TextureStreamer makeTextureStreamer(uint64_t budget, uint64_t uploadLimit, uint32_t blockSize, uint32_t blockBytes)
+{
+    TextureStreamer streamer;
+    streamer.budget = budget;
+    streamer.uploadLimit = uploadLimit;
+    streamer.blockSize = blockSize;
+    streamer.blockBytes = blockBytes;
+    return streamer;
+}
+
+uint32_t getMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t mipCount = 1;
+    while ((std::max(width, height) >> mipCount) > 0) {
+        mipCount++;
+    }
+    return mipCount;
+}
+
+uint64_t getMipBytes(const TextureStreamer& streamer, const StreamedTexture& texture, uint32_t mip)
+{
+    uint64_t blocksX = (std::max(1u, texture.width >> mip) + streamer.blockSize - 1) / streamer.blockSize;
+    uint64_t blocksY = (std::max(1u, texture.height >> mip) + streamer.blockSize - 1) / streamer.blockSize;
+    return blocksX * blocksY * streamer.blockBytes;
+}
+
+uint64_t getImageBytes(const TextureStreamer& streamer, const StreamedTexture& texture, uint32_t firstMip)
+{
+    uint64_t bytes = 0;
+    for (uint32_t mip = firstMip; mip < texture.mipCount; mip++) {
+        bytes += getMipBytes(streamer, texture, mip);
+    }
+    return bytes;
+}
+
+uint32_t addStreamedTexture(TextureStreamer& streamer, uint32_t width, uint32_t height, uint32_t tailSize)
+{
+    StreamedTexture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.mipCount = getMipCount(width, height);
+    texture.tailMip = texture.mipCount - 1;
+    while (texture.tailMip > 0 && std::max(width, height) >> (texture.tailMip - 1) <= tailSize) {
+        texture.tailMip--;
+    }
+    texture.residentMip = texture.tailMip;
+    texture.requestedMip = texture.tailMip;
+    texture.mipLastUsed.resize(texture.mipCount, 0);
+
+    streamer.residentBytes += getImageBytes(streamer, texture, texture.tailMip);
+    streamer.peakBytes = std::max(streamer.peakBytes, streamer.residentBytes);
+
+    streamer.textures.push_back(texture);
+    return static_cast<uint32_t>(streamer.textures.size() - 1);
+}
+
+void requestTextureMip(TextureStreamer& streamer, uint32_t texture, uint32_t mip, uint64_t frameNumber)
+{
+    StreamedTexture& streamed = streamer.textures[texture];
+    mip = std::min(mip, streamed.tailMip);
+
+    streamed.requestedMip = std::min(streamed.requestedMip, mip);
+    // sampling mip also touches the coarser ones
+    for (uint32_t i = mip; i < streamed.tailMip; i++) {
+        streamed.mipLastUsed[i] = frameNumber;
+    }
+}
+
+// the resident texture whose finest mip was used longest ago, or none if
+// every mip that could go is still in use
+[[nodiscard]] static int32_t findEvictionVictim(const TextureStreamer& streamer, uint64_t frameNumber)
+{
+    int32_t victim = -1;
+    uint64_t oldest = frameNumber;
+
+    for (size_t i = 0; i < streamer.textures.size(); i++) {
+        const StreamedTexture& texture = streamer.textures[i];
+        if (texture.residentMip == texture.tailMip) {
+            continue;
+        }
+
+        uint64_t lastUsed = texture.mipLastUsed[texture.residentMip];
+        if (lastUsed < oldest) {
+            oldest = lastUsed;
+            victim = static_cast<int32_t>(i);
+        }
+    }
+
+    return victim;
+}
+
+std::vector<StreamingChange> updateTextureStreaming(TextureStreamer& streamer, uint64_t frameNumber)
+{
+    std::vector<uint32_t> oldResidentMips(streamer.textures.size());
+    for (size_t i = 0; i < streamer.textures.size(); i++) {
+        oldResidentMips[i] = streamer.textures[i].residentMip;
+    }
+
+    // the old images of the textures changed so far
+    std::vector<bool> changed(streamer.textures.size(), false);
+    uint64_t retiring = 0;
+    auto getRetiredBytes = [&](size_t i) {
+        return changed[i] ? 0 : getImageBytes(streamer, streamer.textures[i], oldResidentMips[i]);
+    };
+
+    uint64_t uploaded = 0;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+
+        for (size_t i = 0; i < streamer.textures.size(); i++) {
+            StreamedTexture& texture = streamer.textures[i];
+            if (texture.requestedMip >= texture.residentMip) {
+                continue;
+            }
+
+            uint32_t mip = texture.residentMip - 1;
+            uint64_t bytes = getMipBytes(streamer, texture, mip);
+            if (uploaded + bytes > streamer.uploadLimit) {
+                continue;
+            }
+
+            // evicting frees a mip for good, but keeps the victim's old image
+            // alive for a while like any other change
+            uint64_t retired = getRetiredBytes(i);
+            std::vector<uint32_t> victims;
+            while (streamer.residentBytes + bytes > streamer.budget) {
+                int32_t victim = findEvictionVictim(streamer, frameNumber);
+                if (victim < 0) {
+                    break;
+                }
+
+                if (static_cast<size_t>(victim) != i && std::find(victims.begin(), victims.end(), victim) == victims.end()) {
+                    retired += getRetiredBytes(victim);
+                }
+                StreamedTexture& evicted = streamer.textures[victim];
+                streamer.residentBytes -= getMipBytes(streamer, evicted, evicted.residentMip);
+                evicted.residentMip++;
+                victims.push_back(static_cast<uint32_t>(victim));
+            }
+
+            uint64_t peak = streamer.residentBytes + bytes + streamer.inFlightBytes + retiring + retired;
+            if (streamer.residentBytes + bytes > streamer.budget || peak > streamer.budget) {
+                // waits for the images in flight to go instead
+                for (auto victim = victims.rbegin(); victim != victims.rend(); ++victim) {
+                    StreamedTexture& restored = streamer.textures[*victim];
+                    restored.residentMip--;
+                    streamer.residentBytes += getMipBytes(streamer, restored, restored.residentMip);
+                }
+                continue;
+            }
+
+            for (uint32_t victim : victims) {
+                changed[victim] = true;
+            }
+            changed[i] = true;
+            retiring += retired;
+            streamer.evictionCount += static_cast<uint32_t>(victims.size());
+            streamer.peakBytes = std::max(streamer.peakBytes, peak);
+
+            texture.residentMip = mip;
+            streamer.residentBytes += bytes;
+            streamer.loadedBytes += bytes;
+            streamer.loadCount++;
+            uploaded += bytes;
+            progress = true;
+        }
+    }
+
+    std::vector<StreamingChange> changes;
+    for (size_t i = 0; i < streamer.textures.size(); i++) {
+        StreamedTexture& texture = streamer.textures[i];
+        if (texture.residentMip != oldResidentMips[i]) {
+            changes.push_back({ static_cast<uint32_t>(i), oldResidentMips[i], texture.residentMip });
+        }
+        texture.requestedMip = texture.tailMip;
+    }
+
+    return changes;
+}
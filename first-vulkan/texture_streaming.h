@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// decides which mips of each texture live on the gpu. the coarse mips, the
+// tail, are loaded up front and never leave, finer ones are loaded as objects
+// ask for them and evicted least recently used first once the memory budget
+// runs out. a texture always holds a contiguous range of mips, from
+// residentMip down to the smallest one, so only its finest resident mip can
+// be evicted
+struct StreamedTexture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+    // finest mip of the tail
+    uint32_t tailMip = 0;
+    uint32_t residentMip = 0;
+    // finest mip asked for since the last update
+    uint32_t requestedMip = 0;
+    // frame number each mip was last asked for in
+    std::vector<uint64_t> mipLastUsed;
+};
+
+struct TextureStreamer {
+    std::vector<StreamedTexture> textures;
+    // mips are stored in blocks of blockSize x blockSize pixels, 1 for
+    // uncompressed formats
+    uint32_t blockSize = 1;
+    uint32_t blockBytes = 0;
+    // covers every resident mip, the tails included, and the images in flight
+    uint64_t budget = 0;
+    // most bytes loaded by one update, evictions cost nothing
+    uint64_t uploadLimit = 0;
+    uint64_t residentBytes = 0;
+    // a residency change copies a texture into a new image, the old one lives
+    // on until the frames reading it finish. set by the caller before every
+    // update: the images retired but not yet destroyed, and the ones about
+    // to be replaced
+    uint64_t inFlightBytes = 0;
+    // most resident and in flight bytes at once, what the budget bounds
+    uint64_t peakBytes = 0;
+    uint64_t loadedBytes = 0;
+    uint32_t loadCount = 0;
+    uint32_t evictionCount = 0;
+};
+
+// a texture whose resident range changed in an update
+struct StreamingChange {
+    uint32_t texture;
+    uint32_t oldResidentMip;
+    uint32_t residentMip;
+};
+
+[[nodiscard]] TextureStreamer makeTextureStreamer(uint64_t budget, uint64_t uploadLimit, uint32_t blockSize, uint32_t blockBytes);
+
+[[nodiscard]] uint32_t getMipCount(uint32_t width, uint32_t height);
+[[nodiscard]] uint64_t getMipBytes(const TextureStreamer& streamer, const StreamedTexture& texture, uint32_t mip);
+// every mip from firstMip down to the smallest, what an image of the texture
+// holds
+[[nodiscard]] uint64_t getImageBytes(const TextureStreamer& streamer, const StreamedTexture& texture, uint32_t firstMip);
+
+// the tail is every mip no larger than tailSize in either dimension, at least
+// the smallest one. returns the index of the texture
+uint32_t addStreamedTexture(TextureStreamer& streamer, uint32_t width, uint32_t height, uint32_t tailSize);
+
+void requestTextureMip(TextureStreamer& streamer, uint32_t texture, uint32_t mip, uint64_t frameNumber);
+
+// loads requested mips coarsest first, one mip per texture at a time so every
+// texture gets closer to what it asked for before any gets everything. mips
+// asked for in frameNumber are never evicted to make room. the old image of
+// every texture the update changes is charged on top of inFlightBytes, so
+// the budget holds while both images are alive
+[[nodiscard]] std::vector<StreamingChange> updateTextureStreaming(TextureStreamer& streamer, uint64_t frameNumber);
@@ -0,0 +1,107 @@
+#include "vertex_format.h"
+
+#include <cmath>
+#include <cstring>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex has to match the packed vertex input attributes");
+
+uint32_t getVertexStride(VertexFormat format)
+{
+    return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+const char* getVertexFormatName(VertexFormat format)
+{
+    return format == VertexFormat::Packed ? "packed" : "float32";
+}
+
+glm::vec2 encodeOctahedral(const glm::vec3& direction)
+{
+    // degenerate normals of collapsed triangles come out as +z
+    float norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (!(norm > 0.0f)) {
+        return glm::vec2(0.0f);
+    }
+
+    glm::vec3 n = direction / norm;
+    glm::vec2 encoded(n.x, n.y);
+
+    // the lower half of the octahedron is folded over the diagonals
+    if (n.z < 0.0f) {
+        glm::vec2 sign(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        encoded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+    }
+
+    return encoded;
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& encoded)
+{
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    float t = glm::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+VertexQuantization computeVertexQuantization(const std::vector<Vertex>& vertices)
+{
+    VertexQuantization quantization { glm::vec3(0.0f), glm::vec3(1.0f) };
+    if (vertices.empty()) {
+        return quantization;
+    }
+
+    glm::vec3 minBounds = vertices[0].position;
+    glm::vec3 maxBounds = vertices[0].position;
+    for (const auto& vertex : vertices) {
+        minBounds = glm::min(minBounds, vertex.position);
+        maxBounds = glm::max(maxBounds, vertex.position);
+    }
+
+    glm::vec3 extent = maxBounds - minBounds;
+    quantization.positionOffset = minBounds;
+    quantization.positionScale = glm::vec3(extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f);
+    return quantization;
+}
+
+PackedVertex packVertex(const Vertex& vertex, const VertexQuantization& quantization)
+{
+    glm::vec3 position = (vertex.position - quantization.positionOffset) / quantization.positionScale;
+
+    PackedVertex packed {};
+    packed.position = glm::packUnorm4x16(glm::vec4(glm::clamp(position, 0.0f, 1.0f), 0.0f));
+    packed.normal = glm::packSnorm2x16(encodeOctahedral(vertex.normal));
+    packed.uv = glm::packHalf2x16(vertex.uv);
+    return packed;
+}
+
+Vertex unpackVertex(const PackedVertex& vertex, const VertexQuantization& quantization)
+{
+    Vertex unpacked {};
+    unpacked.position = quantization.positionOffset + glm::vec3(glm::unpackUnorm4x16(vertex.position)) * quantization.positionScale;
+    unpacked.normal = decodeOctahedral(glm::unpackSnorm2x16(vertex.normal));
+    unpacked.uv = glm::unpackHalf2x16(vertex.uv);
+    return unpacked;
+}
+
+void convertVertices(const std::vector<Vertex>& vertices, VertexFormat format, const VertexQuantization& quantization, std::vector<uint8_t>& output)
+{
+    size_t offset = output.size();
+    output.resize(offset + vertices.size() * getVertexStride(format));
+    uint8_t* destination = output.data() + offset;
+
+    if (format == VertexFormat::Float32) {
+        std::memcpy(destination, vertices.data(), vertices.size() * sizeof(Vertex));
+        return;
+    }
+
+    for (const auto& vertex : vertices) {
+        PackedVertex packed = packVertex(vertex, quantization);
+        std::memcpy(destination, &packed, sizeof(packed));
+        destination += sizeof(packed);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+enum class VertexFormat : uint32_t {
+    // Vertex, 32 bytes
+    Float32 = 0,
+    // PackedVertex, 16 bytes
+    Packed = 1,
+};
+
+// positions are unorm16 relative to the mesh bounds, the shader maps them back
+// with positionOffset + position * positionScale. normals are octahedral
+// encoded snorm16x2 and uvs half floats
+struct PackedVertex {
+    // VK_FORMAT_R16G16B16A16_UNORM, w is unused
+    uint64_t position;
+    // VK_FORMAT_R16G16_SNORM
+    uint32_t normal;
+    // VK_FORMAT_R16G16_SFLOAT
+    uint32_t uv;
+};
+
+struct VertexQuantization {
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+};
+
+[[nodiscard]] uint32_t getVertexStride(VertexFormat format);
+[[nodiscard]] const char* getVertexFormatName(VertexFormat format);
+
+// unit vector to the octahedron folded into [-1, 1]^2 and back, works for
+// tangents just as well as for normals. a zero vector encodes +z
+[[nodiscard]] glm::vec2 encodeOctahedral(const glm::vec3& direction);
+[[nodiscard]] glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+// covers the bounding box of the vertices, flat axes get a scale of 1 so they
+// still decode to their single value
+[[nodiscard]] VertexQuantization computeVertexQuantization(const std::vector<Vertex>& vertices);
+
+[[nodiscard]] PackedVertex packVertex(const Vertex& vertex, const VertexQuantization& quantization);
+[[nodiscard]] Vertex unpackVertex(const PackedVertex& vertex, const VertexQuantization& quantization);
+
+// appends the vertices in the given format to output as raw bytes
+void convertVertices(const std::vector<Vertex>& vertices, VertexFormat format, const VertexQuantization& quantization, std::vector<uint8_t>& output);